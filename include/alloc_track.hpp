@@ -0,0 +1,105 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <typeinfo>
+
+// live/peak instances and bytes of the kernel classes, counted only in the build of `make all_min_a` (TRACK_ALLOC).
+// a class derives from Tracked<itself> (an empty base otherwise); the vectors of Context and Environment
+// allocate through Allocator<T, owner>, so that their elements are counted as bytes of the owner.
+
+namespace alloc_track {
+
+#ifdef TRACK_ALLOC
+inline constexpr bool enabled = true;
+#else
+inline constexpr bool enabled = false;
+#endif
+
+class ClassStats {
+  public:
+    // registers itself; the first one also prints summary() at exit
+    explicit ClassStats(const std::string& name);
+
+    void add(int64_t objects, int64_t bytes);
+    void add_bytes(int64_t bytes) { add(0, bytes); }
+
+    const std::string& name() const { return _name; }
+    int64_t live() const { return _live.load(std::memory_order_relaxed); }
+    int64_t peak() const { return _peak.load(std::memory_order_relaxed); }
+    int64_t live_bytes() const { return _bytes.load(std::memory_order_relaxed); }
+    int64_t peak_bytes() const { return _peak_bytes.load(std::memory_order_relaxed); }
+    uint64_t constructed() const { return _constructed.load(std::memory_order_relaxed); }
+
+  private:
+    std::string _name;
+    std::atomic<int64_t> _live = 0, _peak = 0, _bytes = 0, _peak_bytes = 0;
+    std::atomic<uint64_t> _constructed = 0;
+};
+
+std::string class_name(const std::type_info& type);
+
+template <class T>
+ClassStats& stats() {
+    static ClassStats s(class_name(typeid(T)));
+    return s;
+}
+
+// a table of every tracked class
+void summary(std::ostream& os = std::cerr);
+// one line for the progress output: the total and the classes holding the most bytes
+std::string brief(size_t top = 4);
+
+#ifdef TRACK_ALLOC
+
+template <class T>
+class Tracked {
+  public:
+    Tracked() { stats<T>().add(1, sizeof(T)); }
+    Tracked(const Tracked&) : Tracked() {}
+    Tracked& operator=(const Tracked&) { return *this; }
+    ~Tracked() { stats<T>().add(-1, -(int64_t)sizeof(T)); }
+};
+
+template <class T, class Owner>
+class Allocator : public std::allocator<T> {
+  public:
+    template <class U>
+    struct rebind {
+        using other = Allocator<U, Owner>;
+    };
+
+    Allocator() = default;
+    template <class U>
+    Allocator(const Allocator<U, Owner>&) {}
+
+    T* allocate(size_t n) {
+        stats<Owner>().add_bytes(n * sizeof(T));
+        return std::allocator<T>::allocate(n);
+    }
+    void deallocate(T* p, size_t n) {
+        stats<Owner>().add_bytes(-(int64_t)(n * sizeof(T)));
+        std::allocator<T>::deallocate(p, n);
+    }
+};
+
+template <class T, class U, class Owner>
+bool operator==(const Allocator<T, Owner>&, const Allocator<U, Owner>&) { return true; }
+template <class T, class U, class Owner>
+bool operator!=(const Allocator<T, Owner>&, const Allocator<U, Owner>&) { return false; }
+
+#else
+
+template <class T>
+class Tracked {};
+
+template <class T, class Owner>
+using Allocator = std::allocator<T>;
+
+#endif
+
+}  // namespace alloc_track
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/*
+verifier --batch: verify many scripts in one process.
+manifest: one job per line, "SCRIPT [DEF_FILE [OUT_BOOK]]" separated by blanks ('#' begins a comment)
+    SCRIPT    text or binary script (detected by its header)
+    DEF_FILE  definitions naming the environment of OUT_BOOK ("-" for none), as verifier -d
+    OUT_BOOK  write the book to this file in the conventional notation (optional)
+*/
+
+struct BatchJob {
+    std::string script, def_file, out_book;
+};
+
+struct BatchResult {
+    bool ok = false;
+    size_t lines = 0;
+    double ms = 0;
+    std::string error;
+};
+
+class Book;
+
+// applies a text or binary script (told apart by its header) to book; returns the # of lines read.
+// throws FileError, InferenceError
+size_t read_script_file(Book& book, const std::string& fname);
+
+// throws FileError
+std::vector<BatchJob> read_manifest(const std::string& fname);
+
+// verifies the jobs on the given # of threads (each book lives on one thread).
+// each distinct def file is read once, before the workers start, and shared by the jobs naming it.
+// so are the conversions checked by the books (shared_conversions is set while the jobs run).
+// whatever a job throws fails that job only.
+// on_done is called (under a lock) as each job finishes, e.g. to count for a progress reporter.
+std::vector<BatchResult> run_batch(const std::vector<BatchJob>& jobs, size_t threads, bool skip_check,
+                                   const std::function<void(size_t)>& on_done = nullptr);
+
+// a line per job and a summary; returns whether every job succeeded
+bool print_batch(std::ostream& os, const std::vector<BatchJob>& jobs, const std::vector<BatchResult>& results, double wall_ms);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <string_view>
+
+// byte-oriented encoder; integers are stored as LEB128 varints
+class ByteWriter {
+  public:
+    void put(uint8_t byte) { _buf.push_back((char)byte); }
+    void put_varint(uint64_t x);
+    void put_svarint(int64_t x);  // zigzag-encoded signed value
+    void put_string(const std::string& str);
+    void put_bytes(const void* data, size_t len);
+
+    const std::string& data() const { return _buf; }
+    size_t size() const { return _buf.size(); }
+    void clear() { _buf.clear(); }
+
+  private:
+    std::string _buf;
+};
+
+// byte-oriented decoder reading from a stream buffer
+// throws FileError when the input ends unexpectedly
+class ByteReader {
+  public:
+    ByteReader(std::istream& is, const std::string& srcname = "");
+    // reads the bytes in place (data must outlive the reader)
+    ByteReader(std::string_view data, const std::string& srcname = "");
+    uint8_t get();
+    uint64_t get_varint();
+    int64_t get_svarint();
+    // the length is checked against the bytes left before anything is allocated
+    std::string get_string();
+    void get_bytes(void* data, size_t len);
+    bool eof();
+    // # of bytes left, or SIZE_MAX if the stream cannot tell (e.g. a pipe)
+    size_t remaining();
+    const std::string& name() const { return _srcname; }
+
+  private:
+    std::unique_ptr<std::streambuf> _view;
+    std::streambuf* _sb;
+    std::string _srcname;
+};
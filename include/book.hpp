@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <cstdio>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -10,6 +13,12 @@
 #include "environment.hpp"
 #include "judgement.hpp"
 
+class RuleProfile;
+class ScriptRecord;
+class ScriptBinaryReader;
+class LineReader;
+struct ScriptItem;
+
 class Book : public std::vector<Judgement> {
   public:
     Book(bool skip_check = false);
@@ -32,6 +41,13 @@ class Book : public std::vector<Judgement> {
     void cp(size_t m);
     void sp(size_t m, size_t n);
     void tp(size_t m);
+    void apply(const ScriptRecord& rec);
+
+    // exchanges everything, the environment and the settings included
+    void swap(Book& other);
+    // drops the judgements and what was recorded about them (line hashes, reuse, unchecked lines),
+    // but keeps the environment and the settings
+    void clear();
 
     std::string string() const;
     std::string repr() const;
@@ -42,15 +58,94 @@ class Book : public std::vector<Judgement> {
 
     TextData read_script(const std::string& scriptname, size_t limit = -1);
     TextData read_script(const FileData& fdata, size_t limit = -1);
+    size_t read_script(ScriptBinaryReader& reader, size_t limit = -1);
+    size_t read_script(LineReader& reader, size_t limit = -1);
+    // decode lines on a separate thread while the calling thread applies them
+    size_t read_script_pipelined(LineReader& reader, size_t limit = -1);
+    size_t read_script_pipelined(ScriptBinaryReader& reader, size_t limit = -1);
+    size_t read_script_pipelined(const std::function<bool(ScriptItem&)>& decode, size_t limit = -1);
+
+    // release the judgement of line i right after line last_use[i] is applied (see script_last_use()).
+    // released judgements stay in the book as tombstones so that indices are preserved.
+    void forget_after_last_use(const std::vector<size_t>& last_use) { _last_use = last_use; }
+    void forget(size_t lno);
+    bool is_forgotten(size_t lno) const { return !(*this)[lno].type(); }
+
+    // reuse the judgement of line i of cached (e.g. restored from a previous run's checkpoint) when
+    // the record of line i hashes to hashes[i] and every line it refers to was reused as well.
+    // a book checking the rules reuses nothing from a cached book that is not checked.
+    void reuse_from(const std::shared_ptr<const Book>& cached, const std::vector<uint64_t>& hashes);
+    // the hash of the record of every line (ScriptRecord::hash()), saved with checkpoints so that
+    // a resumed or cached run can tell which lines of the script changed
+    const std::vector<uint64_t>& line_hashes() const { return _hashes; }
+    // for the lines restored from a checkpoint
+    void set_line_hashes(const std::vector<uint64_t>& hashes) { _hashes = hashes; }
+    size_t reused_count() const { return _reused_count; }
+    // false if a judgement may have been derived without checking the rules (with skip_check,
+    // or by the run that took a checkpoint restored into this book)
+    bool is_checked() const { return _checked; }
+    void set_checked(bool checked) { _checked = checked && !_skip_check; }
+
+    // called after each rule applied from a script (e.g. to stream the book while verifying)
+    void set_listener(const std::function<void(size_t)>& listener) { _listener = listener; }
+    // times each rule applied from a script (reused lines are not counted)
+    void set_profile(RuleProfile* profile) { _profile = profile; }
+    // set to the # of lines after each rule applied from a script (for a progress reporter on another thread)
+    void set_progress(std::atomic<size_t>* progress) { _progress = progress; }
 
     void read_def_file(const std::string& fname);
+    // an environment read before (e.g. shared by the jobs of verifier --batch)
+    void set_def_env(const Environment& env);
     const Environment& env() const;
     int def_num(const std::shared_ptr<Definition>& def) const;
 
   private:
+    // appends the cached judgement of the next line if it can be reused
+    bool reuse(const ScriptRecord& rec, uint64_t hash);
+
     Environment _env;
     std::map<std::string, int> _def_dict;
     bool _skip_check = false;
+    bool _checked = true;
+    std::function<void(size_t)> _listener;
+    RuleProfile* _profile = nullptr;
+    std::atomic<size_t>* _progress = nullptr;
+    std::vector<size_t> _last_use;
+    std::shared_ptr<const Book> _cached;
+    std::vector<uint64_t> _cached_hashes, _hashes;
+    std::vector<bool> _reused;
+    size_t _reused_count = 0;
+};
+
+enum class BookFormat {
+    Conventional,  // repr()
+    New,           // repr_new()
+    Rich           // string()
+};
+
+// writes a book judgement by judgement through a bounded buffer,
+// producing the same text as repr() / repr_new() / string() without building it in memory
+class BookWriter {
+  public:
+    BookWriter(std::FILE* fp, BookFormat format, size_t bufsize = 1 << 20);
+    ~BookWriter();
+    BookWriter(const BookWriter&) = delete;
+    BookWriter& operator=(const BookWriter&) = delete;
+
+    void write(const Book& book, size_t lno);
+    void write_all(const Book& book);  // write judgements not written yet
+    void finish(const Book& book);     // write the trailer and flush
+    size_t bytes() const { return _bytes; }
+
+  private:
+    void put(const std::string& str);
+    void flush();
+    std::FILE* _fp;
+    BookFormat _format;
+    std::string _buf;
+    size_t _bufsize;
+    size_t _next = 0, _bytes = 0;
+    bool _started = false, _finished = false;
 };
 
 bool is_var_applicable(const Book& book, size_t idx, const std::string& var);
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "book.hpp"
+#include "common.hpp"
+#include "judgement.hpp"
+
+// the states an interactive book went through, as a tree of append-only segments sharing their prefixes.
+// a state (the book at some moment) is a segment and a length in it, so taking one costs O(1),
+// and restoring one only replaces the lines after the prefix it shares with the current book
+// (the judgements are copied as they are, nothing is verified again).
+// the history mirrors the book: push() after a rule is applied, pop() with undo.
+class BookHistory {
+  public:
+    class State;
+
+    // starts with the judgements of book (script: their script lines)
+    BookHistory(const Book& book, const TextData& script);
+
+    void push(const Judgement& judge, const std::string& line);
+    void pop(size_t n);
+    void clear();
+    size_t size() const;
+
+    State state() const;
+    // makes book and script those of state; returns the # of lines dropped and appended
+    size_t restore(const State& state, Book& book, TextData& script);
+
+  private:
+    struct Segment {
+        std::shared_ptr<Segment> parent;
+        size_t begin, depth;  // the index of the first line in the book, the # of ancestors
+        std::vector<Judgement> judges;
+        TextData lines;
+    };
+
+    std::shared_ptr<Segment> _cur;
+    size_t _len = 0;  // # of lines of _cur in the book (the rest belongs to other states)
+
+  public:
+    class State {
+      public:
+        State() = default;
+        size_t size() const { return _seg ? _seg->begin + _len : 0; }
+
+      private:
+        friend class BookHistory;
+        State(const std::shared_ptr<Segment>& seg, size_t len) : _seg(seg), _len(len) {}
+        std::shared_ptr<Segment> _seg;
+        size_t _len = 0;
+    };
+};
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "binary.hpp"
+#include "book.hpp"
+#include "context.hpp"
+#include "definition.hpp"
+#include "environment.hpp"
+#include "lambda.hpp"
+#include "pool.hpp"
+
+/*
+#####  checkpoint  #####
+header: "FPCK" version:v flags:v #lines:v
+body:   record* end
+record: tag:1 payload (every object is written once, after the objects it refers to)
+        term        star | square | var name:s | appl M:r N:r
+                    | lambda/pi x:r A:r M:r | const name:s n:v r*n
+        context     n:v (x:r A:r)*n
+        definition  name:s context:r definiens:r type:r
+        environment n:v r*n
+        judgement   env:r context:r term:r type:r   (all 0 for a forgotten judgement)
+        hashes      n:v (hash:8)*n                  (ScriptRecord::hash() of each line, little endian; checked by --resume)
+flags:  CHECKPOINT_CHECKED if every judgement was derived with the rules checked (not with --skip-check)
+(v: LEB128 varint, s: string, r: varint of 1 + index among the objects of its kind, or 0 for null)
+ */
+
+inline constexpr const char CHECKPOINT_MAGIC[] = "FPCK";
+inline constexpr uint64_t CHECKPOINT_VERSION = 2;
+inline constexpr uint64_t CHECKPOINT_CHECKED = 1;
+
+class ScriptRecord;
+
+class CheckpointWriter {
+  public:
+    // serializes every judgement of the book (tombstones included) and the line hashes if any
+    void write(std::ostream& os, const Book& book, const std::vector<uint64_t>& hashes = {});
+
+  private:
+    uint64_t put_term(const std::shared_ptr<Term>& term);
+    uint64_t put_context(const std::shared_ptr<Context>& con);
+    uint64_t put_definition(const std::shared_ptr<Definition>& def);
+    uint64_t put_environment(const std::shared_ptr<Environment>& env);
+
+    ByteWriter _body;
+    std::unordered_map<const void*, uint64_t> _terms, _contexts, _defs, _envs;
+};
+
+class CheckpointReader {
+  public:
+    CheckpointReader(std::istream& is, const std::string& srcname = "");
+    // replaces the judgements of the book (and the line hashes if requested), and marks the book
+    // unchecked if the checkpoint is; returns the number of script lines covered
+    size_t read(Book& book, std::vector<uint64_t>* hashes = nullptr);
+
+  private:
+    // reads a reference into the table; reference 0 (null) is malformed unless nullable
+    template <class T>
+    const T& get(const std::vector<T>& table, const char* kind, bool nullable = false);
+    // reads an item count, bounded by the size of the file
+    size_t get_count(size_t unit, const char* kind);
+
+    ByteReader _reader;
+    size_t _avail = SIZE_MAX;
+    std::vector<PoolHandle<Term>> _terms;
+    std::vector<PoolHandle<Context>> _contexts;
+    std::vector<std::shared_ptr<Definition>> _defs;
+    std::vector<PoolHandle<Environment>> _envs;
+};
+
+// writes to fname atomically (through a temporary file and rename)
+void write_checkpoint(const std::string& fname, const Book& book, const std::vector<uint64_t>& hashes = {});
+// returns the number of script lines covered; throws FileError
+size_t read_checkpoint(const std::string& fname, Book& book, std::vector<uint64_t>* hashes = nullptr);
+// read_checkpoint() for a run continuing the script: the lines the checkpoint covers are read through next
+// (which returns false at the end of the script) and checked against its line hashes; throws FileError
+size_t resume_checkpoint(const std::string& fname, Book& book, const std::function<bool(ScriptRecord&)>& next);
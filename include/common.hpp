@@ -45,6 +45,9 @@ void unused(T x, Ts... data) { unused(x), unused(data...); }
 
 const bool DEBUG_CERR = false;
 
+// compiles in the timers, counters and histograms of instrument.hpp (shown with --stats)
+const bool INSTRUMENT = false;
+
 const bool flag_address_comp = true;
 
 template <class T>
@@ -5,9 +5,10 @@
 #include <memory>
 #include <set>
 
+#include "alloc_track.hpp"
 #include "lambda.hpp"
 
-class Context : public std::vector<Typed<Variable>> {
+class Context : public std::vector<Typed<Variable>, alloc_track::Allocator<Typed<Variable>, Context>>, private alloc_track::Tracked<Context> {
   public:
     Context();
     Context(const std::vector<Typed<Variable>>& tvars);
@@ -26,6 +27,9 @@ bool equiv_context_n(const Context& a, const Context& b, size_t n);
 bool equiv_context_n(const std::shared_ptr<Context>& a, const std::shared_ptr<Context>& b, size_t n);
 bool equiv_context(const Context& a, const Context& b);
 bool equiv_context(const std::shared_ptr<Context>& a, const std::shared_ptr<Context>& b);
+// equal as written (see exact_comp() of terms)
+bool exact_comp(const Context& a, const Context& b);
+size_t exact_hash(const Context& con);
 
 bool has_variable(const std::shared_ptr<Context>& g, const std::shared_ptr<Variable>& v);
 bool has_variable(const std::shared_ptr<Context>& g, const std::shared_ptr<Term>& v);
@@ -48,3 +52,9 @@ std::shared_ptr<Variable> get_fresh_var(const Context& con);
 
 std::set<std::string> extract_constant(const Context& con);
 std::set<std::string> extract_constant(const std::shared_ptr<Context>& con);
+
+template <>
+struct PoolKey<Context> {
+    static size_t hash(const std::shared_ptr<Context>& c) { return exact_hash(*c); }
+    static bool equal(const std::shared_ptr<Context>& a, const std::shared_ptr<Context>& b) { return a == b || exact_comp(*a, *b); }
+};
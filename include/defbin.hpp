@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "environment.hpp"
+
+/*
+#####  compiled environment (.defbin)  #####
+header: "FPDB" version:v #names:v name:s* #terms:v #contexts:v #definitions:v
+body:   record* end
+record: tag:1 payload (every object is written once, after the objects it refers to)
+        term        star | square | var name:n | appl M:r N:r
+                    | lambda/pi x:r A:r M:r | const name:n k:v r*k
+        context     k:v (x:r A:r)*k
+        definition  name:n context:r definiens:r type:r   (in the order of the environment)
+(v: LEB128 varint, s: string, n: index of names,
+ r: varint of 1 + index among the objects of its kind, or 0 for null)
+terms and contexts shared in the environment (e.g. flag contexts) are written once and shared again when read.
+ */
+
+inline constexpr const char DEFBIN_MAGIC[] = "FPDB";
+inline constexpr uint64_t DEFBIN_VERSION = 1;
+
+bool is_defbin(std::string_view head);
+
+void write_defbin(std::ostream& os, const Environment& env);
+// decodes data in place (e.g. a mapped file); throws FileError if it is malformed or of another version
+Environment read_defbin(std::string_view data, const std::string& srcname = "");
@@ -3,10 +3,11 @@
 #include <memory>
 #include <string>
 
+#include "alloc_track.hpp"
 #include "context.hpp"
 #include "lambda.hpp"
 
-class Definition {
+class Definition : private alloc_track::Tracked<Definition> {
   public:
     Definition(const std::shared_ptr<Context>& context,
                const std::string& cname,
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+
+#include "definition.hpp"
+#include "inference.hpp"
+
+/*
+#####  derivation cache  #####
+header: "FPDC" version:v #entries:v
+entry:  key:8 size:v #nodes:v node* root:r   (size: bytes from #nodes to root)
+node:   rtype:1 payload (every node is written once, after the nodes it refers to)
+        sort
+        var    idx:r name:s
+        weak   idx1:r idx2:r name:s
+        form   idx1:r idx2:r            (appl, abst, conv as well)
+        def    idx1:r idx2:r name:s     (defpr as well)
+        inst   idx:r n:v k:r*n const:s  (the constant by name, since its index depends on the environment)
+(r: 0 for the base derivation "Δ; {} |- * : @" the definition is added on top of, 1 + index of a node otherwise)
+ */
+
+inline constexpr const char DERIVATION_CACHE_MAGIC[] = "FPDC";
+inline constexpr uint64_t DERIVATION_CACHE_VERSION = 1;
+
+// content hash of def chained with the keys of the constants it refers to,
+// i.e. it changes whenever def or anything its derivation depends on changes
+uint64_t derivation_key(const std::shared_ptr<Definition>& def, const std::map<std::string, uint64_t>& keys);
+
+// derivations of the definiens (or the type, if primitive) of each definition in Δ; {}, keyed by derivation_key()
+class DerivationCache {
+  public:
+    // a missing file is an empty cache; throws FileError if the file is malformed
+    void load(const std::string& fname);
+    // writes the entries used in this run, and the other loaded ones unless prune is set
+    // (prune after deriving the whole file to drop the entries of removed or changed definitions)
+    void save(const std::string& fname, bool prune = true) const;
+
+    // Δ, D; {} |- * : @ for D = def and Δ = delta (def is pushed onto delta), derived from Δ; {} |- * : @
+    // and the derivation of D under Δ, the latter taken from the cache if neither D nor the definitions it depends on changed
+    // (the definitions of Δ must have been added by derive() in order)
+    RulePtr derive(const Delta& delta, const std::shared_ptr<Definition>& def);
+
+    // rebuilds the cached derivation on top of base under delta; nullptr if key is not cached
+    // throws FileError if the entry is malformed
+    RulePtr lookup(uint64_t key, const RulePtr& base, const Delta& delta);
+    void store(uint64_t key, const RulePtr& root, const RulePtr& base, const Delta& delta);
+
+    size_t hits() const { return _hits; }
+    size_t misses() const { return _misses; }
+
+  private:
+    std::map<uint64_t, std::string> _loaded, _used;
+    // derivation_key() of each definition given to derive()
+    std::map<std::string, uint64_t> _keys;
+    size_t _hits = 0, _misses = 0;
+};
@@ -1,24 +1,32 @@
 #pragma once
 
+#include <cstdint>
 #include <map>
 #include <memory>
+#include <set>
 #include <string>
 #include <vector>
 
+#include "alloc_track.hpp"
 #include "definition.hpp"
 #include "lambda.hpp"
 
-class Environment : public std::vector<std::shared_ptr<Definition>> {
+class Environment : public std::vector<std::shared_ptr<Definition>, alloc_track::Allocator<std::shared_ptr<Definition>, Environment>>, private alloc_track::Tracked<Environment> {
   public:
     Environment();
     Environment(const std::vector<std::shared_ptr<Definition>>& defs);
-    Environment(const std::string& fname);
+    Environment(const std::string& fname);  // a definition file, or one compiled by def_conv -b
     std::string string(bool inSingleLine = true, size_t indentSize = 0) const;
     std::string string_brief(bool inSingleLine, size_t indentSize) const;
     std::string string_simple() const;
     std::string repr() const;
     std::string repr_new() const;
 
+    // whether some definition is of the name, or of a name beginning with prefix (in O(log n) for the parsers,
+    // plus the names of the prefix that only other copies of this environment have)
+    bool has_name(const std::string& cname) const;
+    bool has_prefix(const std::string& prefix) const;
+
     int lookup_index(const std::string& cname) const;
     int lookup_index(const std::shared_ptr<Constant>& c) const;
 
@@ -28,8 +36,22 @@ class Environment : public std::vector<std::shared_ptr<Definition>> {
     Environment& operator+=(const std::shared_ptr<Definition>& def);
     Environment operator+(const std::shared_ptr<Definition>& def) const;
 
+    // the same id for every environment of the same definitions (compared by text), in any thread
+    uint32_t content_id() const;
+
   private:
+    // names of a run of definitions to the first index of each, shared by the copies of an environment
+    // (e.g. Δ and Δ, D in a book) and extended by whichever of them appends to the run
+    struct NameIndex {
+        std::map<std::string, size_t> first;
+        std::vector<const Definition*> defs;
+        std::vector<uint32_t> content_ids;  // content_id() of each prefix of defs, filled on demand
+    };
+    // brings _names up to date with this environment; names of index size() or above are not ours
+    void index_names() const;
+
     mutable std::map<std::string, size_t> _def_index;
+    mutable std::shared_ptr<NameIndex> _names;
 };
 
 bool equiv_env(const Environment& a, const Environment& b);
@@ -53,5 +75,11 @@ bool is_constant_primitive(const std::string& cname, const Environment& delta);
 
 bool is_convertible(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b, const Environment& delta);
 
+// set before the work starts (verifier --batch): is_convertible_shared() remembers the pairs found convertible
+// in a table shared by all threads, so that the books of a batch check each conversion once
+inline bool shared_conversions = false;
+// is_convertible(), looked up in and added to the shared table when shared_conversions is set
+bool is_convertible_shared(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b, const Environment& delta);
+
 std::set<std::string> extract_constant(const Environment& env);
 std::set<std::string> extract_constant(const std::shared_ptr<Environment>& env);
@@ -4,9 +4,11 @@
 #include <memory>
 #include <string>
 
+#include "alloc_track.hpp"
 #include "common.hpp"
 #include "context.hpp"
 #include "environment.hpp"
+#include "instrument.hpp"
 #include "lambda.hpp"
 
 class TypeError {
@@ -54,12 +56,15 @@ class Rule {
 
 using RulePtr = std::shared_ptr<Rule>;
 
-class Sort : public Rule {
+// # of rules constructed, and # of get_script() calls and of those answered from the memo (shown by genscript progress)
+extern instrument::ProgressCounter issued_rules, cache_hit, genscr_called;
+
+class Sort : public Rule, private alloc_track::Tracked<Sort> {
   public:
     Sort();
 };
 
-class Var : public Rule {
+class Var : public Rule, private alloc_track::Tracked<Var> {
   public:
     Var(const RulePtr& idx, const std::string& vname);
     RulePtr& idx();
@@ -70,7 +75,7 @@ class Var : public Rule {
     std::string _var;
 };
 
-class Weak : public Rule {
+class Weak : public Rule, private alloc_track::Tracked<Weak> {
   public:
     Weak(const RulePtr& idx1, const RulePtr& idx2, const std::string& var);
     RulePtr& idx1();
@@ -82,7 +87,7 @@ class Weak : public Rule {
     std::string _var;
 };
 
-class Form : public Rule {
+class Form : public Rule, private alloc_track::Tracked<Form> {
   public:
     Form(const RulePtr& idx1, const RulePtr& idx2);
     RulePtr& idx1();
@@ -92,7 +97,7 @@ class Form : public Rule {
     RulePtr _idx1, _idx2;
 };
 
-class Appl : public Rule {
+class Appl : public Rule, private alloc_track::Tracked<Appl> {
   public:
     Appl(const RulePtr& idx1, const RulePtr& idx2);
     RulePtr& idx1();
@@ -102,7 +107,7 @@ class Appl : public Rule {
     RulePtr _idx1, _idx2;
 };
 
-class Abst : public Rule {
+class Abst : public Rule, private alloc_track::Tracked<Abst> {
   public:
     Abst(const RulePtr& idx1, const RulePtr& idx2);
     RulePtr& idx1();
@@ -112,7 +117,7 @@ class Abst : public Rule {
     RulePtr _idx1, _idx2;
 };
 
-class Conv : public Rule {
+class Conv : public Rule, private alloc_track::Tracked<Conv> {
   public:
     Conv(const RulePtr& idx1, const RulePtr& idx2);
     RulePtr& idx1();
@@ -122,7 +127,7 @@ class Conv : public Rule {
     RulePtr _idx1, _idx2;
 };
 
-class Def : public Rule {
+class Def : public Rule, private alloc_track::Tracked<Def> {
   public:
     Def(const RulePtr& idx1, const RulePtr& idx2, const std::string& name);
     RulePtr& idx1();
@@ -134,7 +139,7 @@ class Def : public Rule {
     std::string _name;
 };
 
-class Defpr : public Rule {
+class Defpr : public Rule, private alloc_track::Tracked<Defpr> {
   public:
     Defpr(const RulePtr& idx1, const RulePtr& idx2, const std::string& name);
     RulePtr& idx1();
@@ -146,7 +151,7 @@ class Defpr : public Rule {
     std::string _name;
 };
 
-class Inst : public Rule {
+class Inst : public Rule, private alloc_track::Tracked<Inst> {
   public:
     Inst(const RulePtr& idx, const size_t& n, const std::vector<RulePtr>& k, const size_t& p);
     RulePtr& idx();
@@ -173,5 +178,10 @@ class DeductionError {
 };
 
 RulePtr get_script(const std::shared_ptr<Term>& term, const Delta& delta, const Gamma& gamma);
+// makes get_script(term, delta, gamma) return rule (e.g. a derivation restored from a cache)
+void register_script(const std::shared_ptr<Term>& term, const Delta& delta, const Gamma& gamma, const RulePtr& rule);
+// forgets every derivation made by get_script() or given by register_script(),
+// and makes the next generate_script() number its lines from 0 again
+void clear_scripts();
 
 void generate_script(RulePtr& rule, TextData& data);
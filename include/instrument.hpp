@@ -0,0 +1,207 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "trace.hpp"
+
+// named counters, histograms and scoped timers for the hot paths of the kernel.
+// instruments of BasicCounter<INSTRUMENT> etc. compile to nothing unless INSTRUMENT (common.hpp) is set;
+// the counters shown by the progress lines are always on (ProgressCounter).
+// every instrument is a static object registering itself by name, and dump() prints all of them.
+// a hot function has a single probe point (Probe, ProbeScope), which serves verifier --profile
+// and genscript --trace as well as the timers.
+
+namespace instrument {
+
+class Instrument {
+  public:
+    const char* name() const { return _name; }
+    virtual void print(std::ostream& os) const = 0;
+    virtual void print_json(std::ostream& os) const = 0;
+
+  protected:
+    explicit Instrument(const char* name) : _name(name) {}
+    ~Instrument() = default;
+    // called by the constructor of an enabled instrument (the registry is never shrunk: instruments are static)
+    void enroll();
+
+  private:
+    const char* _name;
+};
+
+// a relaxed atomic counter, readable while other threads are counting
+template <bool Enabled = INSTRUMENT>
+class BasicCounter : public Instrument {
+  public:
+    explicit BasicCounter(const char* name) : Instrument(name) {
+        if constexpr (Enabled) enroll();
+    }
+    void add(uint64_t n = 1) {
+        if constexpr (Enabled) _value.fetch_add(n, std::memory_order_relaxed);
+    }
+    BasicCounter& operator++() { return add(), *this; }
+    uint64_t value() const { return _value.load(std::memory_order_relaxed); }
+    operator uint64_t() const { return value(); }
+
+    void print(std::ostream& os) const override;
+    void print_json(std::ostream& os) const override;
+
+  private:
+    std::atomic<uint64_t> _value = 0;
+};
+
+using Counter = BasicCounter<INSTRUMENT>;
+using ProgressCounter = BasicCounter<true>;
+
+// the distribution of a value in power-of-two buckets (bucket i holds [2^(i-1), 2^i), bucket 0 holds 0)
+template <bool Enabled = INSTRUMENT>
+class BasicHistogram : public Instrument {
+  public:
+    static constexpr size_t Buckets = 65;
+
+    explicit BasicHistogram(const char* name, const char* unit = "") : Instrument(name), _unit(unit) {
+        if constexpr (Enabled) enroll();
+    }
+    void record(uint64_t v) {
+        if constexpr (Enabled) {
+            size_t b = 0;
+            for (uint64_t x = v; x > 0; x >>= 1) ++b;
+            _buckets[b].fetch_add(1, std::memory_order_relaxed);
+            _count.fetch_add(1, std::memory_order_relaxed);
+            _sum.fetch_add(v, std::memory_order_relaxed);
+            uint64_t m = _max.load(std::memory_order_relaxed);
+            while (v > m && !_max.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+        }
+    }
+    uint64_t count() const { return _count.load(std::memory_order_relaxed); }
+    uint64_t sum() const { return _sum.load(std::memory_order_relaxed); }
+    uint64_t max() const { return _max.load(std::memory_order_relaxed); }
+    // the upper bound of the bucket holding the q-quantile (0 <= q <= 1)
+    uint64_t quantile(double q) const;
+
+    void print(std::ostream& os) const override;
+    void print_json(std::ostream& os) const override;
+
+  private:
+    const char* _unit;
+    std::array<std::atomic<uint64_t>, Buckets> _buckets{};
+    std::atomic<uint64_t> _count = 0, _sum = 0, _max = 0;
+};
+
+using Histogram = BasicHistogram<INSTRUMENT>;
+
+// a histogram of the wall time (ns) of each call, recursive calls included
+template <bool Enabled = INSTRUMENT>
+class BasicTimer : public BasicHistogram<Enabled> {
+  public:
+    explicit BasicTimer(const char* name) : BasicHistogram<Enabled>(name, "ns") {}
+};
+
+using Timer = BasicTimer<INSTRUMENT>;
+
+// records the time from its construction to its destruction to a timer
+template <bool Enabled>
+class BasicScopedTimer {
+  public:
+    explicit BasicScopedTimer(BasicTimer<Enabled>& timer) : _timer(timer) {
+        if constexpr (Enabled) _start = std::chrono::steady_clock::now();
+    }
+    ~BasicScopedTimer() {
+        if constexpr (Enabled) _timer.record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count());
+    }
+    BasicScopedTimer(const BasicScopedTimer&) = delete;
+    BasicScopedTimer& operator=(const BasicScopedTimer&) = delete;
+
+  private:
+    BasicTimer<Enabled>& _timer;
+    std::chrono::steady_clock::time_point _start;
+};
+
+using ScopedTimer = BasicScopedTimer<INSTRUMENT>;
+
+// set before the work starts (verifier --profile): probes count and time their outermost calls
+extern bool profiling;
+
+// the probe point of a hot function, for every way of measuring it:
+//   - a Timer of every call, compiled in with INSTRUMENT like the other instruments
+//   - while profiling is set, the count and time of its outermost calls on each thread (nested calls are part of them)
+//   - while trace::enabled is set, a trace event per call if the probe is traced
+// label: its name in the profile and the trace category (e.g. "NF" of "environment.NF")
+class Probe : public Timer {
+  public:
+    Probe(const char* name, const char* label, bool traced = false);
+
+    const char* label() const { return _label; }
+    bool is_traced() const { return _traced; }
+    uint64_t outer_calls() const { return _outer_calls.load(std::memory_order_relaxed); }
+    uint64_t outer_ns() const { return _outer_ns.load(std::memory_order_relaxed); }
+
+  private:
+    friend class ProbeScope;
+    // # of calls of this probe being made on the calling thread
+    size_t& depth();
+    void add_outer(uint64_t ns) {
+        _outer_calls.fetch_add(1, std::memory_order_relaxed);
+        _outer_ns.fetch_add(ns, std::memory_order_relaxed);
+    }
+
+    const char* _label;
+    bool _traced;
+    size_t _index;
+    std::atomic<uint64_t> _outer_calls = 0, _outer_ns = 0;
+};
+
+// all the probes, in the order of construction
+std::vector<const Probe*> probes();
+
+// measures a call of a probe from its construction to its destruction.
+// unless INSTRUMENT is set, a call made while neither profiling nor trace::enabled is set
+// costs one branch: the clock is read only for the measurements taken
+class ProbeScope {
+  public:
+    // the trace event is named after the label, or after event
+    explicit ProbeScope(Probe& probe) : _probe(probe) {
+        if (INSTRUMENT || profiling || trace::enabled) enter();
+    }
+    ProbeScope(Probe& probe, const std::string& event) : _probe(probe) {
+        if (INSTRUMENT || profiling || trace::enabled) enter();
+        if (_event) _event = event;
+    }
+    ~ProbeScope() {
+        if (_active) leave();
+    }
+    ProbeScope(const ProbeScope&) = delete;
+    ProbeScope& operator=(const ProbeScope&) = delete;
+
+    // e.g. after the rule is chosen
+    void rename(const std::string& event) {
+        if (_event) _event = event;
+    }
+
+  private:
+    void enter();
+    void leave();
+
+    Probe& _probe;
+    bool _active = false, _profiled = false;
+    std::chrono::steady_clock::time_point _start;
+    std::optional<std::string> _event;  // while traced
+    double _trace_start = 0;
+};
+
+// all the registered instruments, in the order of registration
+void dump(std::ostream& os = std::cerr);
+void dump_json(std::ostream& os);
+// throws FileError if fname cannot be written
+void dump_json(const std::string& fname);
+
+}  // namespace instrument
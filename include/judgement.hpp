@@ -3,18 +3,22 @@
 #include <memory>
 #include <string>
 
+#include "alloc_track.hpp"
 #include "environment.hpp"
 #include "lambda.hpp"
+#include "pool.hpp"
 
-class Judgement {
+// the four components are handles into SharedPool (16 bytes in total).
+// pass the handles of an existing judgement (env_handle() etc.) to share its components.
+class Judgement : private alloc_track::Tracked<Judgement> {
   public:
-    Judgement(const std::shared_ptr<Environment>& env,
-              const std::shared_ptr<Context>& context,
-              const std::shared_ptr<Term>& proof,
-              const std::shared_ptr<Term>& prop);
-    Judgement(const std::shared_ptr<Environment>& env,
-              const std::shared_ptr<Context>& context,
-              const std::shared_ptr<Term>& prop);
+    Judgement(PoolHandle<Environment> env,
+              PoolHandle<Context> context,
+              PoolHandle<Term> proof,
+              PoolHandle<Term> prop);
+    Judgement(PoolHandle<Environment> env,
+              PoolHandle<Context> context,
+              PoolHandle<Term> prop);
     std::string string(bool inSingleLine = true, size_t indentSize = 0) const;
     std::string string_brief(bool inSingleLine, size_t indentSize) const;
     std::string string_simple() const;
@@ -24,13 +28,13 @@ class Judgement {
     const std::shared_ptr<Term>& term() const;
     const std::shared_ptr<Term>& type() const;
 
-    std::shared_ptr<Environment>& env();
-    std::shared_ptr<Context>& context();
-    std::shared_ptr<Term>& term();
-    std::shared_ptr<Term>& type();
+    const PoolHandle<Environment>& env_handle() const { return _env; }
+    const PoolHandle<Context>& context_handle() const { return _context; }
+    const PoolHandle<Term>& term_handle() const { return _term; }
+    const PoolHandle<Term>& type_handle() const { return _type; }
 
   private:
-    std::shared_ptr<Environment> _env;
-    std::shared_ptr<Context> _context;
-    std::shared_ptr<Term> _term, _type;
+    PoolHandle<Environment> _env;
+    PoolHandle<Context> _context;
+    PoolHandle<Term> _term, _type;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <cstdint>
 #include <iostream>
 #include <map>
 #include <memory>
@@ -10,7 +12,9 @@
 #include <utility>
 #include <vector>
 
+#include "alloc_track.hpp"
 #include "common.hpp"
+#include "pool.hpp"
 
 /*
 #####  definitions  #####
@@ -76,20 +80,20 @@ class Term {
     EpsilonType _etype;
 };
 
-class Star : public Term {
+class Star : public Term, private alloc_track::Tracked<Star> {
   public:
     Star();
     std::string string() const override;
 };
 
-class Square : public Term {
+class Square : public Term, private alloc_track::Tracked<Square> {
   public:
     Square();
     std::string string() const override;
     std::string repr() const override;
 };
 
-class Variable : public Term {
+class Variable : public Term, private alloc_track::Tracked<Variable> {
   public:
     // Variable(char ch);
     // Variable(int idx);
@@ -108,7 +112,7 @@ class Variable : public Term {
     std::string _var_name;
 };
 
-class Application : public Term {
+class Application : public Term, private alloc_track::Tracked<Application> {
   public:
     Application(std::shared_ptr<Term> m, std::shared_ptr<Term> n);
 
@@ -149,7 +153,7 @@ class Typed {
     std::shared_ptr<Term> _type;
 };
 
-class AbstLambda : public Term {
+class AbstLambda : public Term, private alloc_track::Tracked<AbstLambda> {
   public:
     AbstLambda(const Typed<Variable>& v, std::shared_ptr<Term> e);
     AbstLambda(std::shared_ptr<Term> v, std::shared_ptr<Term> t, std::shared_ptr<Term> e);
@@ -170,7 +174,7 @@ class AbstLambda : public Term {
     std::shared_ptr<Term> _expr;
 };
 
-class AbstPi : public Term {
+class AbstPi : public Term, private alloc_track::Tracked<AbstPi> {
   public:
     AbstPi(const Typed<Variable>& v, std::shared_ptr<Term> e);
     AbstPi(std::shared_ptr<Term> v, std::shared_ptr<Term> t, std::shared_ptr<Term> e);
@@ -191,7 +195,7 @@ class AbstPi : public Term {
     std::shared_ptr<Term> _expr;
 };
 
-class Constant : public Term {
+class Constant : public Term, private alloc_track::Tracked<Constant> {
   public:
     Constant(const std::string& name, std::vector<std::shared_ptr<Term>> list);
     template <class... Ts>
@@ -213,6 +217,10 @@ class Constant : public Term {
     std::vector<std::shared_ptr<Term>> _args;
 };
 
+// true if name can be the name of a Variable as written by this program: nonempty, of [A-Za-z0-9_]
+// (the names of the parsed variables and of the fresh ones, "__0" etc.)
+bool is_variable_name(const std::string& name);
+
 // shared_ptr constructors
 std::shared_ptr<Variable> variable(int idx);
 std::shared_ptr<Variable> variable(const std::string& ch);
@@ -249,7 +257,7 @@ std::set<std::string> free_var(const std::shared_ptr<Term>& term, Ts... data) {
 
 bool is_free_var(const std::shared_ptr<Term>& term, const std::shared_ptr<Variable>& var);
 
-extern int _fresh_var_id;
+extern std::atomic<int> _fresh_var_id;
 extern std::set<std::string> _char_vars_set;
 extern const std::string _preferred_names;
 
@@ -281,6 +289,8 @@ std::shared_ptr<Variable> get_fresh_var(const std::shared_ptr<Term>& term, Ts...
 }
 
 std::shared_ptr<Variable> get_fresh_var(const std::vector<std::shared_ptr<Term>>& terms);
+// fresh with respect to the given free variables (computed once by the caller)
+std::shared_ptr<Variable> get_fresh_var(const std::set<std::string>& used);
 
 std::shared_ptr<Term> rename_var_short(std::shared_ptr<Term> term);
 
@@ -288,7 +298,10 @@ std::shared_ptr<Term> substitute(const std::shared_ptr<Term>& term, const std::s
 std::shared_ptr<Term> substitute(const std::shared_ptr<Term>& term, const std::shared_ptr<Term>& var_bind, const std::shared_ptr<Term>& expr);
 std::shared_ptr<Term> substitute(const std::shared_ptr<Term>& term, const std::vector<std::shared_ptr<Variable>>& vars, const std::vector<std::shared_ptr<Term>>& exprs);
 
+// equal as written (bound variable names included); exact_hash agrees with it.
+// exact_hash only looks depth levels down
 bool exact_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b);
+size_t exact_hash(const Term& term, size_t depth = SIZE_MAX);
 bool alpha_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b);
 
 template <class T, class U>
@@ -324,3 +337,10 @@ class InferenceError {
 };
 
 std::set<std::string> extract_constant(const std::shared_ptr<Term>& term);
+
+// with pool_interning, a term put into SharedPool shares the slot of an equal term already there
+template <>
+struct PoolKey<Term> {
+    static size_t hash(const std::shared_ptr<Term>& t) { return exact_hash(*t); }
+    static bool equal(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b) { return exact_comp(a, b); }
+};
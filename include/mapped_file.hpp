@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+// read-only view of a whole file mapped into memory
+// throws FileError when the file cannot be opened or mapped
+class MappedFile {
+  public:
+    MappedFile() = default;
+    MappedFile(const std::string& fname);
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+    std::string_view view() const { return std::string_view(_data, _size); }
+    const std::string& name() const { return _filename; }
+
+  private:
+    void unmap();
+    const char* _data = nullptr;
+    size_t _size = 0;
+    std::string _filename;
+};
+
+// yields lines one by one without copying them
+// regular files are mapped into memory, anything else (pipes, terminals) is read in chunks,
+// so the caller can start processing before the whole input arrives.
+// the view returned by next() is valid until the next call of next().
+class LineReader {
+  public:
+    LineReader();  // stdin
+    LineReader(const std::string& fname);
+    ~LineReader();
+    LineReader(const LineReader&) = delete;
+    LineReader& operator=(const LineReader&) = delete;
+
+    bool next(std::string_view& line);
+    size_t lno() const { return _lno; }  // number of lines read so far
+    const std::string& name() const { return _filename; }
+
+  private:
+    bool fill();
+    int _fd = -1;
+    bool _owns_fd = false, _eof = false;
+    MappedFile _mapped;
+    bool _is_mapped = false;
+    std::string _buf;  // chunk buffer (unmapped input)
+    size_t _begin = 0, _end = 0;
+    size_t _lno = 0;
+    std::string _filename;
+};
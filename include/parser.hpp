@@ -3,11 +3,13 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "common.hpp"
 #include "environment.hpp"
 #include "lambda.hpp"
+#include "source_buffer.hpp"
 
 enum class TokenType {
     Unclassified,
@@ -56,46 +58,46 @@ TokenType sym2tokentype(char ch);
 
 std::ostream& operator<<(std::ostream& os, const TokenType& t);
 
+// view of a token in a SourceBuffer (32 bytes)
 class Token {
   public:
-    Token(const FileData& lines,
+    static constexpr uint32_t NoId = UINT32_MAX;
+
+    Token(const SourceBuffer& src,
           size_t lno,
           size_t pos,
           size_t len,
-          TokenType type = TokenType::Unclassified)
-        : _data(lines),
+          TokenType type = TokenType::Unclassified,
+          uint32_t id = NoId)
+        : _src(&src),
           _lno(lno),
           _pos(pos),
           _len(len),
+          _id(id),
           _type(type) {}
-    Token(const FileData& lines,
+    // end of line lno
+    Token(const SourceBuffer& src,
           size_t lno,
           TokenType type = TokenType::Unclassified)
-        : Token(lines, lno, std::string::npos, 0, type) {}
-    std::string string() const {
-        if (_len == 0 || _data[_lno].size() <= _pos) return "";
-        return _data[_lno].substr(_pos, _len);
+        : Token(src, lno, src.line(lno).size(), 0, type) {}
+    std::string string() const { return std::string(view()); }
+    std::string_view view() const {
+        if (_len == 0 || line().size() <= _pos) return std::string_view();
+        return line().substr(_pos, _len);
     }
-    const std::string& line() const { return _data[_lno]; }
-    std::string filename() const { return _data.name(); }
+    std::string_view line() const { return _src->line(lno()); }
+    std::string filename() const { return _src->name(); }
     TokenType type() const { return _type; }
-    size_t lno() const { return std::min(_lno, _data.size() - 1); }
-    size_t pos() const { return std::min(_pos, _data[lno()].size()); }
-    size_t len() const { return std::min(_len, _data[lno()].size()); }
-    const FileData& filedata() const { return _data; }
-    // std::string pos_info_str() const {
-    //     std::string res(_data.name());
-    //     if (res.size() > 0) res += ":";
-    //     res += std::to_string(lno() + 1);
-    //     res += ":" + std::to_string(pos() + 1);
-    //     if (_len > 1) res += "-" + std::to_string(std::min(pos() + len(), _data[_lno].size()) + 1);
-    //     return res;
-    // }
-    // friend std::string pos_info_str(const Token& t1, const Token& t2);
+    // interned id of an identifier (String or Character), NoId otherwise
+    uint32_t id() const { return _id; }
+    size_t lno() const { return std::min<size_t>(_lno, _src->lines() - 1); }
+    size_t pos() const { return std::min<size_t>(_pos, line().size()); }
+    size_t len() const { return std::min<size_t>(_len, line().size()); }
+    const SourceBuffer& source() const { return *_src; }
 
   private:
-    const FileData& _data;
-    const size_t _lno, _pos, _len;
+    const SourceBuffer* _src;
+    uint32_t _lno, _pos, _len, _id;
     TokenType _type;
 };
 
@@ -162,28 +164,28 @@ class BaseError {
             if (lno_end - lno_begin > 10) {
                 for (size_t lno_i = lno_begin; lno_i < lno_begin + 5; ++lno_i) {
                     std::string lno_i_str = std::to_string(lno_i + 1);
-                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.filedata()[lno_i] << "\n";
+                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.source().line(lno_i) << "\n";
                 }
                 os << std::string(lno_str_len, '~') << " |\n";
                 os << std::string(lno_str_len, '~') << " | ... (" << lno_end - lno_begin - 10 << " lines) ...\n";
                 os << std::string(lno_str_len, '~') << " |\n";
                 for (size_t lno_i = lno_end - 4; lno_i <= lno_end; ++lno_i) {
                     std::string lno_i_str = std::to_string(lno_i + 1);
-                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.filedata()[lno_i] << "\n";
+                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.source().line(lno_i) << "\n";
                 }
                 os << std::flush;
             } else {
                 for (size_t lno_i = lno_begin; lno_i <= lno_end; ++lno_i) {
                     std::string lno_i_str = std::to_string(lno_i + 1);
-                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.filedata()[lno_i] << "\n";
+                    os << std::string(lno_str_len - lno_i_str.size(), ' ') << lno_i + 1 << " | " << _token.source().line(lno_i) << "\n";
                 }
                 os << std::flush;
             }
             int end_pos = pos2 + len2 - 1;
             os << std::string(lno_str_len, ' ') << " | " << std::string(std::max(end_pos - 6, 0), ' ') << std::string("...~~~").substr(std::max(6 - end_pos, 0)) << "^" << std::endl;
         }
-        if (_note) _note->puterror();
-        if (_next) _next->puterror();
+        if (_note) _note->puterror(os);
+        if (_next) _next->puterror(os);
     }
 
     void bind(const BaseError& e) { _note = std::make_shared<BaseError>(e); }
@@ -212,7 +214,8 @@ DEFINE_ERROR(ExprError);
 
 #undef DEFINE_ERROR
 
-std::vector<Token> tokenize(const FileData& lines);
+// identifiers are interned into src; the tokens refer to src
+std::vector<Token> tokenize(SourceBuffer& src);
 
 class ParseLambdaToken {
   public:
@@ -230,10 +233,36 @@ class ParseLambdaToken {
     std::shared_ptr<Term> _term;
 };
 
+// reads an expr from tokens[idx] and moves idx to its last token
+// parse_lambda_legacy() remains the parser of record; a fast path in front of it takes well-formed exprs
+// (arrows by precedence climbing, in linear time) and hands everything else over, so those are accepted
+// or reported just as before. the inputs handed over are:
+//   - every malformed expr (all errors are the legacy parser's)
+//   - a variable right before an arrow, ',', ']' or '.' inside % or an abstraction body,
+//     whose reading depends on spacing ("%f x->y" is %f (x->y), "%f x -> y" is (%f x) -> y)
+//   - spaces right after $ or ?
+//   - a defined name without its argument list, or with one of another length
+// no expr of resource/def_file (1269) is handed over; test.cpp compares both parsers on it.
+// the counters parser.fast_path and parser.fast_path.left (def_conv --stats, with INSTRUMENT) tell the rate on other files.
+// an input handed over costs what it did before the fast path, i.e. time quadratic in its length
+// (bench: 2.2 s for a malformed expr of 14k tokens, against 8.8 ms for the same expr well-formed).
+// the grammar is that of parse_lambda_legacy(): a change to it is made there, and the fast path throws LeaveFastPath
+// on the inputs concerned until it reads them the same way (test_parse_differential compares the two)
 std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens, size_t& idx, size_t end_of_token, bool exhaust_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions);
+// the shift-reduce parser, which defines the grammar and every error message
+std::shared_ptr<ParseLambdaToken> parse_lambda_legacy(const std::vector<Token>& tokens, size_t& idx, size_t end_of_token, bool exhaust_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions);
 std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens, size_t& idx, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions);
+// reads the whole of src as an expr. errors point into src: report them before it is freed
+std::shared_ptr<Term> parse_lambda(SourceBuffer& src, const Environment& definitions);
+// the buffers of these are kept for the errors thrown and never freed (see raw_string_sources()),
+// so a long-running process should own a SourceBuffer instead
 std::shared_ptr<Term> parse_lambda(const std::string& str, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions);
 std::shared_ptr<Term> parse_lambda(const std::string& str, const Environment& definitions);
 std::shared_ptr<Term> parse_lambda(const std::string& str);
+size_t raw_string_sources();
 
-Environment parse_defs(const std::vector<Token>& tokens);
+using ParseLambdaFunc = std::shared_ptr<ParseLambdaToken> (*)(const std::vector<Token>&, size_t&, size_t, bool, const std::vector<std::shared_ptr<Context>>&, const Environment&);
+Environment parse_defs(const std::vector<Token>& tokens, ParseLambdaFunc parse_expr = parse_lambda);
+// same result (or error) as parse_defs(), reading def2 - edef2 blocks on threads (0: as many as the hardware has)
+// against the names found by a quick first pass; falls back to parse_defs() on any error
+Environment parse_defs_parallel(const std::vector<Token>& tokens, size_t threads = 0, ParseLambdaFunc parse_expr = parse_lambda);
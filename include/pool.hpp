@@ -0,0 +1,157 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// set before the work starts (cleared by verifier --no-intern): SharedPool<T> shares a slot among equal objects (PoolKey<T>).
+// without it, each inserted object takes a slot of its own, and only the copies of a handle share one.
+inline bool pool_interning = true;
+
+// how SharedPool<T> finds an object equal to the one inserted with pool_interning: the same address unless specialized
+// (terms and contexts are compared by structure, see lambda.hpp and context.hpp)
+template <class T>
+struct PoolKey {
+    static size_t hash(const std::shared_ptr<T>& ptr) { return std::hash<T*>()(ptr.get()); }
+    static bool equal(const std::shared_ptr<T>& a, const std::shared_ptr<T>& b) { return a == b; }
+};
+
+// per-thread table of shared objects addressed by 32-bit ids (id 0 is nullptr)
+// each slot counts the handles referring to it and is recycled when the count drops to zero.
+// copying a handle shares its slot. inserting an object takes a new slot, unless pool_interning is set and
+// an equal (PoolKey<T>) object is live: then it shares that slot, so equal terms built apart
+// (e.g. the same type inferred twice) are kept once per thread.
+// a slot is 24 bytes (the shared_ptr, the count and the hash); with pool_interning, the index adds one id
+// per live slot at a load of at most 3/4 (an open-addressing table that reads the hashes from the slots).
+// not thread-safe: a handle must be created, copied and destroyed on the thread that created it, since the id
+// means nothing in the pool of another thread. no handle crosses threads: each book of verifier --batch lives
+// on one worker thread, the decoding thread of a pipelined script hands over ScriptRecords only, and the server
+// answers its clients on one thread.
+template <class T>
+class SharedPool {
+  public:
+    // intentionally leaked so that handles outliving static (or thread_local) destruction stay valid
+    static SharedPool& instance() {
+        static thread_local SharedPool* pool = new SharedPool();
+        return *pool;
+    }
+
+    uint32_t insert(const std::shared_ptr<T>& ptr) {
+        if (!ptr) return 0;
+        uint32_t hash = 0;
+        if (pool_interning) {
+            hash = PoolKey<T>::hash(ptr) & 0x7fffffff;
+            for (size_t i = hash & _mask; _index.size() > 0 && _index[i] != 0; i = (i + 1) & _mask) {
+                auto& slot = _slots[_index[i]];
+                if (slot.hash == hash && PoolKey<T>::equal(slot.ptr, ptr)) {
+                    ++slot.refs;
+                    return _index[i];
+                }
+            }
+        }
+        uint32_t id;
+        if (_free.size() > 0) {
+            id = _free.back();
+            _free.pop_back();
+        } else {
+            if (_slots.size() > UINT32_MAX) throw std::length_error("SharedPool: too many objects");
+            id = _slots.size();
+            _slots.emplace_back();
+        }
+        _slots[id].ptr = ptr;
+        _slots[id].refs = 1;
+        _slots[id].hash = hash;
+        _slots[id].indexed = pool_interning;
+        if (pool_interning) index(id);
+        return id;
+    }
+    void retain(uint32_t id) {
+        if (id > 0) ++_slots[id].refs;
+    }
+    void release(uint32_t id) {
+        if (id == 0 || --_slots[id].refs > 0) return;
+        if (_slots[id].indexed) unindex(id);
+        _slots[id].ptr.reset();
+        _free.push_back(id);
+    }
+    const std::shared_ptr<T>& get(uint32_t id) const { return _slots[id].ptr; }
+    size_t live() const { return _slots.size() - 1 - _free.size(); }
+
+  private:
+    SharedPool() { _slots.emplace_back(); }
+    struct Slot {
+        std::shared_ptr<T> ptr;
+        uint32_t refs = 0;
+        uint32_t hash : 31;
+        uint32_t indexed : 1;  // in _index (inserted with pool_interning)
+        Slot() : hash(0), indexed(0) {}
+    };
+
+    void index(uint32_t id) {
+        if ((_indexed + 1) * 4 > _index.size() * 3) {
+            std::vector<uint32_t> old(std::max<size_t>(16, _index.size() * 2), 0);
+            old.swap(_index);
+            _mask = _index.size() - 1;
+            for (auto&& k : old) {
+                if (k != 0) place(k);
+            }
+        }
+        place(id);
+        ++_indexed;
+    }
+    void place(uint32_t id) {
+        size_t i = _slots[id].hash & _mask;
+        while (_index[i] != 0) i = (i + 1) & _mask;
+        _index[i] = id;
+    }
+    // linear probing without tombstones: the entries after the removed one are shifted back into the gap
+    void unindex(uint32_t id) {
+        size_t i = _slots[id].hash & _mask;
+        while (_index[i] != id) i = (i + 1) & _mask;
+        for (size_t j = (i + 1) & _mask; _index[j] != 0; j = (j + 1) & _mask) {
+            size_t home = _slots[_index[j]].hash & _mask;
+            // the entry at j stays if its home lies cyclically in (i, j]
+            if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) continue;
+            _index[i] = _index[j];
+            i = j;
+        }
+        _index[i] = 0;
+        --_indexed;
+    }
+
+    std::deque<Slot> _slots;  // deque keeps get() references stable while inserting
+    std::vector<uint32_t> _free;
+    std::vector<uint32_t> _index;  // ids of the indexed slots by hash (0: empty), a power of two in size
+    size_t _mask = 0, _indexed = 0;
+};
+
+// refcounted 32-bit reference to an object in SharedPool<T>
+// copying a handle shares the slot; constructing one from a shared_ptr shares the slot of an equal object if any
+template <class T>
+class PoolHandle {
+  public:
+    PoolHandle() = default;
+    PoolHandle(std::nullptr_t) {}
+    template <class U, class = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    PoolHandle(const std::shared_ptr<U>& ptr) : _id(SharedPool<T>::instance().insert(ptr)) {}
+    PoolHandle(const PoolHandle& other) : _id(other._id) { SharedPool<T>::instance().retain(_id); }
+    PoolHandle(PoolHandle&& other) noexcept : _id(std::exchange(other._id, 0)) {}
+    PoolHandle& operator=(PoolHandle other) noexcept {
+        std::swap(_id, other._id);
+        return *this;
+    }
+    ~PoolHandle() { SharedPool<T>::instance().release(_id); }
+
+    const std::shared_ptr<T>& ptr() const { return SharedPool<T>::instance().get(_id); }
+    uint32_t id() const { return _id; }
+    explicit operator bool() const { return _id != 0; }
+
+  private:
+    uint32_t _id = 0;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+
+// profiling for verifier --profile: the time of every rule applied to a Book,
+// and of the probes of instrument.hpp (only measured while instrument::profiling is set)
+
+enum class RuleType;
+
+// count, total and maximum time of each type of rule, with the line of the slowest one
+class RuleProfile {
+  public:
+    void record(RuleType type, size_t lno, uint64_t ns);
+
+    // a table of the rules and of the probes called
+    void print(std::ostream& os) const;
+    void write_json(std::ostream& os) const;
+
+  private:
+    struct Stat {
+        uint64_t count = 0, total_ns = 0, max_ns = 0;
+        size_t max_lno = 0;
+    };
+    std::array<Stat, 13> _rules;
+};
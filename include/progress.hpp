@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// the progress output of genscript and verifier, drawn on stderr by one background thread.
+// the sampler runs on that thread, so it must only read relaxed atomics (or data not written meanwhile).
+//   Tty:  redrawn in place with ANSI escapes (chosen by Auto only if stderr is a terminal)
+//   Json: one JSON object per line and per tick (and a last one with "finished": true), for job schedulers;
+//         written to the stream of set_output() (e.g. the file of --progress-json) apart from the messages on stderr
+//   Off:  no thread at all
+class ProgressReporter {
+  public:
+    enum class Mode { Auto, Tty, Json, Off };
+    // "auto", "tty", "json" or "off"; returns false for other strings
+    static bool parse_mode(const std::string& str, Mode& mode);
+
+    struct Sample {
+        uint64_t done = 0;
+        uint64_t total = 0;  // 0 if unknown
+        std::string status;  // e.g. the line or the definition being processed
+        std::vector<std::pair<const char*, double>> values;  // shown after the rate
+        std::vector<std::string> notes;  // extra lines (Tty only)
+    };
+
+    // label and unit name the counter, e.g. "progress" and "judgements"
+    ProgressReporter(Mode mode, const std::string& label, const std::string& unit, const std::function<Sample()>& sampler,
+                     std::chrono::milliseconds interval = std::chrono::milliseconds(200));
+    ~ProgressReporter();
+    ProgressReporter(const ProgressReporter&) = delete;
+    ProgressReporter& operator=(const ProgressReporter&) = delete;
+
+    Mode mode() const { return _mode; }
+    // where the Json records go (default: stderr); set before start()
+    void set_output(std::FILE* fp) { _out = fp; }
+    bool active() const { return _thread.joinable(); }
+
+    void start();
+    // wakes the thread up and joins it (the last drawing stays on the screen)
+    void stop();
+
+  private:
+    void run();
+    void draw(const Sample& sample, bool finished);
+
+    Mode _mode;
+    std::string _label, _unit;
+    std::function<Sample()> _sampler;
+    std::chrono::milliseconds _interval;
+    std::FILE* _out = stderr;
+    std::chrono::steady_clock::time_point _begin, _last_tick;
+    uint64_t _last_done = 0;
+    size_t _lines = 0, _width = 0;
+
+    std::thread _thread;
+    std::mutex _mtx;
+    std::condition_variable _cv;
+    bool _stopping = false;
+};
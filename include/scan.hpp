@@ -0,0 +1,123 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// byte scanners over input buffers, 32 (AVX2) or 16 (SSE2) bytes at a time with a portable fallback
+// every function returns end if nothing is found.
+// SIMD paths are chosen at compile time (-mavx2 for AVX2; SSE2 is the x86-64 baseline).
+
+namespace scan {
+
+// byte-at-a-time versions (also the reference for the SIMD ones)
+namespace scalar {
+
+inline const char* find(const char* p, const char* end, char a) {
+    while (p < end && *p != a) ++p;
+    return p;
+}
+
+inline const char* find_either(const char* p, const char* end, char a, char b) {
+    while (p < end && *p != a && *p != b) ++p;
+    return p;
+}
+
+// first byte that is neither ' ' nor '\t'
+inline const char* skip_blanks(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t')) ++p;
+    return p;
+}
+
+inline size_t count(const char* p, const char* end, char a) {
+    size_t n = 0;
+    for (; p < end; ++p) n += *p == a;
+    return n;
+}
+
+}  // namespace scalar
+
+#if defined(__AVX2__) || defined(__SSE2__)
+
+namespace detail {
+
+#if defined(__AVX2__)
+inline constexpr size_t Width = 32;
+using Vec = __m256i;
+inline Vec load(const char* p) { return _mm256_loadu_si256((const __m256i*)p); }
+inline Vec splat(char ch) { return _mm256_set1_epi8(ch); }
+inline Vec eq(Vec x, Vec y) { return _mm256_cmpeq_epi8(x, y); }
+inline Vec either(Vec x, Vec y) { return _mm256_or_si256(x, y); }
+inline uint32_t mask(Vec x) { return (uint32_t)_mm256_movemask_epi8(x); }
+inline constexpr uint32_t Full = 0xffffffffu;
+#else
+inline constexpr size_t Width = 16;
+using Vec = __m128i;
+inline Vec load(const char* p) { return _mm_loadu_si128((const __m128i*)p); }
+inline Vec splat(char ch) { return _mm_set1_epi8(ch); }
+inline Vec eq(Vec x, Vec y) { return _mm_cmpeq_epi8(x, y); }
+inline Vec either(Vec x, Vec y) { return _mm_or_si128(x, y); }
+inline uint32_t mask(Vec x) { return (uint32_t)_mm_movemask_epi8(x); }
+inline constexpr uint32_t Full = 0xffffu;
+#endif
+
+}  // namespace detail
+
+inline const char* find(const char* p, const char* end, char a) {
+    using namespace detail;
+    const Vec va = splat(a);
+    for (; end - p >= (ptrdiff_t)Width; p += Width) {
+        if (uint32_t m = mask(eq(load(p), va))) return p + __builtin_ctz(m);
+    }
+    return scalar::find(p, end, a);
+}
+
+inline const char* find_either(const char* p, const char* end, char a, char b) {
+    using namespace detail;
+    const Vec va = splat(a), vb = splat(b);
+    for (; end - p >= (ptrdiff_t)Width; p += Width) {
+        Vec x = load(p);
+        if (uint32_t m = mask(either(eq(x, va), eq(x, vb)))) return p + __builtin_ctz(m);
+    }
+    return scalar::find_either(p, end, a, b);
+}
+
+inline const char* skip_blanks(const char* p, const char* end) {
+    using namespace detail;
+    // runs are mostly short, so look at the first byte before loading a vector
+    if (p < end && *p != ' ' && *p != '\t') return p;
+    const Vec sp = splat(' '), tab = splat('\t');
+    for (; end - p >= (ptrdiff_t)Width; p += Width) {
+        Vec x = load(p);
+        uint32_t m = mask(either(eq(x, sp), eq(x, tab)));
+        if (m != Full) return p + __builtin_ctz(~m);
+    }
+    return scalar::skip_blanks(p, end);
+}
+
+inline size_t count(const char* p, const char* end, char a) {
+    using namespace detail;
+    const Vec va = splat(a);
+    size_t n = 0;
+    for (; end - p >= (ptrdiff_t)Width; p += Width) n += __builtin_popcount(mask(eq(load(p), va)));
+    return n + scalar::count(p, end, a);
+}
+
+inline constexpr const char* Isa = detail::Width == 32 ? "avx2" : "sse2";
+
+#else
+
+using scalar::count;
+using scalar::find;
+using scalar::find_either;
+using scalar::skip_blanks;
+inline constexpr const char* Isa = "scalar";
+
+#endif
+
+}  // namespace scan
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "binary.hpp"
+#include "common.hpp"
+#include "inference.hpp"
+
+/*
+#####  script line  #####
+text:   "lno op args..." (terminated by "-1")
+        sort
+        var   m x
+        weak  m n x
+        form  m n       (appl, abst, conv as well)
+        def   m n a     (defpr as well)
+        inst  m n k1 ... kn p
+        cp    m
+        sp    m n
+        tp    m
+ */
+
+class ScriptRecord {
+  public:
+    ScriptRecord(RuleType rtype = RuleType::Sort) : _rtype(rtype) {}
+
+    RuleType rtype() const { return _rtype; }
+    RuleType& rtype() { return _rtype; }
+    // indices of judgements referred to: m[, n] (inst: m, k_1, ..., k_n)
+    const std::vector<size_t>& refs() const { return _refs; }
+    std::vector<size_t>& refs() { return _refs; }
+    // inst: p (index of definition), sp: n (index of context)
+    size_t arg() const { return _arg; }
+    size_t& arg() { return _arg; }
+    // var, weak: name of variable, def, defpr: name of constant
+    const std::string& name() const { return _name; }
+    std::string& name() { return _name; }
+
+    void clear(RuleType rtype) {
+        _rtype = rtype;
+        _refs.clear();
+        _arg = 0;
+        _name.clear();
+    }
+
+    std::string string(size_t lno) const;
+    // 64-bit FNV-1a over the rule and its operands (independent of the notation it was read from)
+    uint64_t hash() const;
+
+  private:
+    RuleType _rtype;
+    std::vector<size_t> _refs;
+    size_t _arg = 0;
+    std::string _name;
+};
+
+enum class ScriptLineStatus {
+    Rule,
+    End,
+    Error
+};
+
+// decoded script line handed from the decoding stage to the checking stage
+struct ScriptItem {
+    ScriptLineStatus status = ScriptLineStatus::End;
+    ScriptRecord rec;
+    std::string errmsg;        // set with Error from parse_script_line
+    std::exception_ptr error;  // set with Error when decoding threw
+};
+
+// scans the line in place; i is the 0-indexed line number, i.e. the index of the judgement it derives
+ScriptLineStatus parse_script_line(std::string_view line, size_t i, ScriptRecord& rec, std::string& errmsg);
+
+// last_use[i]: the last line referring to the judgement of line i (i itself if no line does)
+// next yields records in order and returns false at the end of the script
+std::vector<size_t> script_last_use(const std::function<bool(ScriptRecord&)>& next);
+
+/*
+#####  binary script  #####
+header:  "FPSB" version:v
+record:  op:v operands...
+         judgement reference    -> zigzag v of (lno - ref), always a preceding line
+         variable/constant name -> v (index of name table); the index next to the last one
+                                   is followed by (len:v bytes), appending the name to the table
+         inst n, inst p, sp n   -> v
+trailer: SCRIPT_BINARY_END:v #records:v
+(v: LEB128 varint)
+ */
+
+inline constexpr const char SCRIPT_BINARY_MAGIC[] = "FPSB";
+inline constexpr uint64_t SCRIPT_BINARY_VERSION = 2;
+inline constexpr uint64_t SCRIPT_BINARY_END = 127;
+
+bool is_binary_script(const std::string& head);
+
+// writes the header at once and the records through a bounded buffer
+class ScriptBinaryWriter {
+  public:
+    ScriptBinaryWriter(std::ostream& os, size_t bufsize = 1 << 16);
+    void write(const ScriptRecord& rec);
+    // writes the trailer and flushes
+    void finish();
+    size_t size() const { return _lno; }
+
+  private:
+    void flush();
+    std::ostream& _os;
+    ByteWriter _buf;
+    size_t _bufsize;
+    std::map<std::string, size_t> _name_index;
+    size_t _lno = 0;
+};
+
+// the input is untrusted: lengths are checked against the data left and references against the line
+// number while decoding (throws FileError)
+class ScriptBinaryReader {
+  public:
+    ScriptBinaryReader(std::istream& is, const std::string& srcname = "");
+    bool next(ScriptRecord& rec);
+    // # of records, 0 until the trailer is read
+    size_t size() const { return _size; }
+    size_t lno() const { return _lno; }
+    const std::string& name() const { return _reader.name(); }
+
+  private:
+    size_t get_ref();
+    ByteReader _reader;
+    std::vector<std::string> _names;
+    size_t _size = 0, _lno = 0;
+    bool _finished = false;
+};
+
+// emits rules reachable from rule in topological order (lno is assigned on the way)
+void generate_script(RulePtr& rule, const std::function<void(size_t, const ScriptRecord&)>& emit);
+void generate_script(RulePtr& rule, ScriptBinaryWriter& writer);
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+#include "book.hpp"
+
+/*
+verifier --serve: answer requests over a Unix domain socket with one book kept in memory,
+so that the definitions, the interned terms and the caches stay warm between requests.
+a request is a line and so is its response ("ok ..." or "error ...", escape sequences and newlines removed).
+    type [@N] TERM   the type of TERM in the context of the N-th judgement (default: the last one)
+    append LINE      apply a script line (e.g. "12 appl 10 11") to the book; answers its judgement
+    check FILE       replace the book with the one of script FILE (text or binary)
+    show N           the N-th judgement
+    size             the # of judgements
+    undo [N]         drop the last N judgements (default: 1)
+    clear            empty the book
+    quit             close this connection
+    shutdown         close this connection and stop the server
+clients are served one at a time (an editor session is expected to keep one connection); each may send
+any number of requests. so that no client can hold the others off or grow the server without bound,
+a connection is closed with an error line when it sends nothing for IDLE_TIMEOUT_SEC seconds
+or a request longer than MAX_REQUEST_BYTES.
+*/
+
+class VerifierServer {
+  public:
+    // the definitions of book.env() are used for type queries while the book is empty
+    VerifierServer(Book& book, bool skip_check = false);
+
+    static constexpr int IDLE_TIMEOUT_SEC = 30;
+    static constexpr size_t MAX_REQUEST_BYTES = 1 << 20;
+
+    enum class Action { Continue, Close, Shutdown };
+    // answers a request; action is set by quit and shutdown
+    std::string handle(const std::string& request, Action& action);
+
+    // binds path (replacing a stale socket, but no other file) and serves until shutdown.
+    // throws FileError
+    void serve(const std::string& path);
+
+  private:
+    std::string type(const std::string& args);
+    std::string append(const std::string& args);
+    std::string check(const std::string& fname);
+
+    Book& _book;
+    bool _skip_check;
+    std::shared_ptr<Environment> _def_env;
+    std::shared_ptr<Context> _empty_context;
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "mapped_file.hpp"
+
+// whole text of an input in one contiguous buffer, indexed by line
+// regular files are mapped into memory and anything else is read once.
+// lines are split as by std::getline (a trailing newline does not start another line).
+// tokens refer to the buffer, so it must not be moved while they are alive.
+class SourceBuffer {
+  public:
+    SourceBuffer(const std::string& fname);  // throws FileError
+    SourceBuffer(std::istream& is, const std::string& srcname);
+    SourceBuffer(const SourceBuffer&) = delete;
+    SourceBuffer& operator=(const SourceBuffer&) = delete;
+
+    const std::string& name() const { return _name; }
+    std::string_view text() const { return _text; }
+    size_t lines() const { return _line_begin.size() - 1; }
+    // without the newline character
+    std::string_view line(size_t lno) const {
+        return _text.substr(_line_begin[lno], _line_begin[lno + 1] - 1 - _line_begin[lno]);
+    }
+
+    // identifiers of the same spelling share one id (and one copy of the spelling)
+    uint32_t intern(std::string_view str);
+    std::string_view identifier(uint32_t id) const { return _identifiers[id]; }
+    size_t identifiers() const { return _identifiers.size(); }
+
+  private:
+    void index_lines();
+
+    MappedFile _mapped;
+    std::string _owned;
+    std::string_view _text;
+    std::string _name;
+    std::vector<size_t> _line_begin;  // the last element is one past the end of the last line plus 1
+    std::unordered_map<std::string_view, uint32_t> _ids;
+    std::vector<std::string_view> _identifiers;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// bounded lock-free queue for exactly one producer thread and one consumer thread
+// items are swapped in and out of preallocated slots, so buffers owned by
+// T (e.g. vectors and strings) are recycled instead of reallocated
+template <class T>
+class SpscQueue {
+  public:
+    SpscQueue(size_t capacity = 1024) {
+        size_t siz = 1;
+        while (siz < capacity) siz <<= 1;
+        _slots.resize(siz);
+        _mask = siz - 1;
+    }
+
+    bool try_push(T& item) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head_cache > _mask) {
+            _head_cache = _head.load(std::memory_order_acquire);
+            if (tail - _head_cache > _mask) return false;
+        }
+        std::swap(_slots[tail & _mask], item);
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+    bool try_pop(T& item) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail_cache) {
+            _tail_cache = _tail.load(std::memory_order_acquire);
+            if (head == _tail_cache) return false;
+        }
+        std::swap(_slots[head & _mask], item);
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // blocking variants; give up (return false) once cancelled becomes true
+    bool push(T& item, const std::atomic_bool& cancelled) {
+        for (size_t spin = 0; !try_push(item); ++spin) {
+            if (cancelled.load(std::memory_order_relaxed)) return false;
+            backoff(spin);
+        }
+        return true;
+    }
+    bool pop(T& item, const std::atomic_bool& cancelled) {
+        for (size_t spin = 0; !try_pop(item); ++spin) {
+            if (cancelled.load(std::memory_order_relaxed)) return false;
+            backoff(spin);
+        }
+        return true;
+    }
+
+  private:
+    static void backoff(size_t spin) {
+        if (spin < 64) std::this_thread::yield();
+        else std::this_thread::sleep_for(std::chrono::microseconds(50));
+    }
+
+    std::vector<T> _slots;
+    size_t _mask;
+    // the consumer owns _head and the producer owns _tail; each caches the other's index
+    alignas(64) std::atomic<size_t> _head{0};
+    size_t _tail_cache = 0;
+    alignas(64) std::atomic<size_t> _tail{0};
+    size_t _head_cache = 0;
+};
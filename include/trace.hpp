@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <string>
+
+// events of the derivation for genscript --trace, in the Chrome trace-event format
+// (open the file in about:tracing or https://ui.perfetto.dev). nothing is recorded unless trace::enabled is set.
+// the events come from the traced probes of instrument.hpp.
+
+namespace trace {
+
+// set before the derivation starts
+extern bool enabled;
+
+// microseconds since the first call
+double now_us();
+
+// one complete event ("ph": "X"), from ts_us for dur_us, on the calling thread
+void record(const std::string& name, const char* category, double ts_us, double dur_us);
+
+size_t size();
+// {"traceEvents": [...]}; throws FileError if fname cannot be written
+void write(const std::string& fname);
+void write(std::ostream& os);
+
+}  // namespace trace
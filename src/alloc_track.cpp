@@ -0,0 +1,97 @@
+#include "alloc_track.hpp"
+
+#include <cxxabi.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <sstream>
+#include <vector>
+
+namespace alloc_track {
+
+namespace {
+
+std::mutex& registry_mutex() {
+    static std::mutex mtx;
+    return mtx;
+}
+
+std::vector<const ClassStats*>& registry() {
+    static std::vector<const ClassStats*> classes;
+    return classes;
+}
+
+void update_max(std::atomic<int64_t>& peak, int64_t v) {
+    int64_t m = peak.load(std::memory_order_relaxed);
+    while (v > m && !peak.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+}
+
+std::string human_bytes(int64_t bytes) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(1);
+    if (bytes < 1024) ss << bytes << " B";
+    else if (bytes < 1024 * 1024) ss << bytes / 1024.0 << " KiB";
+    else ss << bytes / 1024.0 / 1024.0 << " MiB";
+    return ss.str();
+}
+
+}  // namespace
+
+ClassStats::ClassStats(const std::string& name) : _name(name) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    // the registry (a static) is constructed before the handler is registered, so it outlives the handler
+    if (registry().empty()) std::atexit([]() { summary(std::cerr); });
+    registry().push_back(this);
+}
+
+void ClassStats::add(int64_t objects, int64_t bytes) {
+    if (objects > 0) _constructed.fetch_add(objects, std::memory_order_relaxed);
+    update_max(_peak, _live.fetch_add(objects, std::memory_order_relaxed) + objects);
+    update_max(_peak_bytes, _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+std::string class_name(const std::type_info& type) {
+    int status = 0;
+    char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+    std::string name = status == 0 ? demangled : type.name();
+    std::free(demangled);
+    return name;
+}
+
+void summary(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    if (registry().empty()) return;
+    auto classes = registry();
+    std::sort(classes.begin(), classes.end(), [](const ClassStats* a, const ClassStats* b) { return a->name() < b->name(); });
+    os << "[alloc_track]\n"
+       << std::left << std::setw(16) << "class" << std::right << std::setw(12) << "live" << std::setw(12) << "peak"
+       << std::setw(14) << "live bytes" << std::setw(14) << "peak bytes" << std::setw(14) << "constructed" << "\n";
+    int64_t live = 0, bytes = 0;
+    for (auto&& c : classes) {
+        os << std::left << std::setw(16) << c->name() << std::right << std::setw(12) << c->live() << std::setw(12) << c->peak()
+           << std::setw(14) << human_bytes(c->live_bytes()) << std::setw(14) << human_bytes(c->peak_bytes())
+           << std::setw(14) << c->constructed() << "\n";
+        live += c->live();
+        bytes += c->live_bytes();
+    }
+    os << std::left << std::setw(16) << "(total)" << std::right << std::setw(12) << live << std::setw(12) << ""
+       << std::setw(14) << human_bytes(bytes) << std::endl;
+}
+
+std::string brief(size_t top) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    auto classes = registry();
+    std::sort(classes.begin(), classes.end(), [](const ClassStats* a, const ClassStats* b) { return a->live_bytes() > b->live_bytes(); });
+    int64_t live = 0, bytes = 0;
+    for (auto&& c : classes) live += c->live(), bytes += c->live_bytes();
+    std::stringstream ss;
+    ss << "live objects: " << live << " (" << human_bytes(bytes) << ")";
+    for (size_t i = 0; i < std::min(top, classes.size()); ++i) {
+        ss << (i == 0 ? ", " : "; ") << classes[i]->name() << " " << classes[i]->live() << " (" << human_bytes(classes[i]->live_bytes()) << ")";
+    }
+    return ss.str();
+}
+
+}  // namespace alloc_track
@@ -0,0 +1,168 @@
+#include "batch.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+#include "book.hpp"
+#include "common.hpp"
+#include "environment.hpp"
+#include "inference.hpp"
+#include "mapped_file.hpp"
+#include "parser.hpp"
+#include "script.hpp"
+
+std::vector<BatchJob> read_manifest(const std::string& fname) {
+    std::ifstream ifs(fname);
+    if (!ifs) throw FileError("read_manifest(): " + fname + ": file not found");
+    std::vector<BatchJob> jobs;
+    std::string line;
+    for (size_t lno = 1; std::getline(ifs, line); ++lno) {
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        std::vector<std::string> cols;
+        for (std::string col; ss >> col;) cols.push_back(col);
+        if (cols.empty()) continue;
+        if (cols.size() > 3) throw FileError(fname + ":" + std::to_string(lno) + ": expected \"SCRIPT [DEF_FILE [OUT_BOOK]]\"");
+        BatchJob job;
+        job.script = cols[0];
+        if (cols.size() > 1 && cols[1] != "-") job.def_file = cols[1];
+        if (cols.size() > 2) job.out_book = cols[2];
+        jobs.push_back(job);
+    }
+    return jobs;
+}
+
+size_t read_script_file(Book& book, const std::string& fname) {
+    std::ifstream ifs(fname, std::ios::binary);
+    if (!ifs) throw FileError(fname + ": file not found");
+    std::string head(std::strlen(SCRIPT_BINARY_MAGIC), '\0');
+    ifs.read(head.data(), head.size());
+    head.resize(ifs.gcount());
+    if (is_binary_script(head)) {
+        ifs.clear();
+        ifs.seekg(0);
+        ScriptBinaryReader reader(ifs, fname);
+        return book.read_script(reader);
+    }
+    ifs.close();
+    LineReader reader(fname);
+    return book.read_script(reader);
+}
+
+namespace {
+
+void verify_job(const BatchJob& job, const Environment* env, bool skip_check, BatchResult& result) {
+    Book book(skip_check);
+    if (env) book.set_def_env(*env);
+
+    read_script_file(book, job.script);
+    result.lines = book.size();
+
+    if (job.out_book.size() > 0) {
+        std::FILE* fp = std::fopen(job.out_book.c_str(), "wb");
+        if (!fp) throw FileError(job.out_book + ": could not open file");
+        BookWriter(fp, BookFormat::Conventional).finish(book);
+        std::fclose(fp);
+    }
+}
+
+}  // namespace
+
+std::vector<BatchResult> run_batch(const std::vector<BatchJob>& jobs, size_t threads, bool skip_check,
+                                   const std::function<void(size_t)>& on_done) {
+    std::vector<BatchResult> results(jobs.size());
+    bool shared = shared_conversions;
+    shared_conversions = true;
+
+    // Environment(fname) registers its source globally, so the def files are read here on one thread
+    std::map<std::string, std::unique_ptr<Environment>> envs;
+    std::map<std::string, std::string> env_errors;
+    for (auto&& job : jobs) {
+        if (job.def_file.empty() || envs.count(job.def_file) || env_errors.count(job.def_file)) continue;
+        std::stringstream ss;
+        try {
+            envs[job.def_file] = std::make_unique<Environment>(job.def_file);
+        } catch (FileError& e) {
+            e.puterror(ss);
+        } catch (BaseError& e) {
+            e.puterror(ss);
+        }
+        if (ss.str().size() > 0) env_errors[job.def_file] = ss.str();
+    }
+
+    std::atomic<size_t> next = 0;
+    std::mutex done_mtx;
+    auto worker = [&]() {
+        for (size_t i; (i = next.fetch_add(1)) < jobs.size();) {
+            const auto& job = jobs[i];
+            auto& result = results[i];
+            auto start = std::chrono::steady_clock::now();
+            std::stringstream ss;
+            if (env_errors.count(job.def_file)) {
+                ss << env_errors.at(job.def_file);
+            } else {
+                try {
+                    verify_job(job, job.def_file.empty() ? nullptr : envs.at(job.def_file).get(), skip_check, result);
+                    result.ok = true;
+                } catch (InferenceError& e) {
+                    e.puterror(ss);
+                } catch (FileError& e) {
+                    e.puterror(ss);
+                } catch (BaseError& e) {
+                    e.puterror(ss);
+                } catch (TypeError& e) {
+                    e.puterror(ss);
+                } catch (DeductionError& e) {
+                    e.puterror(ss);
+                } catch (std::exception& e) {
+                    // e.g. std::bad_alloc or std::out_of_range: this job fails, the others go on
+                    ss << BOLD(RED("error")) << ": " << e.what();
+                }
+            }
+            result.error = ss.str();
+            while (result.error.size() > 0 && result.error.back() == '\n') result.error.pop_back();
+            result.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (on_done) {
+                std::lock_guard<std::mutex> lock(done_mtx);
+                on_done(i);
+            }
+        }
+    };
+
+    threads = std::max<size_t>(1, std::min(threads, jobs.size()));
+    std::vector<std::thread> pool;
+    for (size_t t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto&& th : pool) th.join();
+    shared_conversions = shared;
+    return results;
+}
+
+bool print_batch(std::ostream& os, const std::vector<BatchJob>& jobs, const std::vector<BatchResult>& results, double wall_ms) {
+    size_t failed = 0, lines = 0;
+    double cpu_ms = 0;
+    os << std::fixed << std::setprecision(1);
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        const auto& res = results[i];
+        os << (res.ok ? BOLD(GREEN("OK  ")) : BOLD(RED("FAIL"))) << std::right << std::setw(12) << res.ms << " ms"
+           << std::setw(12) << res.lines << " lines  " << jobs[i].script << std::endl;
+        if (!res.ok) os << "      " << res.error << std::endl;
+        failed += !res.ok;
+        lines += res.lines;
+        cpu_ms += res.ms;
+    }
+    os << jobs.size() - failed << " / " << jobs.size() << " scripts verified (" << lines << " lines, "
+       << cpu_ms << " ms in jobs, " << wall_ms << " ms wall)." << std::endl;
+    return failed == 0;
+}
@@ -0,0 +1,494 @@
+// microbenchmarks of hot loops, old against new, and of the kernel operations (tracked with --json)
+// usage: bench.out SCRIPT_FILE [REPEAT] [DEF_FILE] [--json OUT_FILE]
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+#include "defbin.hpp"
+#include "environment.hpp"
+#include "inference.hpp"
+#include "parser.hpp"
+#include "scan.hpp"
+#include "script.hpp"
+#include "source_buffer.hpp"
+
+// every allocation of the process is counted, so that the kernel benchmarks can report allocations/op
+std::atomic<size_t> alloc_count{0};
+
+void* operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size > 0 ? size : 1)) return p;
+    throw std::bad_alloc();
+}
+// not inlined, or g++ takes the free() for a mismatch with the new-expressions it can see
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// returns the best wall time of repeat runs in milliseconds
+double measure(size_t repeat, const std::function<void()>& func) {
+    double best = -1;
+    for (size_t r = 0; r < repeat; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        if (best < 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+void report(const std::string& name, size_t items, double ms) {
+    std::cout << std::left << std::setw(32) << name
+              << std::right << std::setw(10) << std::fixed << std::setprecision(3) << ms << " ms"
+              << std::setw(14) << (size_t)(items / ms * 1000) << " lines/sec" << std::endl;
+}
+
+void bench_script_parser(const FileData& data, size_t repeat) {
+    size_t lines = 0;
+    while (lines < data.size() && data[lines] != "-1") ++lines;
+
+    size_t checksum = 0;
+    double ms = measure(repeat, [&]() {
+        ScriptRecord rec;
+        std::string errmsg;
+        for (size_t i = 0; i < lines; ++i) {
+            parse_script_line(data[i], i, rec, errmsg);
+            checksum += rec.refs().size();
+        }
+    });
+
+    std::cout << "[script parser] " << data.name() << ": " << lines << " lines, best of " << repeat << " runs" << std::endl;
+    report("parse_script_line", lines, ms);
+    std::cout << "(checksum " << checksum << ")" << std::endl;
+}
+
+// loading and tokenizing a definition file (the text of every token is asked for once, as the parser does)
+void bench_tokenizer(const std::string& fname, size_t repeat) {
+    size_t lines = 0, ntokens = 0;
+    {
+        SourceBuffer src(fname);
+        lines = src.lines();
+        ntokens = tokenize(src).size();
+    }
+
+    size_t checksum = 0;
+    double ms = measure(repeat, [&]() {
+        SourceBuffer src(fname);
+        auto tokens = tokenize(src);
+        for (auto&& t : tokens) checksum += t.view().size();
+    });
+
+    std::cout << "[tokenizer] " << fname << ": " << lines << " lines, " << ntokens << " tokens, best of " << repeat << " runs" << std::endl;
+    report("SourceBuffer + tokenize", lines, ms);
+    std::cout << "token size: " << sizeof(Token) << " bytes (checksum " << checksum << ")" << std::endl;
+}
+
+// parse_lambda() against the shift-reduce parser it replaced: whole definition files, and single exprs of growing length
+void bench_lambda_parser(const std::string& fname, size_t repeat) {
+    SourceBuffer src(fname);
+    auto tokens = tokenize(src);
+    auto env1 = parse_defs(tokens, parse_lambda_legacy);
+    auto env2 = parse_defs(tokens);
+    check_true_or_exit(env1.repr() == env2.repr(), "parsers disagree on " << fname, __FILE__, __LINE__, __func__);
+
+    size_t checksum = 0;
+    double legacy = measure(repeat, [&]() { checksum += parse_defs(tokens, parse_lambda_legacy).size(); });
+    double fast = measure(repeat, [&]() { checksum += parse_defs(tokens).size(); });
+    std::cout << "[lambda parser] " << fname << ": " << src.lines() << " lines, " << env2.size() << " definitions, best of " << repeat << " runs" << std::endl;
+    report("parse_defs (legacy)", src.lines(), legacy);
+    report("parse_defs", src.lines(), fast);
+    std::cout << "speedup: " << std::setprecision(2) << legacy / fast << "x (checksum " << checksum << ")" << std::endl;
+
+    // "%f x -> %f x -> ... -> %f x" in the new notation, and the same after an unclosed parenthesis,
+    // which parse_lambda() hands over to the legacy parser to report
+    const Environment env;
+    const std::vector<std::shared_ptr<Context>> flag_context;
+    for (size_t n : {250, 500, 1000, 2000}) {
+        std::string str = "%f x";
+        for (size_t i = 1; i < n; ++i) str += " -> %f x";
+        std::istringstream iss(str), broken_iss("(" + str);
+        SourceBuffer expr_src(iss, "[bench]"), broken_src(broken_iss, "[bench]");
+        auto expr_tokens = tokenize(expr_src), broken_tokens = tokenize(broken_src);
+        auto parse_with = [&](ParseLambdaFunc parse_expr) {
+            size_t idx = 0;
+            return parse_expr(expr_tokens, idx, expr_tokens.size(), true, flag_context, env)->term();
+        };
+        auto rejects = [&]() {
+            size_t idx = 0;
+            try {
+                parse_lambda(broken_tokens, idx, broken_tokens.size(), true, flag_context, env);
+            } catch (ParseError&) {
+                return true;
+            }
+            return false;
+        };
+        check_true_or_exit(rejects(), "an expr of " << n << " arrows after an unclosed parenthesis is accepted", __FILE__, __LINE__, __func__);
+        check_true_or_exit(
+            parse_with(parse_lambda_legacy)->repr() == parse_with(parse_lambda)->repr(),
+            "parsers disagree on an expr of " << n << " arrows", __FILE__, __LINE__, __func__);
+        double t1 = measure(repeat, [&]() { checksum += parse_with(parse_lambda_legacy) != nullptr; });
+        double t2 = measure(repeat, [&]() { checksum += parse_with(parse_lambda) != nullptr; });
+        double t3 = measure(repeat, [&]() { checksum += rejects(); });
+        std::cout << std::left << std::setw(16) << (std::to_string(expr_tokens.size()) + " tokens") << std::right << std::fixed << std::setprecision(3)
+                  << std::setw(10) << t1 << " ms (legacy)" << std::setw(10) << t2 << " ms"
+                  << "  speedup: " << std::setprecision(2) << t1 / t2 << "x"
+                  << std::setprecision(3) << ", malformed " << t3 << " ms" << std::endl;
+    }
+}
+
+// parse_defs() against parse_defs_parallel() on the contents of fname repeated 8 times
+// (with at least 4 threads, so that the hand-off is exercised even on a single core)
+void bench_parallel_defs(const std::string& fname, size_t repeat) {
+    size_t threads = std::max(4u, std::thread::hardware_concurrency());
+    std::string text;
+    {
+        std::ifstream ifs(fname, std::ios::binary);
+        if (!ifs) throw FileError("bench_parallel_defs(): " + fname + ": file not found");
+        std::string chunk(std::istreambuf_iterator<char>(ifs), {});
+        auto end_mark = chunk.rfind("\nEND");  // would stop reading at the first copy
+        if (end_mark != std::string::npos) chunk.resize(end_mark + 1);
+        for (int k = 0; k < 8; ++k) text += chunk;
+        text += "END\n";
+    }
+    std::istringstream iss(text);
+    SourceBuffer src(iss, fname + " x 8");
+    auto tokens = tokenize(src);
+    auto env1 = parse_defs(tokens);
+    auto env2 = parse_defs_parallel(tokens, threads);
+    check_true_or_exit(env1.repr() == env2.repr(), "parse_defs_parallel() disagrees on " << src.name(), __FILE__, __LINE__, __func__);
+
+    size_t checksum = 0;
+    double seq = measure(repeat, [&]() { checksum += parse_defs(tokens).size(); });
+    double par = measure(repeat, [&]() { checksum += parse_defs_parallel(tokens, threads).size(); });
+    std::cout << "[parallel parse_defs] " << src.name() << ": " << src.lines() << " lines, " << env2.size() << " definitions, "
+              << threads << " threads, best of " << repeat << " runs" << std::endl;
+    report("parse_defs", src.lines(), seq);
+    report("parse_defs_parallel", src.lines(), par);
+    std::cout << "speedup: " << std::setprecision(2) << seq / par << "x (checksum " << checksum << ")" << std::endl;
+}
+
+// loading fname as text (tokenize + parse_defs_parallel) against loading it compiled by def_conv -b
+void bench_defbin(const std::string& fname, size_t repeat) {
+    SourceBuffer src(fname);
+    auto env1 = parse_defs_parallel(tokenize(src));
+    std::ostringstream oss;
+    write_defbin(oss, env1);
+    const std::string bin = oss.str();
+    auto env2 = read_defbin(bin, "[bench]");
+    check_true_or_exit(env1.repr() == env2.repr(), "compiled environment differs from " << fname, __FILE__, __LINE__, __func__);
+
+    size_t checksum = 0;
+    double text = measure(repeat, [&]() { checksum += parse_defs_parallel(tokenize(src)).size(); });
+    double compiled = measure(repeat, [&]() { checksum += read_defbin(bin, "[bench]").size(); });
+    std::cout << "[compiled environment] " << fname << ": " << src.text().size() << " -> " << bin.size() << " bytes, best of " << repeat << " runs" << std::endl;
+    report("tokenize + parse_defs", src.lines(), text);
+    report("read_defbin", src.lines(), compiled);
+    std::cout << "speedup: " << std::setprecision(2) << text / compiled << "x (checksum " << checksum << ")" << std::endl;
+}
+
+// byte scanners of scan.hpp, scalar vs SIMD, on the contents of fname repeated up to about 32 MiB
+void bench_scanner(const std::string& fname, size_t repeat) {
+    std::string text;
+    {
+        std::ifstream ifs(fname, std::ios::binary);
+        if (!ifs) throw FileError("bench_scanner(): " + fname + ": file not found");
+        std::string chunk(std::istreambuf_iterator<char>(ifs), {});
+        if (chunk.empty()) return;
+        while (text.size() < (32u << 20)) text += chunk;
+    }
+    const char* begin = text.data();
+    const char* end = begin + text.size();
+
+    // the kernels of the tokenizer and the line readers: newlines, comment starts and blank runs
+    auto lines = [](auto find) {
+        return [=](const char* p, const char* end) {
+            size_t n = 0;
+            for (; p < end; ++p, ++n) p = find(p, end, '\n');
+            return n;
+        };
+    };
+    auto comments = [](auto find_either) {
+        return [=](const char* p, const char* end) {
+            size_t n = 0;
+            for (; p < end; ++p) {
+                p = find_either(p, end, '/', '\n');
+                n += p + 1 < end && *p == '/' && (p[1] == '/' || p[1] == '*');
+            }
+            return n;
+        };
+    };
+    auto blanks = [](auto find_either, auto skip_blanks) {
+        return [=](const char* p, const char* end) {
+            size_t n = 0;
+            while ((p = find_either(p, end, ' ', '\t')) < end) {
+                p = skip_blanks(p, end);
+                ++n;
+            }
+            return n;
+        };
+    };
+    struct Kernel {
+        std::string name;
+        std::function<size_t(const char*, const char*)> scalar, simd;
+    };
+    std::vector<Kernel> kernels = {
+        {"lines", lines(scan::scalar::find), lines(scan::find)},
+        {"comment starts", comments(scan::scalar::find_either), comments(scan::find_either)},
+        {"blank runs", blanks(scan::scalar::find_either, scan::scalar::skip_blanks), blanks(scan::find_either, scan::skip_blanks)},
+    };
+
+    std::cout << "[scanner] " << fname << ": " << text.size() << " bytes, best of " << repeat << " runs, isa " << scan::Isa << std::endl;
+    for (auto&& k : kernels) {
+        size_t n1 = k.scalar(begin, end), n2 = k.simd(begin, end);
+        check_true_or_exit(n1 == n2, "scanners disagree on " << k.name << ": " << n1 << " vs " << n2, __FILE__, __LINE__, __func__);
+        size_t checksum = 0;
+        double slow = measure(repeat, [&]() { checksum += k.scalar(begin, end); });
+        double fast = measure(repeat, [&]() { checksum += k.simd(begin, end); });
+        std::cout << std::left << std::setw(16) << k.name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << text.size() / slow / 1000 << " MB/s (scalar)"
+                  << std::setw(10) << text.size() / fast / 1000 << " MB/s (" << scan::Isa << ")"
+                  << "  speedup: " << slow / fast << "x (" << n1 << " found, checksum " << checksum << ")" << std::endl;
+    }
+}
+
+// one kernel operation on one input: best time of repeat runs of ops calls each, and the allocations of that run
+struct KernelResult {
+    std::string name, input;
+    size_t ops;
+    double ns_per_op, allocs_per_op;
+};
+
+std::vector<KernelResult> kernel_results;
+
+// reset (if any) runs before each run, outside of the measurement
+void bench_kernel(const std::string& name, const std::string& input, size_t ops, size_t repeat,
+                  const std::function<void()>& func, const std::function<void()>& reset = nullptr) {
+    double best = -1;
+    size_t allocs = 0;
+    for (size_t r = 0; r < repeat; ++r) {
+        if (reset) reset();
+        size_t allocs0 = alloc_count.load(std::memory_order_relaxed);
+        auto start = std::chrono::steady_clock::now();
+        func();
+        auto end = std::chrono::steady_clock::now();
+        size_t n = alloc_count.load(std::memory_order_relaxed) - allocs0;
+        double ns = std::chrono::duration<double, std::nano>(end - start).count();
+        if (best < 0 || ns < best) best = ns, allocs = n;
+    }
+    KernelResult res{name, input, ops, best / ops, (double)allocs / ops};
+    std::cout << std::left << std::setw(16) << name << std::setw(20) << input << std::right
+              << std::setw(8) << ops << " ops" << std::fixed << std::setprecision(1)
+              << std::setw(14) << res.ns_per_op << " ns/op" << std::setw(12) << res.allocs_per_op << " allocs/op" << std::endl;
+    kernel_results.push_back(res);
+}
+
+// d0[x:*] := x : * and d{i}[x:*] := d{i-1}[x] : *, so that d{n-1}[y] takes n delta steps to normalize
+std::string chain_def_file(size_t n) {
+    std::string text;
+    for (size_t i = 0; i < n; ++i) {
+        text += "def2\n1\nx\n*\nd" + std::to_string(i) + "\n";
+        text += i == 0 ? "x\n" : "d" + std::to_string(i - 1) + "[x]\n";
+        text += "*\nedef2\n";
+    }
+    return text + "END\n";
+}
+
+// ?y0:x.?y1:x. ... x (n binders, bound variables named by prefix)
+std::shared_ptr<Term> pi_chain(size_t n, const std::string& prefix) {
+    std::shared_ptr<Term> term = std::make_shared<Variable>("x");
+    for (size_t i = n; i-- > 0;) {
+        term = std::make_shared<AbstPi>(Typed<Variable>(std::make_shared<Variable>(prefix + std::to_string(i)), std::make_shared<Variable>("x")), term);
+    }
+    return term;
+}
+
+// ($f:A.$x:B.%f %f ... %f x) g z, whose beta normal form applies g to z n times
+std::shared_ptr<Term> church_redex(size_t n) {
+    auto f = std::make_shared<Variable>("f"), x = std::make_shared<Variable>("x");
+    std::shared_ptr<Term> body = x;
+    for (size_t i = 0; i < n; ++i) body = std::make_shared<Application>(f, body);
+    std::shared_ptr<Term> numeral = std::make_shared<AbstLambda>(
+        Typed<Variable>(f, std::make_shared<Variable>("A")),
+        std::make_shared<AbstLambda>(Typed<Variable>(x, std::make_shared<Variable>("B")), body));
+    return std::make_shared<Application>(std::make_shared<Application>(numeral, std::make_shared<Variable>("g")), std::make_shared<Variable>("z"));
+}
+
+// the kernel operations on fname and on synthetic inputs of growing size
+void bench_kernels(const std::string& fname, size_t repeat) {
+    std::cout << "[kernel] best of " << repeat << " runs" << std::endl;
+    size_t checksum = 0;
+    auto check = [](bool ok, const std::string& what) {
+        check_true_or_exit(ok, "bench_kernels(): " << what, __FILE__, __LINE__, __func__);
+    };
+    const std::string input = fname.substr(fname.rfind('/') + 1);
+
+    {
+        SourceBuffer src(fname);
+        auto tokens = tokenize(src);
+        auto env = std::make_shared<Environment>(parse_defs(tokens));
+        bench_kernel("tokenize", input, 1, repeat, [&]() { checksum += tokenize(src).size(); });
+        bench_kernel("parse_defs", input, 1, repeat, [&]() { checksum += parse_defs(tokens).size(); });
+
+        std::vector<std::shared_ptr<Definition>> defs;  // those with a definiens, for get_type()
+        for (auto&& def : *env) {
+            if (!def->is_prim()) defs.push_back(def);
+        }
+        std::vector<std::shared_ptr<Term>> copies, nfs, deltas;
+        for (auto&& def : *env) {
+            copies.push_back(copy(def->type()));
+            nfs.push_back(NF(def->type(), *env));
+            deltas.push_back(delta_nf(def->type(), *env));
+        }
+        const size_t n = env->size();
+
+        bench_kernel("substitute", input, n, repeat, [&]() {
+            for (auto&& def : *env) {
+                // instantiates the parameters with their types
+                std::vector<std::shared_ptr<Variable>> vars;
+                std::vector<std::shared_ptr<Term>> exprs;
+                for (auto&& tv : *def->context()) vars.push_back(tv.value()), exprs.push_back(tv.type());
+                checksum += substitute(def->type(), vars, exprs) != nullptr;
+            }
+        });
+        for (size_t i = 0; i < n; ++i) check(alpha_comp((*env)[i]->type(), copies[i]), "alpha_comp() failed on a copy");
+        bench_kernel("alpha_comp", input, n, repeat, [&]() {
+            for (size_t i = 0; i < n; ++i) checksum += alpha_comp((*env)[i]->type(), copies[i]);
+        });
+        bench_kernel("delta_nf", input, n, repeat, [&]() {
+            for (auto&& def : *env) checksum += delta_nf(def->type(), *env) != nullptr;
+        });
+        bench_kernel("beta_nf", input, n, repeat, [&]() {
+            for (auto&& term : deltas) checksum += beta_nf(term) != nullptr;
+        });
+        bench_kernel("NF", input, n, repeat, [&]() {
+            for (auto&& def : *env) checksum += NF(def->type(), *env) != nullptr;
+        });
+        for (size_t i = 0; i < n; ++i) check(is_convertible((*env)[i]->type(), nfs[i], *env), "a type is not convertible to its normal form");
+        bench_kernel("is_convertible", input, n, repeat, [&]() {
+            for (size_t i = 0; i < n; ++i) checksum += is_convertible((*env)[i]->type(), nfs[i], *env);
+        });
+        bench_kernel("get_type", input, defs.size(), repeat, [&]() {
+            for (auto&& def : defs) checksum += get_type(def->definiens(), env, def->context()) != nullptr;
+        });
+        bench_kernel("get_script", input, n, repeat, [&]() {
+            auto delta = std::make_shared<Environment>();
+            for (auto&& def : *env) {
+                delta->push_back(def);
+                checksum += get_script(star, delta, std::make_shared<Context>()) != nullptr;
+            }
+        }, clear_scripts);
+    }
+
+    for (size_t n : {32, 128, 512}) {
+        const std::string input = "chain(" + std::to_string(n) + ")";
+        std::istringstream iss(chain_def_file(n));
+        SourceBuffer src(iss, input);
+        auto tokens = tokenize(src);
+        auto env = std::make_shared<Environment>(parse_defs(tokens));
+        check(env->size() == n, "wrong number of definitions in " + input);
+        auto y = std::make_shared<Variable>("y");
+        auto gamma = std::make_shared<Context>();
+        gamma->emplace_back(y, star);
+        auto last = std::make_shared<Constant>("d" + std::to_string(n - 1), std::vector<std::shared_ptr<Term>>{y});
+        auto mid = std::make_shared<Constant>("d" + std::to_string(n / 2), std::vector<std::shared_ptr<Term>>{y});
+        check(alpha_comp(NF(last, *env), y), "NF() of " + input + " is not y");
+        check(is_convertible(last, mid, *env), "definitions of " + input + " are not convertible");
+
+        bench_kernel("tokenize", input, 1, repeat, [&]() { checksum += tokenize(src).size(); });
+        bench_kernel("parse_defs", input, 1, repeat, [&]() { checksum += parse_defs(tokens).size(); });
+        bench_kernel("delta_nf", input, 1, repeat, [&]() { checksum += delta_nf(last, *env) != nullptr; });
+        bench_kernel("NF", input, 1, repeat, [&]() { checksum += NF(last, *env) != nullptr; });
+        bench_kernel("is_convertible", input, 1, repeat, [&]() { checksum += is_convertible(last, mid, *env); });
+        bench_kernel("get_type", input, 1, repeat, [&]() { checksum += get_type(last, env, gamma) != nullptr; });
+        bench_kernel("get_script", input, 1, repeat, [&]() {
+            checksum += get_script(star, env, std::make_shared<Context>()) != nullptr;
+        }, clear_scripts);
+
+        auto chain = pi_chain(n, "y"), renamed = pi_chain(n, "w");
+        auto z = std::make_shared<Variable>("z");
+        check(alpha_comp(chain, renamed), "binder chains of " + input + " are not alpha-equivalent");
+        bench_kernel("substitute", "pi" + input.substr(5), 1, repeat, [&]() { checksum += substitute(chain, std::make_shared<Variable>("x"), z) != nullptr; });
+        bench_kernel("alpha_comp", "pi" + input.substr(5), 1, repeat, [&]() { checksum += alpha_comp(chain, renamed); });
+
+        auto redex = church_redex(n);
+        bench_kernel("beta_nf", "church" + input.substr(5), 1, repeat, [&]() { checksum += beta_nf(redex) != nullptr; });
+    }
+    clear_scripts();
+    std::cout << "(checksum " << checksum << ")" << std::endl;
+}
+
+std::string json_escape(const std::string& str) {
+    std::string res;
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') res += '\\';
+        res += ch;
+    }
+    return res;
+}
+
+void write_kernel_results(const std::string& fname, size_t repeat) {
+    std::ofstream ofs(fname);
+    if (!ofs) throw FileError("write_kernel_results(): " + fname + ": could not open file");
+    ofs << "{\n  \"repeat\": " << repeat << ",\n  \"results\": [";
+    for (size_t i = 0; i < kernel_results.size(); ++i) {
+        const auto& res = kernel_results[i];
+        ofs << (i > 0 ? ",\n" : "\n") << std::fixed << std::setprecision(1)
+            << "    {\"name\": \"" << json_escape(res.name) << "\", \"input\": \"" << json_escape(res.input) << "\", \"ops\": " << res.ops
+            << ", \"ns_per_op\": " << res.ns_per_op << ", \"allocs_per_op\": " << res.allocs_per_op << "}";
+    }
+    ofs << "\n  ]\n}" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> args;
+    std::string json_name("");
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--json" && i + 1 < argc) json_name = argv[++i];
+        else args.emplace_back(argv[i]);
+    }
+    if (args.size() < 1) {
+        std::cerr << "usage: " << argv[0] << " SCRIPT_FILE [REPEAT] [DEF_FILE] [--json OUT_FILE]" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    size_t repeat = args.size() >= 2 ? std::stoul(args[1]) : 10;
+
+    FileData data;
+    try {
+        data = FileData(args[0]);
+    } catch (FileError& e) {
+        e.puterror();
+        exit(EXIT_FAILURE);
+    }
+
+    bench_script_parser(data, repeat);
+    if (args.size() >= 3) {
+        try {
+            bench_tokenizer(args[2], repeat);
+            bench_lambda_parser(args[2], repeat);
+            bench_parallel_defs(args[2], repeat);
+            bench_defbin(args[2], repeat);
+            bench_scanner(args[2], repeat);
+            bench_kernels(args[2], repeat);
+            if (json_name.size() > 0) write_kernel_results(json_name, repeat);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        } catch (BaseError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "binary.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+
+#include "common.hpp"
+
+void ByteWriter::put_varint(uint64_t x) {
+    while (x >= 0x80) {
+        put((uint8_t)(x | 0x80));
+        x >>= 7;
+    }
+    put((uint8_t)x);
+}
+
+void ByteWriter::put_svarint(int64_t x) {
+    put_varint(((uint64_t)x << 1) ^ (uint64_t)(x >> 63));
+}
+
+void ByteWriter::put_string(const std::string& str) {
+    put_varint(str.size());
+    _buf += str;
+}
+
+void ByteWriter::put_bytes(const void* data, size_t len) {
+    _buf.append((const char*)data, len);
+}
+
+ByteReader::ByteReader(std::istream& is, const std::string& srcname) : _sb(is.rdbuf()), _srcname(srcname) {}
+
+namespace {
+
+// get area over bytes owned by someone else
+class ViewBuf : public std::streambuf {
+  public:
+    ViewBuf(std::string_view data) {
+        char* p = const_cast<char*>(data.data());
+        setg(p, p, p + data.size());
+    }
+};
+
+}  // namespace
+
+ByteReader::ByteReader(std::string_view data, const std::string& srcname)
+    : _view(std::make_unique<ViewBuf>(data)), _sb(_view.get()), _srcname(srcname) {}
+
+uint8_t ByteReader::get() {
+    auto ch = _sb->sbumpc();
+    if (ch == std::char_traits<char>::eof()) throw FileError(_srcname + ": unexpected end of binary data");
+    return (uint8_t)ch;
+}
+
+uint64_t ByteReader::get_varint() {
+    uint64_t x = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = get();
+        x |= (uint64_t)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return x;
+    }
+    throw FileError(_srcname + ": malformed varint in binary data");
+}
+
+int64_t ByteReader::get_svarint() {
+    uint64_t x = get_varint();
+    return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+}
+
+std::string ByteReader::get_string() {
+    uint64_t len = get_varint();
+    std::streamsize avail = _sb->in_avail();
+    if (avail >= 0 && len <= (uint64_t)avail) {
+        std::string str(len, '\0');
+        get_bytes(str.data(), len);
+        return str;
+    }
+    if (len > remaining()) throw FileError(_srcname + ": string of " + std::to_string(len) + " bytes exceeds the rest of binary data");
+    // the length of an unseekable stream is unknown, so the string grows only as far as the data goes
+    std::string str;
+    while (str.size() < len) {
+        size_t n = std::min<uint64_t>(len - str.size(), 1 << 16), old = str.size();
+        str.resize(old + n);
+        get_bytes(str.data() + old, n);
+    }
+    return str;
+}
+
+void ByteReader::get_bytes(void* data, size_t len) {
+    if ((size_t)_sb->sgetn((char*)data, len) != len) throw FileError(_srcname + ": unexpected end of binary data");
+}
+
+bool ByteReader::eof() {
+    return _sb->sgetc() == std::char_traits<char>::eof();
+}
+
+size_t ByteReader::remaining() {
+    if (_view) return _sb->in_avail();
+    auto cur = _sb->pubseekoff(0, std::ios::cur, std::ios::in);
+    if (cur == std::streampos(-1)) return SIZE_MAX;
+    auto end = _sb->pubseekoff(0, std::ios::end, std::ios::in);
+    _sb->pubseekpos(cur, std::ios::in);
+    if (end == std::streampos(-1) || end < cur) return SIZE_MAX;
+    return end - cur;
+}
@@ -1,12 +1,22 @@
 #include "book.hpp"
 
+#include <atomic>
+#include <chrono>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#include "inference.hpp"
 #include "judgement.hpp"
+#include "mapped_file.hpp"
+#include "profile.hpp"
+#include "script.hpp"
+#include "spsc_queue.hpp"
 
-Book::Book(bool skip_check) : std::vector<Judgement>{}, _skip_check{skip_check} {}
+Book::Book(bool skip_check) : std::vector<Judgement>{}, _skip_check{skip_check}, _checked{!skip_check} {}
 Book::Book(const std::vector<Judgement>& list) : std::vector<Judgement>(list) {}
 Book::Book(const std::string& scriptname, size_t limit) : Book(false) {
     read_script(scriptname, limit);
@@ -15,162 +25,262 @@ Book::Book(const FileData& fdata, size_t limit) : Book(false) {
     read_script(fdata, limit);
 }
 
-TextData Book::read_script(const FileData& fdata, size_t limit){
-    std::stringstream ss;
-    auto errmsg = [](const std::string& op, size_t lno) {
-        return op + ": wrong format (line " + std::to_string(lno + 1) + ")";
-    };
+TextData Book::read_script(const FileData& fdata, size_t limit) {
+    ScriptRecord rec;
+    std::string errmsg;
     size_t i;
     bool is_eof = false;
-    for (i = 0; i < limit; ++i) {
-        ss << fdata[i];
-        int lno;
-        std::string op;
-        ss >> lno;
-        if (lno == -1) {
+    for (i = 0; i < limit && i < fdata.size(); ++i) {
+        auto status = parse_script_line(fdata[i], i, rec, errmsg);
+        if (status == ScriptLineStatus::End) {
             is_eof = true;
             break;
         }
-        ss >> op;
-        if (op == "sort") {
-            sort();
-        } else if (op == "var") {
-            size_t idx;
-            std::string x;
-            check_true_or_exit(
-                ss >> idx >> x,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            var(idx, x);
-        } else if (op == "weak") {
-            size_t idx1, idx2;
-            std::string x;
-            check_true_or_exit(
-                ss >> idx1 >> idx2 >> x,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            weak(idx1, idx2, x);
-        } else if (op == "form") {
-            size_t idx1, idx2;
-            check_true_or_exit(
-                ss >> idx1 >> idx2,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            form(idx1, idx2);
-        } else if (op == "appl") {
-            size_t idx1, idx2;
-            check_true_or_exit(
-                ss >> idx1 >> idx2,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            appl(idx1, idx2);
-        } else if (op == "abst") {
-            size_t idx1, idx2;
-            check_true_or_exit(
-                ss >> idx1 >> idx2,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            abst(idx1, idx2);
-        } else if (op == "conv") {
-            size_t idx1, idx2;
-            check_true_or_exit(
-                ss >> idx1 >> idx2,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            conv(idx1, idx2);
-        } else if (op == "def") {
-            size_t idx1, idx2;
-            std::string a;
-            check_true_or_exit(
-                ss >> idx1 >> idx2 >> a,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            def(idx1, idx2, a);
-        } else if (op == "defpr") {
-            size_t idx1, idx2;
-            std::string a;
-            check_true_or_exit(
-                ss >> idx1 >> idx2 >> a,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            defpr(idx1, idx2, a);
-        } else if (op == "inst") {
-            size_t idx0, n, p;
-            check_true_or_exit(
-                ss >> idx0 >> n,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            std::vector<size_t> idxs(n);
-            for (auto&& ki : idxs) {
-                check_true_or_exit(
-                    ss >> ki,
-                    errmsg(op, i),
-                    __FILE__, __LINE__, __func__);
-            }
-            check_true_or_exit(
-                ss >> p,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-            inst(idx0, n, idxs, p);
-        } else if (op == "cp") {
-            size_t idx;
-            check_true_or_exit(
-                ss >> idx,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            cp(idx);
-        } else if (op == "sp") {
-            size_t idx, n;
-            check_true_or_exit(
-                ss >> idx >> n,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            sp(idx, n);
-        } else if (op == "tp") {
-            size_t idx;
-            check_true_or_exit(
-                ss >> idx,
-                errmsg(op, i),
-                __FILE__, __LINE__, __func__);
-
-            tp(idx);
-        } else {
-            check_true_or_exit(
-                false,
-                "not implemented (token: " << op << ")",
-                __FILE__, __LINE__, __func__);
-        }
-        ss.clear();
-        ss.str("");
+        // thrown rather than exiting, so that verifier --batch goes on with the other scripts
+        if (status != ScriptLineStatus::Rule) throw InferenceError(errmsg);
+        apply(rec);
     }
     if (limit == 0) return TextData();
     if (i == 0 && is_eof) return TextData();
-    if (!is_eof) ++i;
+    if (!is_eof && i < fdata.size()) ++i;
     return TextData(fdata.begin(), fdata.begin() + i);
 }
 
+size_t Book::read_script(ScriptBinaryReader& reader, size_t limit) {
+    ScriptRecord rec;
+    size_t i;
+    for (i = 0; i < limit && reader.next(rec); ++i) apply(rec);
+    return i;
+}
+
+size_t Book::read_script(LineReader& reader, size_t limit) {
+    ScriptRecord rec;
+    std::string errmsg;
+    std::string_view line;
+    size_t base = this->size();  // nonzero when resuming from a checkpoint
+    size_t i;
+    for (i = 0; i < limit && reader.next(line); ++i) {
+        auto status = parse_script_line(line, base + i, rec, errmsg);
+        if (status == ScriptLineStatus::End) break;
+        if (status != ScriptLineStatus::Rule) throw InferenceError(errmsg);
+        apply(rec);
+    }
+    return i;
+}
+
+size_t Book::read_script_pipelined(LineReader& reader, size_t limit) {
+    std::string_view line;
+    size_t lno = this->size();
+    return read_script_pipelined(
+        [&](ScriptItem& item) {
+            if (!reader.next(line)) return false;
+            item.status = parse_script_line(line, lno++, item.rec, item.errmsg);
+            return true;
+        },
+        limit);
+}
+
+size_t Book::read_script_pipelined(ScriptBinaryReader& reader, size_t limit) {
+    return read_script_pipelined(
+        [&](ScriptItem& item) {
+            if (!reader.next(item.rec)) return false;
+            item.status = ScriptLineStatus::Rule;
+            return true;
+        },
+        limit);
+}
+
+// decode fills the next item and returns false at the end of input; it runs on its own thread.
+// decoding errors are delivered in order, i.e. after every preceding rule has been applied.
+size_t Book::read_script_pipelined(const std::function<bool(ScriptItem&)>& decode, size_t limit) {
+    SpscQueue<ScriptItem> queue;
+    std::atomic_bool cancelled(false);
+
+    std::thread producer([&]() {
+        ScriptItem item;
+        for (size_t i = 0; i < limit; ++i) {
+            try {
+                if (!decode(item)) item.status = ScriptLineStatus::End;
+            } catch (...) {
+                item.status = ScriptLineStatus::Error;
+                item.error = std::current_exception();
+            }
+            bool is_last = item.status != ScriptLineStatus::Rule;
+            if (!queue.push(item, cancelled) || is_last) return;
+        }
+        item.status = ScriptLineStatus::End;
+        queue.push(item, cancelled);
+    });
+    auto stop_producer = [&]() {
+        cancelled.store(true);
+        producer.join();
+    };
+
+    // the producer always ends with End or Error, so pop() never waits forever
+    ScriptItem item;
+    size_t i = 0;
+    try {
+        while (queue.pop(item, cancelled) && item.status == ScriptLineStatus::Rule) {
+            apply(item.rec);
+            ++i;
+        }
+    } catch (...) {
+        stop_producer();
+        throw;
+    }
+    stop_producer();
+
+    if (item.status == ScriptLineStatus::Error) {
+        if (item.error) std::rethrow_exception(item.error);
+        throw InferenceError(item.errmsg);
+    }
+    return i;
+}
+
+void Book::apply(const ScriptRecord& rec) {
+    const auto& refs = rec.refs();
+    for (auto&& ref : refs) {
+        if (ref >= this->size() || is_forgotten(ref)) {
+            throw InferenceError()
+                << to_string(rec.rtype()) << " at line "
+                << this->size() << " refers to "
+                << (ref >= this->size() ? "a judgement not derived yet" : "a forgotten judgement")
+                << " (idx = " << ref << ")";
+        }
+    }
+    // the indices into a context or an environment are checked even with skip_check, since sp and inst read them unchecked
+    if (rec.rtype() == RuleType::Sp) {
+        const auto& gamma = *(*this)[refs[0]].context();
+        if (rec.arg() >= gamma.size()) {
+            throw InferenceError()
+                << "sp at line " << this->size() << " refers to variable " << rec.arg()
+                << " of a context of length " << gamma.size() << " (idx = " << refs[0] << ")";
+        }
+    } else if (rec.rtype() == RuleType::Inst) {
+        const auto& delta = *(*this)[refs[0]].env();
+        if (rec.arg() >= delta.size()) {
+            throw InferenceError()
+                << "inst at line " << this->size() << " refers to definition " << rec.arg()
+                << " of an environment of length " << delta.size() << " (idx = " << refs[0] << ")";
+        }
+        if (delta[rec.arg()]->context()->size() != refs.size() - 1) {
+            throw InferenceError()
+                << "inst at line " << this->size() << " gives " << refs.size() - 1 << " arguments to "
+                << delta[rec.arg()]->definiendum() << " taking " << delta[rec.arg()]->context()->size();
+        }
+    }
+    uint64_t hash = rec.hash();
+    if (_cached && reuse(rec, hash)) {
+        ++_reused_count;
+    } else {
+        std::chrono::steady_clock::time_point start;
+        if (_profile) start = std::chrono::steady_clock::now();
+        switch (rec.rtype()) {
+            case RuleType::Sort: sort(); break;
+            case RuleType::Var: var(refs[0], rec.name()); break;
+            case RuleType::Weak: weak(refs[0], refs[1], rec.name()); break;
+            case RuleType::Form: form(refs[0], refs[1]); break;
+            case RuleType::Appl: appl(refs[0], refs[1]); break;
+            case RuleType::Abst: abst(refs[0], refs[1]); break;
+            case RuleType::Conv: conv(refs[0], refs[1]); break;
+            case RuleType::Def: def(refs[0], refs[1], rec.name()); break;
+            case RuleType::Defpr: defpr(refs[0], refs[1], rec.name()); break;
+            case RuleType::Inst: inst(refs[0], refs.size() - 1, std::vector<size_t>(refs.begin() + 1, refs.end()), rec.arg()); break;
+            case RuleType::Cp: cp(refs[0]); break;
+            case RuleType::Sp: sp(refs[0], rec.arg()); break;
+            case RuleType::Tp: tp(refs[0]); break;
+        }
+        if (_profile) {
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            _profile->record(rec.rtype(), this->size() - 1, ns);
+        }
+    }
+    size_t lno = this->size() - 1;
+    // lines may have been undone (interactive mode) since the last one applied
+    _hashes.resize(lno);
+    _hashes.push_back(hash);
+    if (!_last_use.empty()) {
+        for (auto&& ref : refs) {
+            if (ref < _last_use.size() && _last_use[ref] == lno) forget(ref);
+        }
+        // an unreferenced line is kept until the next one, so that back() is always available
+        if (lno > 0 && lno - 1 < _last_use.size() && _last_use[lno - 1] == lno - 1) forget(lno - 1);
+    }
+    // forgotten lines were all passed to the listener before, and the listener sees the book
+    // exactly as a checkpoint taken at this point would restore it
+    if (_listener) _listener(lno);
+    if (_progress) _progress->store(lno + 1, std::memory_order_relaxed);
+}
+
+void Book::swap(Book& other) {
+    std::vector<Judgement>::swap(other);
+    std::swap(_env, other._env);
+    std::swap(_def_dict, other._def_dict);
+    std::swap(_skip_check, other._skip_check);
+    std::swap(_checked, other._checked);
+    std::swap(_listener, other._listener);
+    std::swap(_profile, other._profile);
+    std::swap(_progress, other._progress);
+    std::swap(_last_use, other._last_use);
+    std::swap(_cached, other._cached);
+    std::swap(_cached_hashes, other._cached_hashes);
+    std::swap(_hashes, other._hashes);
+    std::swap(_reused, other._reused);
+    std::swap(_reused_count, other._reused_count);
+}
+
+void Book::clear() {
+    std::vector<Judgement>::clear();
+    _checked = !_skip_check;
+    _hashes.clear();
+    _reused.clear();
+    _reused_count = 0;
+}
+
+void Book::reuse_from(const std::shared_ptr<const Book>& cached, const std::vector<uint64_t>& hashes) {
+    bool is_usable = cached && (_skip_check || cached->is_checked());
+    _cached = is_usable ? cached : nullptr;
+    _cached_hashes = is_usable ? hashes : std::vector<uint64_t>();
+    _hashes.clear();
+    _reused.clear();
+    _reused_count = 0;
+}
+
+bool Book::reuse(const ScriptRecord& rec, uint64_t hash) {
+    size_t lno = this->size();
+    bool is_reused = lno < _cached_hashes.size() && lno < _cached->size() && _cached_hashes[lno] == hash && !_cached->is_forgotten(lno);
+    for (auto&& ref : rec.refs()) is_reused = is_reused && ref < _reused.size() && _reused[ref];
+    _reused.push_back(is_reused);
+    if (is_reused) this->push_back((*_cached)[lno]);
+    return is_reused;
+}
+
+void Book::forget(size_t lno) {
+    (*this)[lno] = Judgement(nullptr, nullptr, nullptr, nullptr);
+}
+
 TextData Book::read_script(const std::string& scriptname, size_t limit) {
     return read_script(FileData(scriptname), limit);
 }
 
+// handles of the sorts shared by all judgements mentioning them (one per thread, as the pools are)
+static const PoolHandle<Term>& star_handle() {
+    static thread_local const PoolHandle<Term> handle(star);
+    return handle;
+}
+static const PoolHandle<Term>& sq_handle() {
+    static thread_local const PoolHandle<Term> handle(sq);
+    return handle;
+}
+
 // inference rules
+// components carried over from premises are passed as handles so that the new judgement shares their slots
 void Book::sort() {
     this->emplace_back(
         std::make_shared<Environment>(),
         std::make_shared<Context>(),
-        star,
-        sq);
+        star_handle(),
+        sq_handle());
 }
 void Book::var(size_t m, const std::string& x) {
     if (!_skip_check && !is_var_applicable(*this, m, x)) {
@@ -184,9 +294,9 @@ void Book::var(size_t m, const std::string& x) {
     auto vx = variable(x);
     auto A = judge.term();
     this->emplace_back(
-        judge.env(),
+        judge.env_handle(),
         std::make_shared<Context>(*judge.context() + Typed<Variable>(vx, A)),
-        vx, A);
+        vx, judge.term_handle());
 }
 void Book::weak(size_t m, size_t n, const std::string& x) {
     if (!_skip_check && !is_weak_applicable(*this, m, n, x)) {
@@ -198,13 +308,11 @@ void Book::weak(size_t m, size_t n, const std::string& x) {
     const auto& judge1 = (*this)[m];
     const auto& judge2 = (*this)[n];
     auto vx = variable(x);
-    auto A = judge1.term();
-    auto B = judge1.type();
     auto C = judge2.term();
     this->emplace_back(
-        judge1.env(),
+        judge1.env_handle(),
         std::make_shared<Context>(*judge1.context() + Typed<Variable>(vx, C)),
-        A, B);
+        judge1.term_handle(), judge1.type_handle());
 }
 void Book::form(size_t m, size_t n) {
     if (!_skip_check && !is_form_applicable(*this, m, n)) {
@@ -218,11 +326,10 @@ void Book::form(size_t m, size_t n) {
     auto x = judge2.context()->back().value();
     auto A = judge1.term();
     auto B = judge2.term();
-    auto s2 = judge2.type();
     this->emplace_back(
-        judge1.env(),
-        judge1.context(),
-        pi(x, A, B), s2);
+        judge1.env_handle(),
+        judge1.context_handle(),
+        pi(x, A, B), judge2.type_handle());
 }
 
 void Book::appl(size_t m, size_t n) {
@@ -239,8 +346,8 @@ void Book::appl(size_t m, size_t n) {
     auto B = pi(judge1.type())->expr();
     auto x = pi(judge1.type())->var().value();
     this->emplace_back(
-        judge1.env(),
-        judge1.context(),
+        judge1.env_handle(),
+        judge1.context_handle(),
         ::appl(M, N),
         substitute(B, x, N));
 }
@@ -259,8 +366,8 @@ void Book::abst(size_t m, size_t n) {
     auto A = judge1.context()->back().type();
     auto B = judge1.type();
     this->emplace_back(
-        judge2.env(),
-        judge2.context(),
+        judge2.env_handle(),
+        judge2.context_handle(),
         lambda(x, A, M),
         pi(x, A, B));
 }
@@ -274,12 +381,10 @@ void Book::conv(size_t m, size_t n) {
     }
     const auto& judge1 = (*this)[m];
     const auto& judge2 = (*this)[n];
-    auto A = judge1.term();
-    auto B2 = judge2.term();
     this->emplace_back(
-        judge1.env(),
-        judge1.context(),
-        A, B2);
+        judge1.env_handle(),
+        judge1.context_handle(),
+        judge1.term_handle(), judge2.term_handle());
 }
 
 void Book::def(size_t m, size_t n, const std::string& a) {
@@ -291,8 +396,6 @@ void Book::def(size_t m, size_t n, const std::string& a) {
     }
     const auto& judge1 = (*this)[m];
     const auto& judge2 = (*this)[n];
-    auto K = judge1.term();
-    auto L = judge1.type();
     auto M = judge2.term();
     auto N = judge2.type();
     const auto& xAs = judge2.context();
@@ -303,8 +406,8 @@ void Book::def(size_t m, size_t n, const std::string& a) {
             *judge1.env() +
             std::make_shared<Definition>(
                 xAs, constant(a, xs), M, N)),
-        judge1.context(),
-        K, L);
+        judge1.context_handle(),
+        judge1.term_handle(), judge1.type_handle());
 }
 
 void Book::defpr(size_t m, size_t n, const std::string& a) {
@@ -316,8 +419,6 @@ void Book::defpr(size_t m, size_t n, const std::string& a) {
     }
     const auto& judge1 = (*this)[m];
     const auto& judge2 = (*this)[n];
-    auto K = judge1.term();
-    auto L = judge1.type();
     auto N = judge2.term();
     auto& xAs = judge2.context();
     std::vector<std::shared_ptr<Term>> xs;
@@ -326,8 +427,8 @@ void Book::defpr(size_t m, size_t n, const std::string& a) {
         std::make_shared<Environment>(
             *judge1.env() +
             std::make_shared<Definition>(xAs, constant(a, xs), N)),
-        judge1.context(),
-        K, L);
+        judge1.context_handle(),
+        judge1.term_handle(), judge1.type_handle());
 }
 
 void Book::inst(size_t m, size_t n, const std::vector<size_t>& k, size_t p) {
@@ -350,8 +451,8 @@ void Book::inst(size_t m, size_t n, const std::vector<size_t>& k, size_t p) {
     }
 
     this->emplace_back(
-        judge.env(),
-        judge.context(),
+        judge.env_handle(),
+        judge.context_handle(),
         constant(D->definiendum(), Us),
         substitute(N, xs, Us));
 }
@@ -364,8 +465,8 @@ void Book::sp(size_t m, size_t n) {
     const auto& judge = (*this)[m];
     auto& tv = (*judge.context())[n];
     this->emplace_back(
-        judge.env(),
-        judge.context(),
+        judge.env_handle(),
+        judge.context_handle(),
         tv.value(),
         tv.type());
 }
@@ -379,18 +480,19 @@ void Book::tp(size_t m) {
     }
     const auto& judge = (*this)[m];
     this->emplace_back(
-        judge.env(),
-        judge.context(),
-        sq,
-        sq);
+        judge.env_handle(),
+        judge.context_handle(),
+        sq_handle(),
+        sq_handle());
 }
 
 std::string Book::string() const {
     std::string res("Book[[");
     bool singleLine = true;
     int indentSize = 1;
-    if (this->size() > 0) res += "\n[0]" + (*this)[0].string_brief(singleLine, indentSize);
-    for (size_t i = 1; i < this->size(); ++i) res += ",\n[" + std::to_string(i) + "]" + (*this)[i].string_brief(singleLine, indentSize);
+    auto brief = [&](size_t i) { return is_forgotten(i) ? std::string(" (forgotten)") : (*this)[i].string_brief(singleLine, indentSize); };
+    if (this->size() > 0) res += "\n[0]" + brief(0);
+    for (size_t i = 1; i < this->size(); ++i) res += ",\n[" + std::to_string(i) + "]" + brief(i);
     res += "\n]]";
     return res;
 }
@@ -405,6 +507,7 @@ std::string Book::def_list() const {
 }
 
 std::string Book::repr(size_t lno) const {
+    if (is_forgotten(lno)) return std::to_string(lno) + " : (forgotten)\n";
     std::stringstream ss;
     const auto& judge = (*this)[lno];
     ss << lno << " : ";
@@ -436,6 +539,7 @@ std::string Book::repr() const {
 }
 
 std::string Book::repr_new(size_t lno) const {
+    if (is_forgotten(lno)) return std::to_string(lno) + " : (forgotten)\n";
     std::stringstream ss;
     const auto& judge = (*this)[lno];
     ss << lno << " : ";
@@ -466,8 +570,71 @@ std::string Book::repr_new() const {
     return ss.str();
 }
 
+BookWriter::BookWriter(std::FILE* fp, BookFormat format, size_t bufsize) : _fp(fp), _format(format), _bufsize(bufsize) {
+    _buf.reserve(bufsize);
+}
+
+BookWriter::~BookWriter() {
+    flush();
+}
+
+void BookWriter::put(const std::string& str) {
+    _buf += str;
+    _bytes += str.size();
+    if (_buf.size() >= _bufsize) flush();
+}
+
+void BookWriter::flush() {
+    if (_buf.empty()) return;
+    std::fwrite(_buf.data(), sizeof(_buf[0]), _buf.size(), _fp);
+    _buf.clear();
+}
+
+void BookWriter::write(const Book& book, size_t lno) {
+    if (!_started) {
+        _started = true;
+        if (_format == BookFormat::Rich) put("Book[[");
+        else {
+            put(book.def_list());
+            if (book.env().size() > 0) put("--------------\n");
+        }
+    }
+    if (lno >= book.size()) return;
+    switch (_format) {
+        case BookFormat::Conventional:
+            put(book.repr(lno));
+            break;
+        case BookFormat::New:
+            put(book.repr_new(lno));
+            break;
+        case BookFormat::Rich:
+            put((lno == 0 ? "\n[" : ",\n[") + std::to_string(lno) + "]" + (book.is_forgotten(lno) ? std::string(" (forgotten)") : book[lno].string_brief(true, 1)));
+            break;
+    }
+    _next = lno + 1;
+}
+
+void BookWriter::write_all(const Book& book) {
+    if (!_started) write(book, _next);
+    while (_next < book.size()) write(book, _next);
+}
+
+void BookWriter::finish(const Book& book) {
+    if (_finished) return;
+    _finished = true;
+    write_all(book);
+    if (_format == BookFormat::Rich) put("\n]]");
+    flush();
+    std::fflush(_fp);
+}
+
 void Book::read_def_file(const std::string& fname) {
-    this->_env = Environment(fname);
+    set_def_env(Environment(fname));
+}
+
+void Book::set_def_env(const Environment& env) {
+    this->_env = env;
+    this->_def_dict.clear();
     for (size_t dno = 0; dno < this->env().size(); ++dno) {
         this->_def_dict[this->env()[dno]->definiendum()] = dno;
     }
@@ -687,7 +854,7 @@ bool is_conv_applicable(const Book& book, size_t idx1, size_t idx2) {
     auto B2 = judge2.term();
     auto s = judge2.type();
     check_true_or_ret_false_err(
-        is_convertible(B1, B2, *judge1.env()),
+        is_convertible_shared(B1, B2, *judge1.env()),
         "type of 1st judgement and term of 2nd judgement are not beta-delta-equivalent"
             << std::endl
             << "type 1: " << B1->repr_new() << std::endl
@@ -0,0 +1,98 @@
+#include "book_history.hpp"
+
+#include <algorithm>
+#include <utility>
+
+BookHistory::BookHistory(const Book& book, const TextData& script) {
+    clear();
+    _cur->judges.assign(book.begin(), book.end());
+    _cur->lines.assign(script.begin(), script.begin() + std::min(script.size(), book.size()));
+    _cur->lines.resize(book.size());
+    _len = book.size();
+}
+
+void BookHistory::push(const Judgement& judge, const std::string& line) {
+    // the lines after _len belong to states taken before an undo; they stay and a branch begins here
+    if (_len < _cur->judges.size()) {
+        auto seg = std::make_shared<Segment>();
+        seg->parent = _cur;
+        seg->begin = _cur->begin + _len;
+        seg->depth = _cur->depth + 1;
+        _cur = seg;
+        _len = 0;
+    }
+    _cur->judges.push_back(judge);
+    _cur->lines.push_back(line);
+    ++_len;
+}
+
+void BookHistory::pop(size_t n) {
+    while (n > 0) {
+        size_t k = std::min(n, _len);
+        _len -= k;
+        n -= k;
+        if (n == 0 || !_cur->parent) break;
+        _len = _cur->begin - _cur->parent->begin;
+        _cur = _cur->parent;
+    }
+    // no state refers to the lines undone
+    if (_cur.use_count() == 1) {
+        _cur->judges.erase(_cur->judges.begin() + _len, _cur->judges.end());
+        _cur->lines.resize(_len);
+    }
+}
+
+void BookHistory::clear() {
+    _cur = std::make_shared<Segment>();
+    _cur->begin = _cur->depth = 0;
+    _len = 0;
+}
+
+size_t BookHistory::size() const { return _cur->begin + _len; }
+
+BookHistory::State BookHistory::state() const { return State(_cur, _len); }
+
+size_t BookHistory::restore(const State& state, Book& book, TextData& script) {
+    // the prefix shared by the current book and state ends in their deepest common segment
+    size_t common = 0;
+    if (state._seg) {
+        auto a = _cur, b = state._seg;
+        size_t alen = _len, blen = state._len;
+        while (a != b && (a->parent || b->parent)) {
+            if (a->depth >= b->depth) {
+                alen = a->begin - a->parent->begin;
+                a = a->parent;
+            } else {
+                blen = b->begin - b->parent->begin;
+                b = b->parent;
+            }
+        }
+        if (a == b) common = a->begin + std::min(alen, blen);
+    }
+    common = std::min(common, book.size());
+    size_t replaced = book.size() - common;
+    book.erase(book.begin() + common, book.end());
+    script.resize(std::min(script.size(), common));
+
+    if (!state._seg) {
+        clear();
+        return replaced;
+    }
+    std::vector<std::pair<const Segment*, size_t>> path;
+    const Segment* node = state._seg.get();
+    for (size_t len = state._len; node && node->begin + len > common; node = node->parent.get()) {
+        path.emplace_back(node, len);
+        if (node->parent) len = node->begin - node->parent->begin;
+    }
+    for (auto it = path.rbegin(); it != path.rend(); ++it) {
+        const auto& [seg, len] = *it;
+        for (size_t i = std::max(common, seg->begin) - seg->begin; i < len; ++i) {
+            book.push_back(seg->judges[i]);
+            script.push_back(seg->lines[i]);
+            ++replaced;
+        }
+    }
+    _cur = state._seg;
+    _len = state._len;
+    return replaced;
+}
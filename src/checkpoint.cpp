@@ -0,0 +1,335 @@
+#include "checkpoint.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "script.hpp"
+
+namespace {
+
+enum class Tag : uint8_t {
+    End,
+    Star,
+    Square,
+    Variable,
+    Application,
+    AbstLambda,
+    AbstPi,
+    Constant,
+    Context,
+    Definition,
+    Environment,
+    Judgement,
+    Hashes,
+};
+
+}  // namespace
+
+void CheckpointWriter::write(std::ostream& os, const Book& book, const std::vector<uint64_t>& hashes) {
+    _body.clear();
+    _terms.clear();
+    _contexts.clear();
+    _defs.clear();
+    _envs.clear();
+
+    for (auto&& judge : book) {
+        uint64_t env = put_environment(judge.env());
+        uint64_t con = put_context(judge.context());
+        uint64_t term = put_term(judge.term());
+        uint64_t type = put_term(judge.type());
+        _body.put((uint8_t)Tag::Judgement);
+        _body.put_varint(env);
+        _body.put_varint(con);
+        _body.put_varint(term);
+        _body.put_varint(type);
+    }
+    if (hashes.size() > 0) {
+        _body.put((uint8_t)Tag::Hashes);
+        _body.put_varint(hashes.size());
+        for (uint64_t hash : hashes) {
+            for (int k = 0; k < 8; ++k, hash >>= 8) _body.put(hash & 0xff);
+        }
+    }
+    _body.put((uint8_t)Tag::End);
+
+    ByteWriter header;
+    header.put_bytes(CHECKPOINT_MAGIC, std::strlen(CHECKPOINT_MAGIC));
+    header.put_varint(CHECKPOINT_VERSION);
+    header.put_varint(book.is_checked() ? CHECKPOINT_CHECKED : 0);
+    header.put_varint(book.size());
+    os.write(header.data().data(), header.size());
+    os.write(_body.data().data(), _body.size());
+}
+
+uint64_t CheckpointWriter::put_term(const std::shared_ptr<Term>& term) {
+    if (!term) return 0;
+    auto itr = _terms.find(term.get());
+    if (itr != _terms.end()) return itr->second;
+
+    switch (term->etype()) {
+        case EpsilonType::Star:
+            _body.put((uint8_t)Tag::Star);
+            break;
+        case EpsilonType::Square:
+            _body.put((uint8_t)Tag::Square);
+            break;
+        case EpsilonType::Variable:
+            _body.put((uint8_t)Tag::Variable);
+            _body.put_string(variable(term)->name());
+            break;
+        case EpsilonType::Application: {
+            auto t = appl(term);
+            uint64_t M = put_term(t->M()), N = put_term(t->N());
+            _body.put((uint8_t)Tag::Application);
+            _body.put_varint(M);
+            _body.put_varint(N);
+            break;
+        }
+        case EpsilonType::AbstLambda:
+        case EpsilonType::AbstPi: {
+            const auto& var = term->etype() == EpsilonType::AbstLambda ? lambda(term)->var() : pi(term)->var();
+            const auto& expr = term->etype() == EpsilonType::AbstLambda ? lambda(term)->expr() : pi(term)->expr();
+            uint64_t x = put_term(var.value()), A = put_term(var.type()), M = put_term(expr);
+            _body.put((uint8_t)(term->etype() == EpsilonType::AbstLambda ? Tag::AbstLambda : Tag::AbstPi));
+            _body.put_varint(x);
+            _body.put_varint(A);
+            _body.put_varint(M);
+            break;
+        }
+        case EpsilonType::Constant: {
+            auto t = constant(term);
+            std::vector<uint64_t> args;
+            for (auto&& arg : t->args()) args.push_back(put_term(arg));
+            _body.put((uint8_t)Tag::Constant);
+            _body.put_string(t->name());
+            _body.put_varint(args.size());
+            for (auto&& arg : args) _body.put_varint(arg);
+            break;
+        }
+    }
+    uint64_t ref = _terms.size() + 1;
+    _terms.emplace(term.get(), ref);
+    return ref;
+}
+
+uint64_t CheckpointWriter::put_context(const std::shared_ptr<Context>& con) {
+    if (!con) return 0;
+    auto itr = _contexts.find(con.get());
+    if (itr != _contexts.end()) return itr->second;
+
+    std::vector<uint64_t> refs;
+    for (auto&& tv : *con) {
+        refs.push_back(put_term(tv.value()));
+        refs.push_back(put_term(tv.type()));
+    }
+    _body.put((uint8_t)Tag::Context);
+    _body.put_varint(con->size());
+    for (auto&& ref : refs) _body.put_varint(ref);
+
+    uint64_t ref = _contexts.size() + 1;
+    _contexts.emplace(con.get(), ref);
+    return ref;
+}
+
+uint64_t CheckpointWriter::put_definition(const std::shared_ptr<Definition>& def) {
+    if (!def) return 0;
+    auto itr = _defs.find(def.get());
+    if (itr != _defs.end()) return itr->second;
+
+    uint64_t con = put_context(def->context());
+    uint64_t definiens = put_term(def->definiens());
+    uint64_t type = put_term(def->type());
+    _body.put((uint8_t)Tag::Definition);
+    _body.put_string(def->definiendum());
+    _body.put_varint(con);
+    _body.put_varint(definiens);
+    _body.put_varint(type);
+
+    uint64_t ref = _defs.size() + 1;
+    _defs.emplace(def.get(), ref);
+    return ref;
+}
+
+uint64_t CheckpointWriter::put_environment(const std::shared_ptr<Environment>& env) {
+    if (!env) return 0;
+    auto itr = _envs.find(env.get());
+    if (itr != _envs.end()) return itr->second;
+
+    std::vector<uint64_t> refs;
+    for (auto&& def : *env) refs.push_back(put_definition(def));
+    _body.put((uint8_t)Tag::Environment);
+    _body.put_varint(refs.size());
+    for (auto&& ref : refs) _body.put_varint(ref);
+
+    uint64_t ref = _envs.size() + 1;
+    _envs.emplace(env.get(), ref);
+    return ref;
+}
+
+CheckpointReader::CheckpointReader(std::istream& is, const std::string& srcname) : _reader(is, srcname) {}
+
+template <class T>
+const T& CheckpointReader::get(const std::vector<T>& table, const char* kind, bool nullable) {
+    static const T null;
+    uint64_t ref = _reader.get_varint();
+    if (ref == 0) {
+        if (!nullable) throw FileError(_reader.name() + ": malformed checkpoint (null " + kind + " reference)");
+        return null;
+    }
+    if (ref > table.size()) throw FileError(_reader.name() + ": malformed checkpoint (" + kind + " reference out of range)");
+    return table[ref - 1];
+}
+
+size_t CheckpointReader::get_count(size_t unit, const char* kind) {
+    // every item takes at least unit bytes, so a count the file cannot hold is rejected before anything is allocated
+    uint64_t n = _reader.get_varint();
+    if (n > _avail / unit) throw FileError(_reader.name() + ": malformed checkpoint (" + kind + " count exceeds the file size)");
+    return n;
+}
+
+size_t CheckpointReader::read(Book& book, std::vector<uint64_t>* hashes) {
+    std::string magic(std::strlen(CHECKPOINT_MAGIC), '\0');
+    _reader.get_bytes(magic.data(), magic.size());
+    if (magic != CHECKPOINT_MAGIC) throw FileError(_reader.name() + ": not a checkpoint file (magic number mismatch)");
+    uint64_t version = _reader.get_varint();
+    if (version != CHECKPOINT_VERSION) {
+        throw FileError(_reader.name() + ": unsupported checkpoint version " + std::to_string(version) + " (expected " + std::to_string(CHECKPOINT_VERSION) + ")");
+    }
+    uint64_t flags = _reader.get_varint();
+    _avail = _reader.remaining();
+    size_t lines = get_count(5, "judgement");
+
+    book.clear();
+    book.set_checked(flags & CHECKPOINT_CHECKED);
+    if (_avail != SIZE_MAX) book.reserve(lines);
+    while (true) {
+        auto tag = (Tag)_reader.get();
+        switch (tag) {
+            case Tag::End:
+                if (book.size() != lines) throw FileError(_reader.name() + ": malformed checkpoint (# of judgements doesn't match)");
+                return lines;
+            case Tag::Star:
+                _terms.emplace_back(star);
+                break;
+            case Tag::Square:
+                _terms.emplace_back(sq);
+                break;
+            case Tag::Variable: {
+                auto name = _reader.get_string();
+                if (!is_variable_name(name)) throw FileError(_reader.name() + ": malformed checkpoint (invalid variable name)");
+                _terms.emplace_back(std::make_shared<Variable>(name));
+                break;
+            }
+            case Tag::Application: {
+                auto M = get(_terms, "term").ptr();
+                auto N = get(_terms, "term").ptr();
+                _terms.emplace_back(std::make_shared<Application>(M, N));
+                break;
+            }
+            case Tag::AbstLambda:
+            case Tag::AbstPi: {
+                auto x = variable(get(_terms, "term").ptr());
+                auto A = get(_terms, "term").ptr();
+                auto M = get(_terms, "term").ptr();
+                if (!x) throw FileError(_reader.name() + ": malformed checkpoint (bound variable is not a variable)");
+                if (tag == Tag::AbstLambda) _terms.emplace_back(std::make_shared<AbstLambda>(Typed<Variable>(x, A), M));
+                else _terms.emplace_back(std::make_shared<AbstPi>(Typed<Variable>(x, A), M));
+                break;
+            }
+            case Tag::Constant: {
+                auto name = _reader.get_string();
+                size_t n = get_count(1, "argument");
+                std::vector<std::shared_ptr<Term>> args;
+                for (size_t i = 0; i < n; ++i) args.push_back(get(_terms, "term").ptr());
+                _terms.emplace_back(std::make_shared<Constant>(name, args));
+                break;
+            }
+            case Tag::Context: {
+                auto con = std::make_shared<Context>();
+                size_t n = get_count(2, "context entry");
+                for (size_t i = 0; i < n; ++i) {
+                    auto x = variable(get(_terms, "term").ptr());
+                    auto A = get(_terms, "term").ptr();
+                    if (!x) throw FileError(_reader.name() + ": malformed checkpoint (context entry is not a variable)");
+                    con->emplace_back(x, A);
+                }
+                _contexts.emplace_back(con);
+                break;
+            }
+            case Tag::Definition: {
+                auto name = _reader.get_string();
+                auto con = get(_contexts, "context").ptr();
+                // primitive definitions have no definiens
+                auto definiens = get(_terms, "term", true).ptr();
+                auto type = get(_terms, "term").ptr();
+                _defs.push_back(std::make_shared<Definition>(con, name, definiens, type));
+                break;
+            }
+            case Tag::Environment: {
+                size_t n = get_count(1, "definition");
+                std::vector<std::shared_ptr<Definition>> defs;
+                for (size_t i = 0; i < n; ++i) defs.push_back(get(_defs, "definition"));
+                _envs.emplace_back(std::make_shared<Environment>(defs));
+                break;
+            }
+            case Tag::Judgement: {
+                // the handles share one pool slot per object, as the judgements of a verified book do
+                auto env = get(_envs, "environment", true);
+                auto con = get(_contexts, "context", true);
+                auto term = get(_terms, "term", true);
+                auto type = get(_terms, "term", true);
+                // a judgement is either complete or a tombstone left by Book::forget()
+                bool all = env && con && term && type, none = !env && !con && !term && !type;
+                if (!all && !none) throw FileError(_reader.name() + ": malformed checkpoint (judgement " + std::to_string(book.size()) + " has null references)");
+                book.emplace_back(env, con, term, type);
+                break;
+            }
+            case Tag::Hashes: {
+                size_t n = get_count(8, "hash");
+                if (hashes) hashes->resize(n);
+                for (size_t i = 0; i < n; ++i) {
+                    uint64_t hash = 0;
+                    for (int k = 0; k < 8; ++k) hash |= (uint64_t)_reader.get() << (8 * k);
+                    if (hashes) (*hashes)[i] = hash;
+                }
+                break;
+            }
+            default:
+                throw FileError(_reader.name() + ": malformed checkpoint (unknown tag " + std::to_string((int)tag) + ")");
+        }
+    }
+}
+
+void write_checkpoint(const std::string& fname, const Book& book, const std::vector<uint64_t>& hashes) {
+    std::string tmpname = fname + ".tmp";
+    {
+        std::ofstream ofs(tmpname, std::ios::binary);
+        if (!ofs) throw FileError("write_checkpoint(): " + tmpname + ": could not open file");
+        CheckpointWriter().write(ofs, book, hashes);
+        if (!ofs.flush()) throw FileError("write_checkpoint(): " + tmpname + ": write failed");
+    }
+    if (std::rename(tmpname.c_str(), fname.c_str()) != 0) throw FileError("write_checkpoint(): " + fname + ": rename failed");
+}
+
+size_t read_checkpoint(const std::string& fname, Book& book, std::vector<uint64_t>* hashes) {
+    std::ifstream ifs(fname, std::ios::binary);
+    if (!ifs) throw FileError("read_checkpoint(): " + fname + ": file not found");
+    return CheckpointReader(ifs, fname).read(book, hashes);
+}
+
+size_t resume_checkpoint(const std::string& fname, Book& book, const std::function<bool(ScriptRecord&)>& next) {
+    std::vector<uint64_t> hashes;
+    size_t lines = read_checkpoint(fname, book, &hashes);
+    if (hashes.size() != lines) throw FileError("resume_checkpoint(): " + fname + ": checkpoint has no line hashes to check the script against");
+    ScriptRecord rec;
+    for (size_t i = 0; i < lines; ++i) {
+        if (!next(rec)) throw FileError("resume_checkpoint(): " + fname + ": checkpoint covers " + std::to_string(lines) + " lines but the script has only " + std::to_string(i));
+        if (rec.hash() != hashes[i]) throw FileError("resume_checkpoint(): " + fname + ": line " + std::to_string(i) + " of the script differs from the one the checkpoint was taken with");
+    }
+    book.set_line_hashes(hashes);
+    return lines;
+}
@@ -2,28 +2,35 @@
 
 #include <fstream>
 #include <iostream>
+#include <iterator>
 #include <string>
 #include <vector>
 
+#include "scan.hpp"
+
 FileError::FileError(const std::string& str) : _msg(str) {}
 void FileError::puterror(std::ostream& os) const {
     os << BOLD(RED("FileError")) << ": " << _msg << std::endl;
 }
 
-TextData read_lines(const std::string& fname) {
-    std::ifstream ifs(fname);
-    if (!ifs) throw FileError("read_lines(): " + fname + ": file not found");
+// reads the whole input at once and splits it as std::getline does
+TextData read_lines(std::istream& is = std::cin) {
+    std::string text(std::istreambuf_iterator<char>(is), {});
     TextData lines;
-    std::string str;
-    while (std::getline(ifs, str)) lines.emplace_back(str);
+    lines.reserve(scan::count(text.data(), text.data() + text.size(), '\n') + 1);
+    const char* end = text.data() + text.size();
+    for (const char* p = text.data(); p < end;) {
+        const char* nl = scan::find(p, end, '\n');
+        lines.emplace_back(p, nl);
+        p = nl + 1;
+    }
     return lines;
 }
 
-TextData read_lines(std::istream& is = std::cin) {
-    TextData lines;
-    std::string str;
-    while (std::getline(is, str)) lines.emplace_back(str);
-    return lines;
+TextData read_lines(const std::string& fname) {
+    std::ifstream ifs(fname, std::ios::binary);
+    if (!ifs) throw FileError("read_lines(): " + fname + ": file not found");
+    return read_lines(ifs);
 }
 
 size_t edit_distance(const std::string_view& a, const std::string_view& b) {
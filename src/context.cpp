@@ -4,10 +4,11 @@
 #include <set>
 
 #include "common.hpp"
+#include "instrument.hpp"
 #include "lambda.hpp"
 
 Context::Context() {}
-Context::Context(const std::vector<Typed<Variable>>& tvars) : std::vector<Typed<Variable>>(tvars) {}
+Context::Context(const std::vector<Typed<Variable>>& tvars) : vector(tvars.begin(), tvars.end()) {}
 std::string Context::string() const {
     std::string res("");
     if (this->size() == 0) return SYMBOL_EMPTY;
@@ -94,7 +95,10 @@ std::shared_ptr<Variable> get_fresh_var(const Context& con) {
     return get_fresh_var_depleted();
 }
 
+instrument::Probe equiv_context_probe("context.equiv_context", "equiv_context");
+
 bool equiv_context_n(const Context& a, const Context& b, size_t n) {
+    instrument::ProbeScope probe(equiv_context_probe);
     check_true_or_ret_false(
         n <= a.size(),
         "equiv_context_n(): 1st context doesn't have n statements",
@@ -123,11 +127,13 @@ bool equiv_context_n(const Context& a, const Context& b, size_t n) {
 }
 
 bool equiv_context_n(const std::shared_ptr<Context>& a, const std::shared_ptr<Context>& b, size_t n) {
+    instrument::ProbeScope probe(equiv_context_probe);
     if (a == b) return true;
     return equiv_context_n(*a, *b, n);
 }
 
 bool equiv_context(const Context& a, const Context& b) {
+    instrument::ProbeScope probe(equiv_context_probe);
     check_true_or_ret_false(
         a.size() == b.size(),
         "equiv_context(): size of two context doesn't match",
@@ -136,10 +142,30 @@ bool equiv_context(const Context& a, const Context& b) {
 }
 
 bool equiv_context(const std::shared_ptr<Context>& a, const std::shared_ptr<Context>& b) {
+    instrument::ProbeScope probe(equiv_context_probe);
     if (a == b) return true;
     return equiv_context(*a, *b);
 }
 
+bool exact_comp(const Context& a, const Context& b) {
+    if (a.size() != b.size()) return false;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (!exact_comp(a[i].value(), b[i].value()) || !exact_comp(a[i].type(), b[i].type())) return false;
+    }
+    return true;
+}
+
+// the types are hashed only at the top: contexts extend one another, so a full walk
+// would visit the same types again for each context, while the tops already tell them apart
+size_t exact_hash(const Context& con) {
+    size_t h = con.size();
+    for (auto&& tv : con) {
+        h = h * 1000003 ^ exact_hash(*tv.value());
+        h = h * 1000003 ^ exact_hash(*tv.type(), 1);
+    }
+    return h;
+}
+
 bool has_variable(const std::shared_ptr<Context>& g, const std::shared_ptr<Variable>& v) {
     for (auto&& tv : *g) {
         if (alpha_comp(tv.value(), v)) return true;
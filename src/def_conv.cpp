@@ -1,20 +1,29 @@
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 
 #include "common.hpp"
+#include "defbin.hpp"
 #include "environment.hpp"
+#include "instrument.hpp"
 #include "lambda.hpp"
 #include "parser.hpp"
 
 [[noreturn]] void usage(const std::string& execname, bool is_err = true) {
     std::cerr << "usage: " << execname << " [FILE] [OPTION]...\n"
               << std::endl;
-    std::cerr << "with no FILE, read stdin. options:\n"
+    std::cerr << "with no FILE, read stdin. FILE may also be compiled by -b. options:\n"
               << std::endl;
     std::cerr << "\t-f FILE     read FILE instead of stdin" << std::endl;
+    std::cerr << "\t-o out_file write output to out_file instead of stdout" << std::endl;
     std::cerr << "\t-c          output def file in conventional notation" << std::endl;
     std::cerr << "\t-n          output def file in new notation" << std::endl;
     std::cerr << "\t-r          output def file in rich notation" << std::endl;
+    std::cerr << "\t-b          output compiled environment (.defbin), which the tools load without parsing" << std::endl;
+    std::cerr << "\t--stats     print the instrument counters and timers at exit" << std::endl;
+    std::cerr << "\t--stats-json FILE" << std::endl;
+    std::cerr << "\t            write the instrument counters and timers to FILE in JSON at exit" << std::endl;
     // std::cerr << "\t-v          verbose output for debugging purpose" << std::endl;
     std::cerr << "\t-s          suppress output and just verify input (overrides -v)" << std::endl;
     std::cerr << "\t-h          display this help and exit" << std::endl;
@@ -25,15 +34,17 @@
 enum Notation {
     Conventional,
     New,
-    Rich
+    Rich,
+    Binary
 };
 
 int main(int argc, char* argv[]) {
-    FileData data;
-    std::string fname("");
+    std::unique_ptr<SourceBuffer> src;
+    std::string fname(""), ofname(""), stats_json("");
     int notation = Conventional;
     // bool is_verbose = false;
     bool is_quiet = false;
+    bool show_stats = false;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
@@ -41,10 +52,18 @@ int main(int argc, char* argv[]) {
             if (arg == "-f") {
                 fname = std::string(argv[++i]);
                 continue;
+            } else if (arg == "-o") {
+                ofname = std::string(argv[++i]);
+                continue;
+            } else if (arg == "--stats-json") {
+                stats_json = std::string(argv[++i]);
+                continue;
             } else if (arg == "-c") notation = Conventional;
             else if (arg == "-n") notation = New;
             else if (arg == "-r") notation = Rich;
+            else if (arg == "-b") notation = Binary;
             // else if (arg == "-v") is_verbose = true;
+            else if (arg == "--stats") show_stats = true;
             else if (arg == "-h") usage(argv[0], false);
             else if (arg == "-s") is_quiet = true;
             else {
@@ -60,34 +79,47 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (fname.size() == 0) data = FileData(true);
-    else data = FileData(fname);
-
-    std::vector<Token> tokens;
     try {
-        tokens = tokenize(data);
-    } catch (BaseError& e) {
+        if (fname.size() == 0) src = std::make_unique<SourceBuffer>(std::cin, "stdin");
+        else src = std::make_unique<SourceBuffer>(fname);
+    } catch (FileError& e) {
         e.puterror();
         exit(EXIT_FAILURE);
     }
 
     Environment env;
     try {
-        env = parse_defs(tokens);
+        if (is_defbin(src->text())) env = read_defbin(src->text(), src->name());
+        else env = parse_defs_parallel(tokenize(*src));
     } catch (BaseError& e) {
         e.puterror();
         exit(EXIT_FAILURE);
+    } catch (FileError& e) {
+        e.puterror();
+        exit(EXIT_FAILURE);
     }
     if (!is_quiet) {
+        std::ofstream ofs;
+        if (ofname.size() > 0) {
+            ofs.open(ofname, std::ios::binary);
+            if (!ofs) {
+                std::cerr << "error: could not open file: " << ofname << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        std::ostream& os = ofname.size() > 0 ? ofs : std::cout;
         switch (notation) {
             case Conventional:
-                std::cout << env.repr() << std::endl;
+                os << env.repr() << std::endl;
                 break;
             case New:
-                std::cout << env.repr_new() << std::endl;
+                os << env.repr_new() << std::endl;
                 break;
             case Rich:
-                std::cout << env.string(false) << std::endl;
+                os << env.string(false) << std::endl;
+                break;
+            case Binary:
+                write_defbin(os, env);
                 break;
             default:
                 check_true_or_exit(
@@ -97,5 +129,15 @@ int main(int argc, char* argv[]) {
         }
     }
 
+    if (show_stats) instrument::dump(std::cerr);
+    if (stats_json.size() > 0) {
+        try {
+            instrument::dump_json(stats_json);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
+
     return 0;
 }
@@ -0,0 +1,272 @@
+#include "defbin.hpp"
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "binary.hpp"
+#include "common.hpp"
+
+namespace {
+
+enum class Tag : uint8_t {
+    End,
+    Star,
+    Square,
+    Variable,
+    Application,
+    AbstLambda,
+    AbstPi,
+    Constant,
+    Context,
+    Definition,
+};
+
+class DefbinWriter {
+  public:
+    void write(std::ostream& os, const Environment& env);
+
+  private:
+    uint64_t put_name(const std::string& name);
+    uint64_t put_term(const std::shared_ptr<Term>& term);
+    uint64_t put_context(const std::shared_ptr<Context>& con);
+
+    ByteWriter _body;
+    std::vector<const std::string*> _names;
+    std::unordered_map<std::string, uint64_t> _name_index;
+    std::unordered_map<const void*, uint64_t> _terms, _contexts;
+};
+
+void DefbinWriter::write(std::ostream& os, const Environment& env) {
+    for (auto&& def : env) {
+        uint64_t con = put_context(def->context());
+        uint64_t definiens = put_term(def->definiens());
+        uint64_t type = put_term(def->type());
+        _body.put((uint8_t)Tag::Definition);
+        _body.put_varint(put_name(def->definiendum()));
+        _body.put_varint(con);
+        _body.put_varint(definiens);
+        _body.put_varint(type);
+    }
+    _body.put((uint8_t)Tag::End);
+
+    ByteWriter header;
+    header.put_bytes(DEFBIN_MAGIC, std::strlen(DEFBIN_MAGIC));
+    header.put_varint(DEFBIN_VERSION);
+    header.put_varint(_names.size());
+    for (auto&& name : _names) header.put_string(*name);
+    header.put_varint(_terms.size());
+    header.put_varint(_contexts.size());
+    header.put_varint(env.size());
+    os.write(header.data().data(), header.size());
+    os.write(_body.data().data(), _body.size());
+}
+
+uint64_t DefbinWriter::put_name(const std::string& name) {
+    auto [itr, inserted] = _name_index.emplace(name, _names.size());
+    if (inserted) _names.push_back(&itr->first);
+    return itr->second;
+}
+
+uint64_t DefbinWriter::put_term(const std::shared_ptr<Term>& term) {
+    if (!term) return 0;
+    auto itr = _terms.find(term.get());
+    if (itr != _terms.end()) return itr->second;
+
+    switch (term->etype()) {
+        case EpsilonType::Star:
+            _body.put((uint8_t)Tag::Star);
+            break;
+        case EpsilonType::Square:
+            _body.put((uint8_t)Tag::Square);
+            break;
+        case EpsilonType::Variable:
+            _body.put((uint8_t)Tag::Variable);
+            _body.put_varint(put_name(variable(term)->name()));
+            break;
+        case EpsilonType::Application: {
+            auto t = appl(term);
+            uint64_t M = put_term(t->M()), N = put_term(t->N());
+            _body.put((uint8_t)Tag::Application);
+            _body.put_varint(M);
+            _body.put_varint(N);
+            break;
+        }
+        case EpsilonType::AbstLambda:
+        case EpsilonType::AbstPi: {
+            const auto& var = term->etype() == EpsilonType::AbstLambda ? lambda(term)->var() : pi(term)->var();
+            const auto& expr = term->etype() == EpsilonType::AbstLambda ? lambda(term)->expr() : pi(term)->expr();
+            uint64_t x = put_term(var.value()), A = put_term(var.type()), M = put_term(expr);
+            _body.put((uint8_t)(term->etype() == EpsilonType::AbstLambda ? Tag::AbstLambda : Tag::AbstPi));
+            _body.put_varint(x);
+            _body.put_varint(A);
+            _body.put_varint(M);
+            break;
+        }
+        case EpsilonType::Constant: {
+            auto t = constant(term);
+            std::vector<uint64_t> args;
+            for (auto&& arg : t->args()) args.push_back(put_term(arg));
+            _body.put((uint8_t)Tag::Constant);
+            _body.put_varint(put_name(t->name()));
+            _body.put_varint(args.size());
+            for (auto&& arg : args) _body.put_varint(arg);
+            break;
+        }
+    }
+    uint64_t ref = _terms.size() + 1;
+    _terms.emplace(term.get(), ref);
+    return ref;
+}
+
+uint64_t DefbinWriter::put_context(const std::shared_ptr<Context>& con) {
+    if (!con) return 0;
+    auto itr = _contexts.find(con.get());
+    if (itr != _contexts.end()) return itr->second;
+
+    std::vector<uint64_t> refs;
+    for (auto&& tv : *con) {
+        refs.push_back(put_term(tv.value()));
+        refs.push_back(put_term(tv.type()));
+    }
+    _body.put((uint8_t)Tag::Context);
+    _body.put_varint(con->size());
+    for (auto&& ref : refs) _body.put_varint(ref);
+
+    uint64_t ref = _contexts.size() + 1;
+    _contexts.emplace(con.get(), ref);
+    return ref;
+}
+
+}  // namespace
+
+bool is_defbin(std::string_view head) {
+    return head.substr(0, std::strlen(DEFBIN_MAGIC)) == DEFBIN_MAGIC;
+}
+
+void write_defbin(std::ostream& os, const Environment& env) {
+    DefbinWriter().write(os, env);
+}
+
+Environment read_defbin(std::string_view data, const std::string& srcname) {
+    ByteReader reader(data, srcname);
+    auto malformed = [&](const std::string& what) { return FileError(srcname + ": malformed compiled environment (" + what + ")"); };
+
+    std::string magic(std::strlen(DEFBIN_MAGIC), '\0');
+    reader.get_bytes(magic.data(), magic.size());
+    if (magic != DEFBIN_MAGIC) throw FileError(srcname + ": not a compiled environment (magic number mismatch)");
+    uint64_t version = reader.get_varint();
+    if (version != DEFBIN_VERSION) {
+        throw FileError(srcname + ": unsupported compiled environment version " + std::to_string(version) + " (expected " + std::to_string(DEFBIN_VERSION) + ")");
+    }
+    // every item takes at least unit bytes, so a count the data cannot hold is refused before anything is allocated
+    auto get_count = [&](size_t unit, const char* what) -> size_t {
+        uint64_t count = reader.get_varint();
+        if (count > reader.remaining() / unit) throw malformed(std::string("# of ") + what + " exceeds the size of the data");
+        return count;
+    };
+    std::vector<std::string> names(get_count(1, "names"));
+    for (auto&& name : names) name = reader.get_string();
+    std::vector<std::shared_ptr<Term>> terms;
+    std::vector<std::shared_ptr<Context>> contexts;
+    terms.reserve(get_count(1, "terms"));
+    contexts.reserve(get_count(2, "contexts"));
+    size_t n = get_count(5, "definitions");
+
+    auto get_name = [&]() -> const std::string& {
+        uint64_t idx = reader.get_varint();
+        if (idx >= names.size()) throw malformed("name reference out of range");
+        return names[idx];
+    };
+    // reference 0 (null) is only valid where nullable, i.e. the definiens of a primitive definition
+    auto get_term = [&](bool nullable = false) -> std::shared_ptr<Term> {
+        uint64_t ref = reader.get_varint();
+        if (ref == 0) {
+            if (!nullable) throw malformed("null term reference");
+            return nullptr;
+        }
+        if (ref > terms.size()) throw malformed("term reference out of range");
+        return terms[ref - 1];
+    };
+    auto get_var = [&]() {
+        auto x = get_term();
+        if (x->etype() != EpsilonType::Variable) throw malformed("bound variable is not a variable");
+        return variable(x);
+    };
+
+    Environment env;
+    env.reserve(n);
+    while (true) {
+        auto tag = (Tag)reader.get();
+        switch (tag) {
+            case Tag::End:
+                if (env.size() != n) throw malformed("# of definitions doesn't match");
+                return env;
+            case Tag::Star:
+                terms.push_back(star);
+                break;
+            case Tag::Square:
+                terms.push_back(sq);
+                break;
+            case Tag::Variable: {
+                const auto& name = get_name();
+                if (!is_variable_name(name)) throw malformed("invalid variable name");
+                terms.push_back(std::make_shared<Variable>(name));
+                break;
+            }
+            case Tag::Application: {
+                auto M = get_term();
+                auto N = get_term();
+                terms.push_back(std::make_shared<Application>(M, N));
+                break;
+            }
+            case Tag::AbstLambda:
+            case Tag::AbstPi: {
+                auto x = get_var();
+                auto A = get_term();
+                auto M = get_term();
+                if (tag == Tag::AbstLambda) terms.push_back(std::make_shared<AbstLambda>(Typed<Variable>(x, A), M));
+                else terms.push_back(std::make_shared<AbstPi>(Typed<Variable>(x, A), M));
+                break;
+            }
+            case Tag::Constant: {
+                // a definition is written after the terms of its definiens and type, so a constant names one already read
+                const auto& name = get_name();
+                auto def = env.lookup_def(name);
+                if (!def) throw malformed("constant " + name + " names no preceding definition");
+                std::vector<std::shared_ptr<Term>> args(get_count(1, "arguments"));
+                if (args.size() != def->context()->size()) throw malformed("# of arguments of constant " + name + " doesn't match its definition");
+                for (auto&& arg : args) arg = get_term();
+                terms.push_back(std::make_shared<Constant>(name, std::move(args)));
+                break;
+            }
+            case Tag::Context: {
+                auto con = std::make_shared<Context>();
+                size_t k = get_count(2, "context entries");
+                con->reserve(k);
+                for (size_t i = 0; i < k; ++i) {
+                    auto x = get_var();
+                    auto A = get_term();
+                    con->emplace_back(x, A);
+                }
+                contexts.push_back(con);
+                break;
+            }
+            case Tag::Definition: {
+                const auto& name = get_name();
+                if (env.has_name(name)) throw malformed("definition " + name + " is defined twice");
+                uint64_t ref = reader.get_varint();
+                if (ref == 0 || ref > contexts.size()) throw malformed("context reference out of range");
+                auto definiens = get_term(true);
+                auto type = get_term();
+                // appended as parse_defs() does, so that lookups behave the same
+                env.push_back(std::make_shared<Definition>(contexts[ref - 1], name, definiens, type));
+                break;
+            }
+            default:
+                throw malformed("unknown tag " + std::to_string((int)tag));
+        }
+    }
+}
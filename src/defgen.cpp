@@ -0,0 +1,242 @@
+// generate a definition file of any size for scaling tests
+// every definition is well-typed, so that genscript and verifier accept the file.
+//
+// definitions are generated in δ-chains, each headed by a primitive predicate:
+//   P{i}[A:*, a:A, ...] := # : *
+//   T{i}[A:*, a:A, ...] := ?y:A.?B:C1.?C:C2. ... Ck : *
+//   T{i}_id[A:*, a:A, ...] := $z:T{i}[A, a, ...].z : ?z:T{i}[A, a, ...].T{i}[A, a, ...]
+// C1 is T{i-1}[...] inside a chain (P{i}[...] at its head) and C2, ..., Ck are instances of fan-out - 1
+// P's picked at random from the whole file. only C1 unfolds, so δ-normal forms grow linearly with the chain length.
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+#include "defbin.hpp"
+#include "environment.hpp"
+#include "lambda.hpp"
+#include "parser.hpp"
+#include "source_buffer.hpp"
+
+[[noreturn]] void usage(const std::string& execname, bool is_err = true) {
+    std::cerr << "usage: " << execname << " [OPTION]...\n"
+              << std::endl;
+    std::cerr << "output a definition file of well-typed synthetic definitions. options:\n"
+              << std::endl;
+    std::cerr << "\t--defs N      number of definitions (default: 100)" << std::endl;
+    std::cerr << "\t--context N   number of variables in each context besides A:* (default: 2, at most 16)" << std::endl;
+    std::cerr << "\t--size N      number of premises in the type of each T definition (default: 4, at most 34)" << std::endl;
+    std::cerr << "\t--chain N     length of δ-chains, in which each T unfolds to the previous one (default: 4)" << std::endl;
+    std::cerr << "\t--fanout N    number of earlier definitions each T refers to (default: 2, at most 34)" << std::endl;
+    std::cerr << "\t--seed N      seed of the random choices (default: 1)" << std::endl;
+    std::cerr << "\t-o out_file   output to out_file instead of stdout" << std::endl;
+    std::cerr << "\t-c            output def file in conventional notation (default)" << std::endl;
+    std::cerr << "\t-n            output def file in new notation" << std::endl;
+    std::cerr << "\t-b            output compiled environment (.defbin)" << std::endl;
+    std::cerr << "\t--check       read the output back and compare it with the generated definitions" << std::endl;
+    std::cerr << "\t-h            display this help and exit" << std::endl;
+    if (is_err) exit(EXIT_FAILURE);
+    exit(EXIT_SUCCESS);
+}
+
+enum Notation {
+    Conventional,
+    New,
+    Binary
+};
+
+struct GenParams {
+    size_t defs = 100;
+    size_t context = 2;
+    size_t size = 4;
+    size_t chain = 4;
+    size_t fanout = 2;
+    uint64_t seed = 1;
+};
+
+class DefGenerator {
+  public:
+    DefGenerator(const GenParams& params) : _params(params), _rng(params.seed) {}
+    Environment generate();
+
+  private:
+    // name and number of parameters besides A of a definition of type *
+    struct TypeDef {
+        std::string name;
+        size_t arity;
+    };
+
+    std::shared_ptr<Context> make_context(size_t arity) const;
+    std::shared_ptr<Term> instance(const TypeDef& def, const std::vector<std::string>& vars);
+    std::shared_ptr<Term> type_body(const TypeDef& first, const TypeDef& head, const std::vector<std::string>& ctx_vars);
+    size_t pick(size_t n) { return std::uniform_int_distribution<size_t>(0, n - 1)(_rng); }
+
+    GenParams _params;
+    std::mt19937_64 _rng;
+    std::vector<TypeDef> _prims;  // P's so far
+};
+
+const std::string ContextVars = "abcdefghijklmnop";
+const std::string PremiseVars = "BCDEFGHIJKLMNOPQRSTUVWXYZqrstuvwx";
+
+std::shared_ptr<Context> DefGenerator::make_context(size_t arity) const {
+    auto con = std::make_shared<Context>();
+    con->emplace_back(std::make_shared<Variable>("A"), star);
+    for (size_t i = 0; i < arity; ++i) con->emplace_back(std::make_shared<Variable>(std::string(1, ContextVars[i])), std::make_shared<Variable>("A"));
+    return con;
+}
+
+// def[A, v1, ..., vm] with v's taken at random from vars
+std::shared_ptr<Term> DefGenerator::instance(const TypeDef& def, const std::vector<std::string>& vars) {
+    std::vector<std::shared_ptr<Term>> args{std::make_shared<Variable>("A")};
+    for (size_t i = 0; i < def.arity; ++i) args.push_back(std::make_shared<Variable>(vars[pick(vars.size())]));
+    return std::make_shared<Constant>(def.name, std::move(args));
+}
+
+// ?y:A.?B:C1. ... Ck with C1 an instance of first and the others of fanout - 1 earlier P's (or of the head of the chain)
+std::shared_ptr<Term> DefGenerator::type_body(const TypeDef& first, const TypeDef& head, const std::vector<std::string>& ctx_vars) {
+    std::vector<std::string> vars(ctx_vars);
+    vars.push_back("y");
+    std::vector<TypeDef> others;
+    while (others.size() + 1 < _params.fanout) others.push_back(_prims[pick(_prims.size())]);
+    if (others.empty()) others.push_back(head);
+    size_t premises = std::max(_params.size, others.size() + 1);
+
+    auto component = [&](size_t k) { return instance(k == 0 ? first : others[(k - 1) % others.size()], vars); };
+    std::shared_ptr<Term> term = component(premises - 1);
+    for (size_t k = premises - 1; k-- > 0;) {
+        auto x = std::make_shared<Variable>(std::string(1, PremiseVars[k]));
+        term = std::make_shared<AbstPi>(Typed<Variable>(x, component(k)), term);
+    }
+    return std::make_shared<AbstPi>(Typed<Variable>(std::make_shared<Variable>("y"), std::make_shared<Variable>("A")), term);
+}
+
+Environment DefGenerator::generate() {
+    Environment env;
+    std::vector<std::string> ctx_vars;
+    for (size_t i = 0; i < _params.context; ++i) ctx_vars.emplace_back(1, ContextVars[i]);
+    auto full_instance = [&](const std::string& name) {
+        std::vector<std::shared_ptr<Term>> args{std::make_shared<Variable>("A")};
+        for (auto&& v : ctx_vars) args.push_back(std::make_shared<Variable>(v));
+        return std::make_shared<Constant>(name, std::move(args));
+    };
+
+    TypeDef head, prev;
+    for (size_t i = 0; env.size() < _params.defs; ++i) {
+        const std::string id = std::to_string(i);
+        if (i % _params.chain == 0) {
+            head = prev = {"P" + id, _params.context};
+            env.push_back(std::make_shared<Definition>(make_context(_params.context), head.name, star));
+            _prims.push_back(head);
+            if (env.size() == _params.defs) break;
+        }
+
+        TypeDef type{"T" + id, _params.context};
+        env.push_back(std::make_shared<Definition>(make_context(_params.context), type.name, type_body(prev, head, ctx_vars), star));
+        prev = type;
+        if (env.size() == _params.defs) break;
+
+        auto proof = std::make_shared<AbstLambda>(Typed<Variable>(std::make_shared<Variable>("z"), full_instance(type.name)), std::make_shared<Variable>("z"));
+        auto prop = std::make_shared<AbstPi>(Typed<Variable>(std::make_shared<Variable>("z"), full_instance(type.name)), full_instance(type.name));
+        env.push_back(std::make_shared<Definition>(make_context(_params.context), type.name + "_id", proof, prop));
+    }
+    return env;
+}
+
+int main(int argc, char* argv[]) {
+    GenParams params;
+    std::string ofname("");
+    int notation = Conventional;
+    bool check = false;
+
+    auto number = [&](int& i) -> uint64_t {
+        if (i + 1 >= argc) usage(argv[0]);
+        try {
+            return std::stoull(argv[++i]);
+        } catch (std::exception&) {
+            std::cerr << BOLD(RED("error")) << ": not a number: " << argv[i] << std::endl;
+            usage(argv[0]);
+        }
+    };
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg == "--defs") params.defs = number(i);
+        else if (arg == "--context") params.context = number(i);
+        else if (arg == "--size") params.size = number(i);
+        else if (arg == "--chain") params.chain = number(i);
+        else if (arg == "--fanout") params.fanout = number(i);
+        else if (arg == "--seed") params.seed = number(i);
+        else if (arg == "-o" && i + 1 < argc) ofname = std::string(argv[++i]);
+        else if (arg == "-c") notation = Conventional;
+        else if (arg == "-n") notation = New;
+        else if (arg == "-b") notation = Binary;
+        else if (arg == "--check") check = true;
+        else if (arg == "-h") usage(argv[0], false);
+        else {
+            std::cerr << BOLD(RED("error")) << ": invalid token: " << arg << std::endl;
+            usage(argv[0]);
+        }
+    }
+    if (params.context > ContextVars.size() || std::max(params.size, params.fanout) > PremiseVars.size() + 1 || params.chain == 0) {
+        std::cerr << BOLD(RED("error")) << ": --context must be at most " << ContextVars.size()
+                  << ", --size and --fanout at most " << PremiseVars.size() + 1 << " and --chain positive" << std::endl;
+        usage(argv[0]);
+    }
+
+    Environment env = DefGenerator(params).generate();
+
+    std::string out;
+    {
+        std::ostringstream oss;
+        switch (notation) {
+            case Conventional:
+                oss << env.repr() << std::endl;
+                break;
+            case New:
+                oss << env.repr_new() << std::endl;
+                break;
+            case Binary:
+                write_defbin(oss, env);
+                break;
+        }
+        out = oss.str();
+    }
+
+    if (check) {
+        Environment env_read;
+        try {
+            if (notation == Binary) env_read = read_defbin(out, "[defgen]");
+            else {
+                std::istringstream iss(out);
+                SourceBuffer src(iss, "[defgen]");
+                env_read = parse_defs_parallel(tokenize(src));
+            }
+        } catch (BaseError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+        if (env_read.repr() != env.repr()) {
+            std::cerr << BOLD(RED("error")) << ": generated definitions did not read back the same" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (ofname.size() > 0) {
+        std::ofstream ofs(ofname, std::ios::binary);
+        if (!ofs) {
+            std::cerr << "error: could not open file: " << ofname << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        ofs << out;
+    } else std::cout << out;
+    return 0;
+}
@@ -0,0 +1,245 @@
+#include "derivation_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "binary.hpp"
+#include "common.hpp"
+
+namespace {
+
+void fnv1a(uint64_t& h, const std::string& str) {
+    for (auto&& ch : str) {
+        h ^= (unsigned char)ch;
+        h *= 1099511628211ULL;
+    }
+    h ^= 0xff;  // terminator, so that ("ab", "c") and ("a", "bc") differ
+    h *= 1099511628211ULL;
+}
+
+void put_u64(ByteWriter& writer, uint64_t x) {
+    for (int k = 0; k < 8; ++k, x >>= 8) writer.put(x & 0xff);
+}
+
+uint64_t get_u64(ByteReader& reader) {
+    uint64_t x = 0;
+    for (int k = 0; k < 8; ++k) x |= (uint64_t)reader.get() << (8 * k);
+    return x;
+}
+
+// every item takes at least unit bytes, so a count the data cannot hold is rejected before anything is allocated
+size_t get_count(ByteReader& reader, size_t unit, const char* kind) {
+    uint64_t n = reader.get_varint();
+    if (n > reader.remaining() / unit) throw FileError(reader.name() + ": " + kind + " count exceeds the data size");
+    return n;
+}
+
+}  // namespace
+
+uint64_t derivation_key(const std::shared_ptr<Definition>& def, const std::map<std::string, uint64_t>& keys) {
+    uint64_t h = 14695981039346656037ULL;
+    fnv1a(h, def->string());
+    for (auto&& c : extract_constant(def)) {
+        fnv1a(h, c);
+        auto itr = keys.find(c);
+        fnv1a(h, itr == keys.end() ? std::string() : std::to_string(itr->second));
+    }
+    return h;
+}
+
+void DerivationCache::load(const std::string& fname) {
+    std::ifstream ifs(fname, std::ios::binary);
+    if (!ifs) return;
+    ByteReader reader(ifs, fname);
+    std::string magic(std::strlen(DERIVATION_CACHE_MAGIC), '\0');
+    reader.get_bytes(magic.data(), magic.size());
+    if (magic != DERIVATION_CACHE_MAGIC) throw FileError(fname + ": not a derivation cache (magic number mismatch)");
+    // a cache of another version is just discarded
+    if (reader.get_varint() != DERIVATION_CACHE_VERSION) return;
+    size_t n = get_count(reader, 9, "entry");
+    for (size_t i = 0; i < n; ++i) {
+        uint64_t key = get_u64(reader);
+        _loaded[key] = reader.get_string();
+    }
+}
+
+void DerivationCache::save(const std::string& fname, bool prune) const {
+    auto entries = _used;
+    if (!prune) entries.insert(_loaded.begin(), _loaded.end());
+    ByteWriter writer;
+    writer.put_bytes(DERIVATION_CACHE_MAGIC, std::strlen(DERIVATION_CACHE_MAGIC));
+    writer.put_varint(DERIVATION_CACHE_VERSION);
+    writer.put_varint(entries.size());
+    for (auto&& [key, body] : entries) {
+        put_u64(writer, key);
+        writer.put_string(body);
+    }
+    std::ofstream ofs(fname, std::ios::binary);
+    if (!ofs) throw FileError(fname + ": could not open file");
+    ofs.write(writer.data().data(), writer.size());
+    if (!ofs.flush()) throw FileError(fname + ": write failed");
+}
+
+RulePtr DerivationCache::derive(const Delta& delta, const std::shared_ptr<Definition>& def) {
+    RulePtr base = get_script(star, delta, std::make_shared<Context>());
+    uint64_t key = derivation_key(def, _keys);
+    _keys[def->definiendum()] = key;
+    if (auto body = lookup(key, base, delta)) {
+        RulePtr rule;
+        if (def->is_prim()) rule = std::make_shared<Defpr>(base, body, def->definiendum());
+        else rule = std::make_shared<Def>(base, body, def->definiendum());
+        delta->push_back(def);
+        register_script(star, delta, std::make_shared<Context>(), rule);
+        return rule;
+    }
+    delta->push_back(def);
+    RulePtr rule = get_script(star, delta, std::make_shared<Context>());
+    auto body = def->is_prim() ? std::dynamic_pointer_cast<Defpr>(rule)->idx2() : std::dynamic_pointer_cast<Def>(rule)->idx2();
+    store(key, body, base, delta);
+    return rule;
+}
+
+RulePtr DerivationCache::lookup(uint64_t key, const RulePtr& base, const Delta& delta) {
+    auto itr = _loaded.find(key);
+    if (itr == _loaded.end()) {
+        ++_misses;
+        return nullptr;
+    }
+    ByteReader reader(std::string_view(itr->second), "derivation cache");
+    std::vector<RulePtr> nodes(get_count(reader, 1, "node"));
+    auto get_ref = [&](size_t limit) -> RulePtr {
+        uint64_t ref = reader.get_varint();
+        if (ref == 0) return base;
+        if (ref > limit) throw FileError("derivation cache: malformed entry (reference out of range)");
+        return nodes[ref - 1];
+    };
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        auto rtype = (RuleType)reader.get();
+        switch (rtype) {
+            case RuleType::Sort:
+                nodes[i] = std::make_shared<Sort>();
+                break;
+            case RuleType::Var: {
+                auto idx = get_ref(i);
+                nodes[i] = std::make_shared<Var>(idx, reader.get_string());
+                break;
+            }
+            case RuleType::Weak:
+            case RuleType::Def:
+            case RuleType::Defpr: {
+                auto idx1 = get_ref(i), idx2 = get_ref(i);
+                auto name = reader.get_string();
+                if (rtype == RuleType::Weak) nodes[i] = std::make_shared<Weak>(idx1, idx2, name);
+                else if (rtype == RuleType::Def) nodes[i] = std::make_shared<Def>(idx1, idx2, name);
+                else nodes[i] = std::make_shared<Defpr>(idx1, idx2, name);
+                break;
+            }
+            case RuleType::Form:
+            case RuleType::Appl:
+            case RuleType::Abst:
+            case RuleType::Conv: {
+                auto idx1 = get_ref(i), idx2 = get_ref(i);
+                if (rtype == RuleType::Form) nodes[i] = std::make_shared<Form>(idx1, idx2);
+                else if (rtype == RuleType::Appl) nodes[i] = std::make_shared<Appl>(idx1, idx2);
+                else if (rtype == RuleType::Abst) nodes[i] = std::make_shared<Abst>(idx1, idx2);
+                else nodes[i] = std::make_shared<Conv>(idx1, idx2);
+                break;
+            }
+            case RuleType::Inst: {
+                auto idx = get_ref(i);
+                std::vector<RulePtr> k(get_count(reader, 1, "argument"));
+                for (auto&& r : k) r = get_ref(i);
+                int p = delta->lookup_index(reader.get_string());
+                if (p < 0) {
+                    ++_misses;
+                    return nullptr;
+                }
+                nodes[i] = std::make_shared<Inst>(idx, k.size(), k, p);
+                break;
+            }
+            default:
+                throw FileError("derivation cache: malformed entry (rule " + to_string(rtype) + ")");
+        }
+    }
+    auto root = get_ref(nodes.size());
+    ++_hits;
+    _used[key] = itr->second;
+    return root;
+}
+
+void DerivationCache::store(uint64_t key, const RulePtr& root, const RulePtr& base, const Delta& delta) {
+    ByteWriter nodes;
+    std::unordered_map<const Rule*, uint64_t> refs;
+    refs[base.get()] = 0;
+
+    std::function<uint64_t(const RulePtr&)> put = [&](const RulePtr& rule) -> uint64_t {
+        auto itr = refs.find(rule.get());
+        if (itr != refs.end()) return itr->second;
+        ByteWriter node;
+        node.put((uint8_t)rule->rtype());
+        auto put_pair = [&](RulePtr& idx1, RulePtr& idx2) {
+            uint64_t r1 = put(idx1), r2 = put(idx2);
+            node.put_varint(r1);
+            node.put_varint(r2);
+        };
+        switch (rule->rtype()) {
+            case RuleType::Sort: break;
+            case RuleType::Var: {
+                auto r = std::dynamic_pointer_cast<Var>(rule);
+                node.put_varint(put(r->idx()));
+                node.put_string(r->var());
+                break;
+            }
+            case RuleType::Weak: {
+                auto r = std::dynamic_pointer_cast<Weak>(rule);
+                put_pair(r->idx1(), r->idx2());
+                node.put_string(r->var());
+                break;
+            }
+            case RuleType::Def: {
+                auto r = std::dynamic_pointer_cast<Def>(rule);
+                put_pair(r->idx1(), r->idx2());
+                node.put_string(r->name());
+                break;
+            }
+            case RuleType::Defpr: {
+                auto r = std::dynamic_pointer_cast<Defpr>(rule);
+                put_pair(r->idx1(), r->idx2());
+                node.put_string(r->name());
+                break;
+            }
+            case RuleType::Form: put_pair(std::dynamic_pointer_cast<Form>(rule)->idx1(), std::dynamic_pointer_cast<Form>(rule)->idx2()); break;
+            case RuleType::Appl: put_pair(std::dynamic_pointer_cast<Appl>(rule)->idx1(), std::dynamic_pointer_cast<Appl>(rule)->idx2()); break;
+            case RuleType::Abst: put_pair(std::dynamic_pointer_cast<Abst>(rule)->idx1(), std::dynamic_pointer_cast<Abst>(rule)->idx2()); break;
+            case RuleType::Conv: put_pair(std::dynamic_pointer_cast<Conv>(rule)->idx1(), std::dynamic_pointer_cast<Conv>(rule)->idx2()); break;
+            case RuleType::Inst: {
+                auto r = std::dynamic_pointer_cast<Inst>(rule);
+                uint64_t idx = put(r->idx());
+                std::vector<uint64_t> k;
+                for (auto&& ki : r->k()) k.push_back(put(ki));
+                node.put_varint(idx);
+                node.put_varint(k.size());
+                for (auto&& ki : k) node.put_varint(ki);
+                node.put_string((*delta)[r->p()]->definiendum());
+                break;
+            }
+            default:
+                throw DeductionError("derivation cache: rule " + to_string(rule->rtype()) + " cannot be stored");
+        }
+        nodes.put_bytes(node.data().data(), node.size());
+        uint64_t ref = refs.size();  // base takes ref 0
+        refs[rule.get()] = ref;
+        return ref;
+    };
+    uint64_t root_ref = put(root);
+
+    ByteWriter body;
+    body.put_varint(refs.size() - 1);
+    body.put_bytes(nodes.data().data(), nodes.size());
+    body.put_varint(root_ref);
+    _used[key] = body.data();
+}
@@ -1,26 +1,37 @@
 #include "environment.hpp"
 
+#include <algorithm>
 #include <memory>
+#include <mutex>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "common.hpp"
+#include "defbin.hpp"
+#include "instrument.hpp"
 #include "parser.hpp"
 
 Environment::Environment() {}
-Environment::Environment(const std::vector<std::shared_ptr<Definition>>& defs) : std::vector<std::shared_ptr<Definition>>(defs) {
+Environment::Environment(const std::vector<std::shared_ptr<Definition>>& defs) : vector(defs.begin(), defs.end()) {
     for (size_t idx = 0; idx < this->size(); ++idx) {
         _def_index[(*this)[idx]->definiendum()] = idx;
     }
 }
 
-std::vector<std::shared_ptr<FileData>> raw_fname_fds;
+std::vector<std::shared_ptr<SourceBuffer>> raw_fname_srcs;
 
 Environment::Environment(const std::string& fname) {
-    std::shared_ptr<FileData> fdp = std::make_shared<FileData>(fname);
-    raw_fname_fds.push_back(fdp);
-    auto tokens = tokenize(*fdp);
-    *this = parse_defs(tokens);
+    auto src = std::make_shared<SourceBuffer>(fname);
+    if (is_defbin(src->text())) {
+        *this = read_defbin(src->text(), fname);
+        return;
+    }
+    raw_fname_srcs.push_back(src);
+    auto tokens = tokenize(*src);
+    *this = parse_defs_parallel(tokens);
 }
 
 std::string Environment::string(bool inSingleLine, size_t indentSize) const {
@@ -67,15 +78,46 @@ std::string Environment::repr_new() const {
     return res;
 }
 
+void Environment::index_names() const {
+    size_t n = this->size();
+    auto agrees = [&](size_t k) { return k == 0 || _names->defs[k - 1] == (*this)[k - 1].get(); };
+    if (_names && n <= _names->defs.size() && agrees(n)) return;
+    if (_names && n > _names->defs.size() && agrees(_names->defs.size())) {
+        // this environment goes on where the shared run ends, so the run is extended for every copy
+        for (size_t k = _names->defs.size(); k < n; ++k) {
+            _names->first.emplace((*this)[k]->definiendum(), k);
+            _names->defs.push_back((*this)[k].get());
+        }
+        return;
+    }
+    // first query, or this environment has replaced definitions of the shared run: index it on its own
+    _names = std::make_shared<NameIndex>();
+    for (size_t k = 0; k < n; ++k) {
+        _names->first.emplace((*this)[k]->definiendum(), k);
+        _names->defs.push_back((*this)[k].get());
+    }
+}
+
+bool Environment::has_name(const std::string& cname) const {
+    index_names();
+    auto named = _names->first.find(cname);
+    return named != _names->first.end() && named->second < this->size();
+}
+
+bool Environment::has_prefix(const std::string& prefix) const {
+    index_names();
+    for (auto itr = _names->first.lower_bound(prefix); itr != _names->first.end() && itr->first.compare(0, prefix.size(), prefix) == 0; ++itr) {
+        if (itr->second < this->size()) return true;
+    }
+    return false;
+}
+
 int Environment::lookup_index(const std::string& cname) const {
     auto itr = _def_index.find(cname);
     if (itr != _def_index.end()) return itr->second;
-    for (size_t idx = 0; idx < this->size(); ++idx) {
-        if ((*this)[idx]->definiendum() == cname) {
-            return _def_index[cname] = idx;
-        }
-    }
-    return -1;
+    index_names();
+    auto named = _names->first.find(cname);
+    return named == _names->first.end() || named->second >= this->size() ? -1 : named->second;
 }
 int Environment::lookup_index(const std::shared_ptr<Constant>& c) const {
     return lookup_index(c->name());
@@ -89,6 +131,42 @@ const std::shared_ptr<Definition> Environment::lookup_def(const std::shared_ptr<
     return lookup_def(c->name());
 }
 
+namespace {
+
+// the tables behind content_id() and is_convertible_shared(), guarded by one mutex
+std::mutex shared_mtx;
+std::unordered_map<std::string, uint32_t> def_ids;  // definitions by text (0 is not used)
+std::map<std::pair<uint32_t, uint32_t>, uint32_t> env_ids;  // (Δ, D) -> Δ, D, where 0 is the empty environment
+std::unordered_set<std::string> convertible_pairs;
+// the table stops growing here; the pairs in it are still answered
+constexpr size_t MAX_CONVERTIBLE_PAIRS = 1 << 20;
+
+std::string def_text(const Definition& def) {
+    std::string str;
+    for (auto&& xA : *def.context()) str += xA.value()->repr() + ":" + xA.type()->repr() + ",";
+    str += "|" + def.definiendum() + ":=" + (def.is_prim() ? "#" : def.definiens()->repr()) + ":" + def.type()->repr();
+    return str;
+}
+
+}  // namespace
+
+uint32_t Environment::content_id() const {
+    if (this->empty()) return 0;
+    index_names();
+    auto& ids = _names->content_ids;
+    if (ids.size() < this->size()) {
+        std::vector<std::string> texts;
+        for (size_t k = ids.size(); k < this->size(); ++k) texts.push_back(def_text(*(*this)[k]));
+        std::lock_guard<std::mutex> lock(shared_mtx);
+        for (auto&& text : texts) {
+            uint32_t def_id = def_ids.emplace(text, def_ids.size() + 1).first->second;
+            uint32_t prev = ids.empty() ? 0 : ids.back();
+            ids.push_back(env_ids.emplace(std::make_pair(prev, def_id), env_ids.size() + 1).first->second);
+        }
+    }
+    return ids[this->size() - 1];
+}
+
 Environment& Environment::operator+=(const std::shared_ptr<Definition>& def) {
     this->push_back(def);
     _def_index[def->definiendum()] = this->size() - 1;
@@ -98,7 +176,10 @@ Environment Environment::operator+(const std::shared_ptr<Definition>& def) const
     return Environment(*this) += def;
 }
 
+instrument::Probe equiv_env_probe("environment.equiv_env", "equiv_env");
+
 bool equiv_env(const Environment& a, const Environment& b) {
+    instrument::ProbeScope probe(equiv_env_probe);
     check_true_or_ret_false(
         a.size() == b.size(),
         "equiv_env(): # of definitions doesn't match",
@@ -123,6 +204,7 @@ bool equiv_env(const Environment& a, const Environment& b) {
 }
 
 bool equiv_env(const std::shared_ptr<Environment>& a, const std::shared_ptr<Environment>& b) {
+    instrument::ProbeScope probe(equiv_env_probe);
     if (a == b) return true;
     return equiv_env(*a, *b);
 }
@@ -141,7 +223,10 @@ bool has_definition(const std::shared_ptr<Environment>& env, const std::shared_p
     return false;
 }
 
+instrument::Counter delta_reductions("environment.delta_reduce");
+
 std::shared_ptr<Term> delta_reduce(const std::shared_ptr<Constant>& term, const Environment& delta) {
+    ++delta_reductions;
     const std::shared_ptr<Definition> D = delta.lookup_def(term);
     if (!D) {
         std::cerr << "delta_reduce(): error: no such definition found: " << term->name() << std::endl;
@@ -232,14 +317,23 @@ std::shared_ptr<Term> delta_nf_above(const std::shared_ptr<Term>& term, const En
         __FILE__, __LINE__, __func__);
 }
 
+instrument::Probe delta_nf_probe("environment.delta_nf", "delta_nf");
+
 std::shared_ptr<Term> delta_nf(const std::shared_ptr<Term>& term, const Environment& delta) {
+    instrument::ProbeScope probe(delta_nf_probe);
     return delta_nf_above(term, delta, 0);
 }
 
+instrument::Probe nf_probe("environment.NF", "NF", true);
+instrument::Histogram nf_rounds("environment.NF.rounds");
+
 std::shared_ptr<Term> NF_above(const std::shared_ptr<Term>& term, const Environment& delta, int idx) {
+    instrument::ProbeScope probe(nf_probe);
+    uint64_t rounds = 0;
     std::shared_ptr<Term> t, t_prev, t_dx;
     t = term;
     do {
+        ++rounds;
         t_prev = t;
         t = beta_nf(t);
         if (!alpha_comp(t, beta_nf(t))) {
@@ -252,6 +346,7 @@ std::shared_ptr<Term> NF_above(const std::shared_ptr<Term>& term, const Environm
             exit(EXIT_FAILURE);
         }
     } while (!alpha_comp(t, t_prev));
+    nf_rounds.record(rounds);
     return t;
 }
 
@@ -341,7 +436,23 @@ std::shared_ptr<Term> reduce_application(const std::shared_ptr<Application>& ter
         __FILE__, __LINE__, __func__);
 }
 
+instrument::Probe conv_probe("environment.is_convertible", "is_convertible");
+
+bool is_convertible_shared(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b, const Environment& delta) {
+    if (!shared_conversions) return is_convertible(a, b, delta);
+    std::string key = std::to_string(delta.content_id()) + "\n" + a->repr() + "\n" + b->repr();
+    {
+        std::lock_guard<std::mutex> lock(shared_mtx);
+        if (convertible_pairs.count(key)) return true;
+    }
+    if (!is_convertible(a, b, delta)) return false;
+    std::lock_guard<std::mutex> lock(shared_mtx);
+    if (convertible_pairs.size() < MAX_CONVERTIBLE_PAIRS) convertible_pairs.insert(std::move(key));
+    return true;
+}
+
 bool is_convertible(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b, const Environment& delta) {
+    instrument::ProbeScope probe(conv_probe);
     // std::cerr << "conv a = " << a << std::endl;
     // std::cerr << "conv b = " << b << std::endl;
     if (flag_address_comp && a == b) return true;
@@ -1,29 +1,46 @@
 #include <atomic>
 #include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <queue>
 #include <string>
-#include <thread>
 
 #include "common.hpp"
+#include "defbin.hpp"
+#include "derivation_cache.hpp"
 #include "environment.hpp"
 #include "inference.hpp"
+#include "instrument.hpp"
 #include "lambda.hpp"
 #include "parser.hpp"
+#include "progress.hpp"
+#include "script.hpp"
+#include "trace.hpp"
 
 [[noreturn]] void usage(const std::string& execname, bool is_err = true) {
     std::cerr << "usage: " << execname << " [FILE] [OPTION]...\n"
               << std::endl;
-    std::cerr << "with no FILE, read stdin.\n"
+    std::cerr << "with no FILE, read stdin. FILE may also be compiled by def_conv -b.\n"
               << "without option -t, script of the last definition of input will be generated.\n"
               << "options:\n"
               << std::endl;
     std::cerr << "\t-f FILE      read FILE instead of stdin" << std::endl;
     std::cerr << "\t-o out_file  output script to out_file instead of stdout" << std::endl;
     std::cerr << "\t-t def       output script only containing def and dependent definitions" << std::endl;
+    std::cerr << "\t-b           output script in binary format" << std::endl;
+    std::cerr << "\t--cache FILE reuse derivations of unchanged definitions from FILE and update it" << std::endl;
     std::cerr << "\t--dry-run    output dependency of def given with -t and exit" << std::endl;
+    std::cerr << "\t--trace FILE write the derivation to FILE as Chrome trace events (for about:tracing or Perfetto)" << std::endl;
+    std::cerr << "\t--progress MODE" << std::endl;
+    std::cerr << "\t             auto (default: tty if stderr is a terminal, otherwise off), tty, json (a JSON object per line) or off" << std::endl;
+    std::cerr << "\t--progress-json FILE" << std::endl;
+    std::cerr << "\t             write the json progress records to FILE (e.g. /dev/fd/3) instead of stderr (implies --progress json)" << std::endl;
+    std::cerr << "\t--stats      print the instrument counters and timers at exit" << std::endl;
+    std::cerr << "\t--stats-json FILE" << std::endl;
+    std::cerr << "\t             write the instrument counters and timers to FILE in JSON at exit" << std::endl;
     std::cerr << "\t-v           verbose output for debugging purpose" << std::endl;
     std::cerr << "\t-s           suppress output and just verify input (overrides -v)" << std::endl;
     std::cerr << "\t-h           display this help and exit" << std::endl;
@@ -31,59 +48,52 @@
     exit(EXIT_SUCCESS);
 }
 
-extern size_t issued_rules, cache_hit, genscr_called;
-auto alive_prog_chk = std::atomic_bool(true);
-const size_t time_unit_ms = 97;
-std::string current_def;
-void progress_check() {
-    size_t last_cnt = 0, time_counter = 0, maxlen = 0;
-    size_t last_try = 0, last_hit = 0;
-    const std::chrono::milliseconds interval(time_unit_ms);
-    std::this_thread::sleep_for(interval);
-    while (alive_prog_chk.load()) {
-        auto start = std::chrono::system_clock::now();
-        std::stringstream ss;
-        if (time_counter > 0) {
-            std::cerr << "\033[F\033[F" << '\r' << std::flush;
-        }
-        ss << "[" << (++time_counter) * time_unit_ms / 1000 << " secs]";
-        ss << " issued rules: " << issued_rules
-           << " (+" << (issued_rules - last_cnt) * 1000 / time_unit_ms << " judgements/sec, cache hit: "
-           << (last_try == genscr_called ? 0 : (double)(cache_hit - last_hit) / (genscr_called - last_try)) * 100 << " %)";
-        std::string text = ss.str();
-        if (text.size() > maxlen) maxlen = ss.str().size();
-        else text += std::string(maxlen - ss.str().size(), ' ');
-        ss.clear();
-        ss.str("");
-
-        text += '\n';
-        ss << "processing: " << current_def;
-        text += ss.str();
-        if (ss.str().size() > maxlen) maxlen = ss.str().size();
-        else text += std::string(maxlen - ss.str().size(), ' ');
-        ss.clear();
-        ss.str("");
-        std::cerr << text << std::endl;
-        last_cnt = issued_rules;
-        last_hit = cache_hit;
-        last_try = genscr_called;
-        auto end = std::chrono::system_clock::now();
-        auto waste = end - start;
-        if (waste < interval) std::this_thread::sleep_for(interval - waste);
+// the definition being derived (its name lives as long as env), read by the progress reporter
+std::atomic<const std::string*> current_def = nullptr;
+std::unique_ptr<ProgressReporter> progress;
+
+ProgressReporter::Sample progress_sample() {
+    // the reporter thread is the only caller
+    static uint64_t last_try = 0, last_hit = 0;
+    ProgressReporter::Sample sample;
+    sample.done = issued_rules;
+    uint64_t tried = genscr_called, hit = cache_hit;
+    sample.values.push_back({"cache hit %", tried == last_try ? 0 : (double)(hit - last_hit) / (tried - last_try) * 100});
+    last_try = tried, last_hit = hit;
+    if (auto def = current_def.load(std::memory_order_relaxed)) sample.status = *def;
+    if (alloc_track::enabled) sample.notes.push_back(alloc_track::brief());
+    return sample;
+}
+
+std::string trace_fname;
+instrument::Probe definition_probe("genscript.definition", "definition", true);
+
+// the trace is also written on failure, to see where the derivation stopped
+void write_trace() {
+    if (trace_fname.size() == 0) return;
+    try {
+        trace::write(trace_fname);
+    } catch (FileError& e) {
+        e.puterror();
+        exit(EXIT_FAILURE);
     }
-};
+}
 
 void finalize(int code) {
-    alive_prog_chk.store(false);
+    if (progress) progress->stop();
+    write_trace();
     exit(code);
 }
 
 int main(int argc, char* argv[]) {
-    FileData data;
-    std::string fname(""), target_def_name(""), ofname("");
+    std::unique_ptr<SourceBuffer> src;
+    std::string fname(""), target_def_name(""), ofname(""), cachename(""), stats_json(""), progress_json("");
     bool is_verbose = false;
     bool is_quiet = false;
     bool dry_run = false;
+    bool binary = false;
+    bool show_stats = false;
+    auto progress_mode = ProgressReporter::Mode::Auto;
 
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
@@ -94,13 +104,35 @@ int main(int argc, char* argv[]) {
             } else if (arg == "-o") {
                 ofname = std::string(argv[++i]);
                 continue;
+            } else if (arg == "--cache") {
+                cachename = std::string(argv[++i]);
+                continue;
+            } else if (arg == "--progress") {
+                if (!ProgressReporter::parse_mode(argv[++i], progress_mode)) {
+                    std::cerr << BOLD(RED("error")) << ": invalid progress mode: " << argv[i] << std::endl;
+                    usage(argv[0]);
+                }
+                continue;
+            } else if (arg == "--progress-json") {
+                progress_json = std::string(argv[++i]);
+                progress_mode = ProgressReporter::Mode::Json;
+                continue;
+            } else if (arg == "--trace") {
+                trace_fname = std::string(argv[++i]);
+                trace::enabled = true;
+                continue;
+            } else if (arg == "--stats-json") {
+                stats_json = std::string(argv[++i]);
+                continue;
             } else if (arg == "-t") {
                 target_def_name = std::string(argv[++i]);
                 continue;
             } else if (arg == "-v") is_verbose = true;
+            else if (arg == "-b") binary = true;
             else if (arg == "-h") usage(argv[0], false);
             else if (arg == "-s") is_quiet = true;
             else if (arg == "--dry-run") dry_run = true;
+            else if (arg == "--stats") show_stats = true;
             else {
                 std::cerr << BOLD(RED("error")) << ": invalid token: " << arg << std::endl;
                 usage(argv[0]);
@@ -122,33 +154,48 @@ int main(int argc, char* argv[]) {
         std::cerr << "Loading definition file... " << std::flush;
     }
 
-    if (fname.size() == 0) data = FileData(true);
-    else data = FileData(fname);
-
-    if (is_verbose) {
-        std::cerr << BOLD(GREEN("OK")) "\n";
-        std::cerr << "Tokenizing file... " << std::flush;
-    }
-
-    std::vector<Token> tokens;
     try {
-        tokens = tokenize(data);
-    } catch (BaseError& e) {
+        if (fname.size() == 0) src = std::make_unique<SourceBuffer>(std::cin, "stdin");
+        else src = std::make_unique<SourceBuffer>(fname);
+    } catch (FileError& e) {
         e.puterror();
         exit(EXIT_FAILURE);
     }
 
-    if (is_verbose) {
-        std::cerr << BOLD(GREEN("OK")) "\n";
-        std::cerr << "Parsing file... " << std::flush;
-    }
-
     Environment env;
-    try {
-        env = parse_defs(tokens);
-    } catch (BaseError& e) {
-        e.puterror();
-        exit(EXIT_FAILURE);
+    if (is_defbin(src->text())) {
+        // compiled by def_conv -b
+        try {
+            env = read_defbin(src->text(), src->name());
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    } else {
+        if (is_verbose) {
+            std::cerr << BOLD(GREEN("OK")) "\n";
+            std::cerr << "Tokenizing file... " << std::flush;
+        }
+
+        std::vector<Token> tokens;
+        try {
+            tokens = tokenize(*src);
+        } catch (BaseError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+
+        if (is_verbose) {
+            std::cerr << BOLD(GREEN("OK")) "\n";
+            std::cerr << "Parsing file... " << std::flush;
+        }
+
+        try {
+            env = parse_defs_parallel(tokens);
+        } catch (BaseError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
     }
 
     if (is_verbose) {
@@ -156,8 +203,34 @@ int main(int argc, char* argv[]) {
         std::cerr << "Deducing definitions... " << std::endl;
     }
 
-    std::thread th(progress_check);
-    th.detach();
+    DerivationCache cache;
+    if (cachename.size() > 0) {
+        try {
+            cache.load(cachename);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
+    // Δ, D; {} |- * : @, reusing the derivation of D from the cache with --cache
+    auto derive = [&](const Delta& delta, const std::shared_ptr<Definition>& def) {
+        instrument::ProbeScope probe(definition_probe, def->definiendum());
+        if (cachename.size() > 0) return cache.derive(delta, def);
+        delta->push_back(def);
+        return get_script(star, delta, std::make_shared<Context>());
+    };
+
+    progress = std::make_unique<ProgressReporter>(progress_mode, "issued rules", "judgements", progress_sample, std::chrono::milliseconds(100));
+    // the json progress records get a stream of their own, apart from the messages on stderr
+    if (progress_json.size() > 0) {
+        std::FILE* fp = std::fopen(progress_json.c_str(), "w");
+        if (!fp) {
+            std::cerr << BOLD(RED("error")) << ": could not open file: " << progress_json << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        progress->set_output(fp);
+    }
+    progress->start();
 
     RulePtr objective;
     if (target_def_name.size() > 0) {
@@ -208,14 +281,12 @@ int main(int argc, char* argv[]) {
 
         std::map<int, RulePtr> proofs;
         std::shared_ptr<Environment> delta = std::make_shared<Environment>();
-        std::shared_ptr<Context> gamma_dummy = std::make_shared<Context>();
         try {
             // get_script(star, std::make_shared<Environment>(env), gamma_dummy);
             for (auto&& [idx, cp] : resolved) {
                 auto def = env[idx];
-                delta->push_back(def);
-                current_def = def->definiendum();
-                proofs[idx] = get_script(star, delta, gamma_dummy);
+                current_def.store(&def->definiendum(), std::memory_order_relaxed);
+                proofs[idx] = derive(delta, def);
                 objective = proofs[idx];
             }
         } catch (DeductionError& e) {
@@ -224,17 +295,18 @@ int main(int argc, char* argv[]) {
         } catch (TypeError& e) {
             e.puterror();
             finalize(EXIT_FAILURE);
+        } catch (FileError& e) {
+            e.puterror();
+            finalize(EXIT_FAILURE);
         }
     } else {
         std::map<int, RulePtr> proofs;
         std::shared_ptr<Environment> delta = std::make_shared<Environment>();
-        std::shared_ptr<Context> gamma_dummy = std::make_shared<Context>();
         try {
             for (size_t idx = 0; idx < env.size(); ++idx) {
                 auto def = env[idx];
-                delta->push_back(def);
-                current_def = def->definiendum();
-                proofs[idx] = get_script(star, delta, gamma_dummy);
+                current_def.store(&def->definiendum(), std::memory_order_relaxed);
+                proofs[idx] = derive(delta, def);
                 objective = proofs[idx];
             }
         } catch (DeductionError& e) {
@@ -243,20 +315,53 @@ int main(int argc, char* argv[]) {
         } catch (TypeError& e) {
             e.puterror();
             finalize(EXIT_FAILURE);
+        } catch (FileError& e) {
+            e.puterror();
+            finalize(EXIT_FAILURE);
+        }
+    }
+    progress->stop();
+    write_trace();
+
+    if (cachename.size() > 0) {
+        std::cerr << "derivation cache: reused " << cache.hits() << " / " << cache.hits() + cache.misses() << " definitions." << std::endl;
+        try {
+            // a run with -t derives only a part of the file, so keep the entries of the rest
+            cache.save(cachename, target_def_name.size() == 0);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
         }
     }
-    alive_prog_chk.store(false);
 
     if (is_verbose) {
         std::cerr << "\n" BOLD(GREEN("DEDUCTION COMPLETE")) "\n";
         std::cerr << "Generating script... " << std::flush;
     }
 
+    // the binary script is streamed to the output while it is generated
+    std::ofstream bin_ofs;
+    std::ostream null_os(nullptr);
+    if (binary && !is_quiet && ofname.size() > 0) {
+        bin_ofs.open(ofname, std::ios::binary);
+        if (!bin_ofs) {
+            std::cerr << "error: could not open file: " << ofname << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
     TextData odata;
     try {
-        generate_script(objective, odata);
+        if (binary) {
+            ScriptBinaryWriter owriter(is_quiet ? null_os : ofname.size() > 0 ? bin_ofs : std::cout);
+            generate_script(objective, owriter);
+            owriter.finish();
+        } else generate_script(objective, odata);
     } catch (DeductionError& e) {
         e.puterror();
+        if (bin_ofs.is_open()) {
+            bin_ofs.close();
+            std::remove(ofname.c_str());
+        }
         exit(EXIT_FAILURE);
     }
 
@@ -265,9 +370,9 @@ int main(int argc, char* argv[]) {
         std::cerr << "Writing the script to output file..." << std::flush;
     }
 
-    if (!is_quiet) {
+    if (!is_quiet && !binary) {
         if (ofname.size() > 0) {
-            std::ofstream ofs(ofname);
+            std::ofstream ofs(ofname, std::ios::binary);
             if (!ofs) {
                 ofs.close();
                 std::cerr << "error: could not open file: " << ofname << std::endl;
@@ -286,5 +391,15 @@ int main(int argc, char* argv[]) {
         std::cerr << BOLD(GREEN("OK")) << std::endl;
     }
 
+    if (show_stats) instrument::dump(std::cerr);
+    if (stats_json.size() > 0) {
+        try {
+            instrument::dump_json(stats_json);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
+
     return 0;
 }
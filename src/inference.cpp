@@ -3,6 +3,7 @@
 #include "context.hpp"
 #include "environment.hpp"
 #include "judgement.hpp"
+#include "script.hpp"
 
 TypeError::TypeError(const std::string& str, const std::shared_ptr<Term>& term, const std::shared_ptr<Context>& con) : msg(str), term(term), con(con) {}
 
@@ -11,7 +12,10 @@ void TypeError::puterror(std::ostream& os) {
     os << "\tat term = " << term << ", context = " << con << std::endl;
 }
 
+instrument::Probe get_type_probe("inference.get_type", "get_type", true);
+
 std::shared_ptr<Term> get_type(const std::shared_ptr<Term>& term, const std::shared_ptr<Environment>& delta, const std::shared_ptr<Context>& gamma) {
+    instrument::ProbeScope probe(get_type_probe);
     // std::cerr << "[debug @ get_type] " << term << ", " << delta->string_simple() << ", " << gamma << std::endl;
     std::shared_ptr<Term> type = nullptr;
     switch (term->etype()) {
@@ -102,7 +106,7 @@ std::string to_string(const RuleType type) {
     return "[RuleType::to_string: unknown type: " + std::to_string((int)type) + "]";
 }
 
-size_t issued_rules = 0;
+instrument::ProgressCounter issued_rules("inference.issued_rules");
 
 Rule::Rule(RuleType rtype) : _rtype(rtype) { ++issued_rules; }
 RuleType Rule::rtype() const { return _rtype; }
@@ -155,6 +159,8 @@ DeductionError::DeductionError(const std::string& msg) : _msg(msg) {}
 void DeductionError::puterror(std::ostream& os) const { os << BOLD(RED("DeductionError")) ": " << _msg << std::endl; }
 
 std::map<std::string, RulePtr> hist_inf;
+// line number given to the next rule written by generate_script()
+size_t current_lno = 0;
 
 std::string hash_delta(const Delta& delta) {
     std::string str;
@@ -179,14 +185,17 @@ std::string hash_tuple(const Delta& delta, const Gamma& gamma, const std::shared
 
 // int func_called = 0;
 // int cache_hit = 0;
-size_t cache_hit = 0;
-size_t genscr_called = 0;
+instrument::ProgressCounter cache_hit("inference.get_script.hit");
+instrument::ProgressCounter genscr_called("inference.get_script");
+instrument::Histogram hash_bytes("inference.get_script.key", "B");
+instrument::Probe get_script_miss_probe("inference.get_script.miss", "get_script", true);
 
 RulePtr get_script(const std::shared_ptr<Term>& term, const Delta& delta, const Gamma& gamma) {
     // std::cerr << "[debug @ get_script] " << term << ", " << delta->string_simple() << ", " << gamma << std::endl;
     ++genscr_called;
 
     std::string hash = hash_tuple(delta, gamma, term);
+    hash_bytes.record(hash.size());
     auto itr_n = hist_inf.find(hash);
     if (itr_n != hist_inf.end()) {
         // std::cerr << "[debug @ get_script / cache-hit] " << term << ", " << delta->string_simple() << ", " << gamma << std::endl;
@@ -196,6 +205,7 @@ RulePtr get_script(const std::shared_ptr<Term>& term, const Delta& delta, const
 
     // cache missed (body of deduction process)
     // --cache_hit;
+    instrument::ProbeScope probe(get_script_miss_probe);
     RulePtr rule;
     // std::cerr << "cache miss: " << hash << std::endl;
 
@@ -398,102 +408,125 @@ RulePtr get_script(const std::shared_ptr<Term>& term, const Delta& delta, const
     }
 
     // cache register
+    probe.rename(to_string(rule->rtype()));
     hist_inf[hash] = rule;
     // std::cerr << "[debug @ get_script / cache-missed] " << term << ", " << delta->string_simple() << ", " << gamma << std::endl;
     return rule;
 }
 
-void generate_script(RulePtr& rule, TextData& data) {
-    static size_t current_lno = 0;
+void register_script(const std::shared_ptr<Term>& term, const Delta& delta, const Gamma& gamma, const RulePtr& rule) {
+    hist_inf[hash_tuple(delta, gamma, term)] = rule;
+}
+
+void clear_scripts() {
+    hist_inf.clear();
+    current_lno = 0;
+}
+
+void generate_script(RulePtr& rule, const std::function<void(size_t, const ScriptRecord&)>& emit) {
+    static ScriptRecord rec;
     if (rule->lno() >= 0) return;
     switch (rule->rtype()) {
         case RuleType::Sort: {
             auto r = std::dynamic_pointer_cast<Sort>(rule);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " sort";
-            data.push_back(script);
+            rec.clear(RuleType::Sort);
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Var: {
             auto r = std::dynamic_pointer_cast<Var>(rule);
-            generate_script(r->idx(), data);
+            generate_script(r->idx(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " var " + std::to_string(r->idx()->lno()) + " " + r->var();
-            data.push_back(script);
+            rec.clear(RuleType::Var);
+            rec.refs() = {(size_t)r->idx()->lno()};
+            rec.name() = r->var();
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Weak: {
             auto r = std::dynamic_pointer_cast<Weak>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " weak " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno()) + " " + r->var();
-            data.push_back(script);
+            rec.clear(RuleType::Weak);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            rec.name() = r->var();
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Form: {
             auto r = std::dynamic_pointer_cast<Form>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " form " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno());
-            data.push_back(script);
+            rec.clear(RuleType::Form);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Appl: {
             auto r = std::dynamic_pointer_cast<Appl>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " appl " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno());
-            data.push_back(script);
+            rec.clear(RuleType::Appl);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Abst: {
             auto r = std::dynamic_pointer_cast<Abst>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " abst " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno());
-            data.push_back(script);
+            rec.clear(RuleType::Abst);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Conv: {
             auto r = std::dynamic_pointer_cast<Conv>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " conv " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno());
-            data.push_back(script);
+            rec.clear(RuleType::Conv);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Def: {
             auto r = std::dynamic_pointer_cast<Def>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " def " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno()) + " " + r->name();
-            data.push_back(script);
+            rec.clear(RuleType::Def);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            rec.name() = r->name();
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Defpr: {
             auto r = std::dynamic_pointer_cast<Defpr>(rule);
-            generate_script(r->idx1(), data);
-            generate_script(r->idx2(), data);
+            generate_script(r->idx1(), emit);
+            generate_script(r->idx2(), emit);
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " defpr " + std::to_string(r->idx1()->lno()) + " " + std::to_string(r->idx2()->lno()) + " " + r->name();
-            data.push_back(script);
+            rec.clear(RuleType::Defpr);
+            rec.refs() = {(size_t)r->idx1()->lno(), (size_t)r->idx2()->lno()};
+            rec.name() = r->name();
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Inst: {
             auto r = std::dynamic_pointer_cast<Inst>(rule);
-            generate_script(r->idx(), data);
-            for (auto&& v : r->k()) { generate_script(v, data); }
+            generate_script(r->idx(), emit);
+            for (auto&& v : r->k()) { generate_script(v, emit); }
             r->lno() = current_lno++;
-            std::string script = std::to_string(r->lno()) + " inst " + std::to_string(r->idx()->lno()) + " " + std::to_string(r->k().size()) + " ";
-            for (auto&& v : r->k()) { script += std::to_string(v->lno()) + " "; }
-            script += std::to_string(r->p());
-            data.push_back(script);
+            rec.clear(RuleType::Inst);
+            rec.refs().push_back(r->idx()->lno());
+            for (auto&& v : r->k()) rec.refs().push_back(v->lno());
+            rec.arg() = r->p();
+            emit(r->lno(), rec);
             return;
         }
         case RuleType::Cp:
@@ -502,3 +535,11 @@ void generate_script(RulePtr& rule, TextData& data) {
             throw DeductionError("generate_script(): not implemented");
     }
 }
+
+void generate_script(RulePtr& rule, TextData& data) {
+    generate_script(rule, [&data](size_t lno, const ScriptRecord& rec) { data.push_back(rec.string(lno)); });
+}
+
+void generate_script(RulePtr& rule, ScriptBinaryWriter& writer) {
+    generate_script(rule, [&writer](size_t, const ScriptRecord& rec) { writer.write(rec); });
+}
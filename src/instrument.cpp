@@ -0,0 +1,144 @@
+#include "instrument.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+namespace instrument {
+
+namespace {
+
+std::mutex& registry_mutex() {
+    static std::mutex mtx;
+    return mtx;
+}
+
+// constructed on first use, as instruments are static objects of other translation units
+std::vector<const Instrument*>& registry() {
+    static std::vector<const Instrument*> instruments;
+    return instruments;
+}
+
+std::vector<const Probe*>& probe_registry() {
+    static std::vector<const Probe*> list;
+    return list;
+}
+
+}  // namespace
+
+bool profiling = false;
+
+void Instrument::enroll() {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    registry().push_back(this);
+}
+
+template <bool Enabled>
+void BasicCounter<Enabled>::print(std::ostream& os) const {
+    os << std::left << std::setw(28) << name() << std::right << std::setw(14) << value() << std::endl;
+}
+
+template <bool Enabled>
+void BasicCounter<Enabled>::print_json(std::ostream& os) const {
+    os << "{\"name\": \"" << name() << "\", \"kind\": \"counter\", \"value\": " << value() << "}";
+}
+
+template <bool Enabled>
+uint64_t BasicHistogram<Enabled>::quantile(double q) const {
+    uint64_t total = count(), seen = 0;
+    if (total == 0) return 0;
+    for (size_t b = 0; b < Buckets; ++b) {
+        seen += _buckets[b].load(std::memory_order_relaxed);
+        if (seen >= q * total) return b == 0 ? 0 : b >= 64 ? max() : std::min<uint64_t>(((uint64_t)1 << b) - 1, max());
+    }
+    return max();
+}
+
+template <bool Enabled>
+void BasicHistogram<Enabled>::print(std::ostream& os) const {
+    uint64_t n = count();
+    os << std::left << std::setw(28) << name() << std::right << std::setw(14) << n;
+    if (n > 0) {
+        os << "  avg " << sum() / n << _unit << ", p50 <= " << quantile(0.5) << _unit << ", p99 <= " << quantile(0.99) << _unit
+           << ", max " << max() << _unit << ", total " << sum() << _unit;
+    }
+    os << std::endl;
+}
+
+template <bool Enabled>
+void BasicHistogram<Enabled>::print_json(std::ostream& os) const {
+    os << "{\"name\": \"" << name() << "\", \"kind\": \"histogram\", \"unit\": \"" << _unit << "\", \"count\": " << count()
+       << ", \"sum\": " << sum() << ", \"max\": " << max() << ", \"buckets\": [";
+    // trailing empty buckets are omitted
+    size_t last = Buckets;
+    while (last > 0 && _buckets[last - 1].load(std::memory_order_relaxed) == 0) --last;
+    for (size_t b = 0; b < last; ++b) os << (b > 0 ? ", " : "") << _buckets[b].load(std::memory_order_relaxed);
+    os << "]}";
+}
+
+Probe::Probe(const char* name, const char* label, bool traced) : Timer(name), _label(label), _traced(traced) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    _index = probe_registry().size();
+    probe_registry().push_back(this);
+}
+
+size_t& Probe::depth() {
+    thread_local std::vector<size_t> depths;
+    if (depths.size() <= _index) depths.resize(_index + 1);
+    return depths[_index];
+}
+
+void ProbeScope::enter() {
+    _active = true;
+    _profiled = profiling;
+    // the depth counts the calls being made whether or not this one is the outermost
+    if ((_profiled && _probe.depth()++ == 0) || INSTRUMENT) _start = std::chrono::steady_clock::now();
+    if (trace::enabled && _probe.is_traced()) _event = _probe.label(), _trace_start = trace::now_us();
+}
+
+void ProbeScope::leave() {
+    bool outermost = _profiled && --_probe.depth() == 0;
+    if (outermost || INSTRUMENT) {
+        uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - _start).count();
+        _probe.record(ns);
+        if (outermost) _probe.add_outer(ns);
+    }
+    if (_event) trace::record(*_event, _probe.label(), _trace_start, trace::now_us() - _trace_start);
+}
+
+std::vector<const Probe*> probes() {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    return probe_registry();
+}
+
+template class BasicCounter<false>;
+template class BasicCounter<true>;
+template class BasicHistogram<false>;
+template class BasicHistogram<true>;
+
+void dump(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    os << std::left << std::setw(28) << "instrument" << std::right << std::setw(14) << "count" << std::endl;
+    for (auto&& ins : registry()) ins->print(os);
+    if (!INSTRUMENT) os << "(only the progress counters are compiled in: set INSTRUMENT in common.hpp for the others)" << std::endl;
+}
+
+void dump_json(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    os << "{\n  \"instrumented\": " << (INSTRUMENT ? "true" : "false") << ",\n  \"instruments\": [";
+    for (size_t i = 0; i < registry().size(); ++i) {
+        os << (i == 0 ? "\n    " : ",\n    ");
+        registry()[i]->print_json(os);
+    }
+    os << "\n  ]\n}" << std::endl;
+}
+
+void dump_json(const std::string& fname) {
+    std::ofstream ofs(fname);
+    if (!ofs) throw FileError("instrument::dump_json(): " + fname + ": could not open file");
+    dump_json(ofs);
+}
+
+}  // namespace instrument
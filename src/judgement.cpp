@@ -2,31 +2,32 @@
 
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "common.hpp"
 #include "context.hpp"
 #include "environment.hpp"
 #include "lambda.hpp"
 
-Judgement::Judgement(const std::shared_ptr<Environment>& env,
-                     const std::shared_ptr<Context>& context,
-                     const std::shared_ptr<Term>& proof,
-                     const std::shared_ptr<Term>& prop)
-    : _env(env), _context(context), _term(proof), _type(prop) {}
-Judgement::Judgement(const std::shared_ptr<Environment>& env,
-                     const std::shared_ptr<Context>& context,
-                     const std::shared_ptr<Term>& prop)
-    : _env(env), _context(context), _term(nullptr), _type(prop) {}
+Judgement::Judgement(PoolHandle<Environment> env,
+                     PoolHandle<Context> context,
+                     PoolHandle<Term> proof,
+                     PoolHandle<Term> prop)
+    : _env(std::move(env)), _context(std::move(context)), _term(std::move(proof)), _type(std::move(prop)) {}
+Judgement::Judgement(PoolHandle<Environment> env,
+                     PoolHandle<Context> context,
+                     PoolHandle<Term> prop)
+    : _env(std::move(env)), _context(std::move(context)), _term(nullptr), _type(std::move(prop)) {}
 std::string Judgement::string(bool inSingleLine, size_t indentSize) const {
     std::string res("");
     std::string indent_ex_1(indentSize, '\t');
     std::string indent_ex(inSingleLine ? 0 : indentSize, '\t'), indent_in(inSingleLine ? "" : "\t"), eol(inSingleLine ? " " : "\n");
     res += indent_ex_1 + "Judge<<" + eol;
-    res += _env->string(inSingleLine, inSingleLine ? 0 : indentSize + 1);
-    res += " ;" + eol + indent_ex + indent_in + _context->string();
+    res += env()->string(inSingleLine, inSingleLine ? 0 : indentSize + 1);
+    res += " ;" + eol + indent_ex + indent_in + context()->string();
     res += " " + TURNSTILE + " ";
-    res += (_term ? _term->string() : DOUBLE_BOTTOM);
-    res += " : " + _type->string();
+    res += (term() ? term()->string() : DOUBLE_BOTTOM);
+    res += " : " + type()->string();
     res += eol + indent_ex + ">>";
     return res;
 }
@@ -36,31 +37,26 @@ std::string Judgement::string_brief(bool inSingleLine, size_t indentSize) const
     std::string indent_ex_1(indentSize, '\t');
     std::string indent_ex(inSingleLine ? 0 : indentSize, '\t'), indent_in(inSingleLine ? "" : "\t"), eol(inSingleLine ? " " : "\n");
     res += indent_ex_1 + "Judge<<" + eol;
-    res += _env->string_brief(inSingleLine, inSingleLine ? 0 : indentSize + 1);
-    res += " ;" + eol + indent_ex + indent_in + _context->string();
+    res += env()->string_brief(inSingleLine, inSingleLine ? 0 : indentSize + 1);
+    res += " ;" + eol + indent_ex + indent_in + context()->string();
     res += " " + TURNSTILE + " ";
-    res += (_term ? _term->string() : DOUBLE_BOTTOM);
-    res += " : " + _type->string();
+    res += (term() ? term()->string() : DOUBLE_BOTTOM);
+    res += " : " + type()->string();
     res += eol + indent_ex + ">>";
     return res;
 }
 
 std::string Judgement::string_simple() const {
     std::string res("");
-    res += _env->string_simple();
-    res += " ; " + _context->string();
+    res += env()->string_simple();
+    res += " ; " + context()->string();
     res += " " + TURNSTILE + " ";
-    res += (_term ? _term->string() : DOUBLE_BOTTOM);
-    res += " : " + _type->string();
+    res += (term() ? term()->string() : DOUBLE_BOTTOM);
+    res += " : " + type()->string();
     return res;
 }
 
-const std::shared_ptr<Environment>& Judgement::env() const { return _env; }
-const std::shared_ptr<Context>& Judgement::context() const { return _context; }
-const std::shared_ptr<Term>& Judgement::term() const { return _term; }
-const std::shared_ptr<Term>& Judgement::type() const { return _type; }
-
-std::shared_ptr<Environment>& Judgement::env() { return _env; }
-std::shared_ptr<Context>& Judgement::context() { return _context; }
-std::shared_ptr<Term>& Judgement::term() { return _term; }
-std::shared_ptr<Term>& Judgement::type() { return _type; }
+const std::shared_ptr<Environment>& Judgement::env() const { return _env.ptr(); }
+const std::shared_ptr<Context>& Judgement::context() const { return _context.ptr(); }
+const std::shared_ptr<Term>& Judgement::term() const { return _term.ptr(); }
+const std::shared_ptr<Term>& Judgement::type() const { return _type.ptr(); }
@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cctype>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -9,6 +10,7 @@
 #include <string>
 
 #include "common.hpp"
+#include "instrument.hpp"
 #include "parser.hpp"
 
 /* [TODO]
@@ -154,19 +156,25 @@ bool is_free_var(const std::shared_ptr<Term>& term, const std::shared_ptr<Variab
     return var->has_name() && fv.find(var->name()) != fv.end();
 }
 
-int _fresh_var_id = 0;
+std::atomic<int> _fresh_var_id = 0;
 std::set<std::string> _char_vars_set;
 const std::string _preferred_names = "XYZWUVxyzwpqrst";
 
 const std::set<std::string>& char_vars_set() {
-    if (_char_vars_set.empty()) {
+    // filled once even if the first calls come from several threads (parse_defs_parallel())
+    static const bool filled = []() {
         for (char ch = 'A'; ch <= 'Z'; ++ch) _char_vars_set.insert({ch});
         for (char ch = 'a'; ch <= 'z'; ++ch) _char_vars_set.insert({ch});
-    }
+        return true;
+    }();
+    unused(filled);
     return _char_vars_set;
 }
 
+instrument::Counter fresh_vars("lambda.fresh_var");
+
 std::shared_ptr<Variable> get_fresh_var_depleted() {
+    ++fresh_vars;
     return variable("__" + std::to_string(_fresh_var_id++));
 }
 
@@ -178,8 +186,12 @@ std::shared_ptr<Variable> get_fresh_var(const std::shared_ptr<Term>& term) {
     // if (!univ.empty()) return variable(*univ.begin());
     // check_true_or_exit(false, "out of fresh variable",
     //                    __FILE__, __LINE__, __func__);
+    return get_fresh_var(free_var(term));
+}
+
+std::shared_ptr<Variable> get_fresh_var(const std::set<std::string>& used) {
     auto univ = char_vars_set();
-    set_minus_inplace(univ, free_var(term));
+    set_minus_inplace(univ, used);
     if (!univ.empty()) {
         for (auto&& ch : _preferred_names) {
             std::string cand(1, ch);
@@ -260,7 +272,10 @@ std::shared_ptr<Term> rename_var_short(std::shared_ptr<Term> term) {
     return nullptr;
 }
 
+instrument::Counter substitutions("lambda.substitute");
+
 std::shared_ptr<Term> substitute(const std::shared_ptr<Term>& term, const std::shared_ptr<Variable>& bind, const std::shared_ptr<Term>& expr) {
+    ++substitutions;
     if (!is_free_var(term, bind)) return term;
     switch (term->etype()) {
         case EpsilonType::Star:
@@ -395,7 +410,10 @@ std::shared_ptr<Constant> constant(const std::shared_ptr<Term>& t) {
     return std::dynamic_pointer_cast<Constant>(t);
 }
 
+instrument::Probe alpha_comp_probe("lambda.alpha_comp", "alpha_comp");
+
 bool alpha_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b) {
+    instrument::ProbeScope probe(alpha_comp_probe);
     if (flag_address_comp && a == b) return true;
     if (a->etype() != b->etype()) return false;
     switch (a->etype()) {
@@ -462,6 +480,7 @@ bool alpha_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b)
 }
 
 bool exact_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b) {
+    if (a == b) return true;
     if (a->etype() != b->etype()) return false;
     switch (a->etype()) {
         case EpsilonType::Star:
@@ -511,6 +530,52 @@ bool exact_comp(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b)
     }
 }
 
+static size_t hash_mix(size_t seed, size_t value) {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
+// walks the tree by reference: the casts of variable(), lambda() etc. would copy a shared_ptr per node
+size_t exact_hash(const Term& term, size_t depth) {
+    size_t h = static_cast<size_t>(term.etype());
+    if (depth-- == 0) return h;
+    switch (term.etype()) {
+        case EpsilonType::Star:
+        case EpsilonType::Square:
+            return h;
+        case EpsilonType::Variable: {
+            auto& v = static_cast<const Variable&>(term);
+            return hash_mix(h, v.has_name() ? std::hash<std::string>()(v.name()) : v.index());
+        }
+        case EpsilonType::AbstLambda: {
+            auto& t = static_cast<const AbstLambda&>(term);
+            h = hash_mix(h, exact_hash(*t.var().value(), depth));
+            h = hash_mix(h, exact_hash(*t.var().type(), depth));
+            return hash_mix(h, exact_hash(*t.expr(), depth));
+        }
+        case EpsilonType::AbstPi: {
+            auto& t = static_cast<const AbstPi&>(term);
+            h = hash_mix(h, exact_hash(*t.var().value(), depth));
+            h = hash_mix(h, exact_hash(*t.var().type(), depth));
+            return hash_mix(h, exact_hash(*t.expr(), depth));
+        }
+        case EpsilonType::Application: {
+            auto& t = static_cast<const Application&>(term);
+            return hash_mix(hash_mix(h, exact_hash(*t.M(), depth)), exact_hash(*t.N(), depth));
+        }
+        case EpsilonType::Constant: {
+            auto& t = static_cast<const Constant&>(term);
+            h = hash_mix(h, std::hash<std::string>()(t.name()));
+            for (auto&& arg : t.args()) h = hash_mix(h, exact_hash(*arg, depth));
+            return h;
+        }
+        default:
+            check_true_or_exit(
+                false,
+                "exact_hash(): unknown etype: " << to_string(term.etype()),
+                __FILE__, __LINE__, __func__);
+    }
+}
+
 std::pair<std::shared_ptr<Term>, std::shared_ptr<Term>> mismatch(const std::shared_ptr<Term>& a, const std::shared_ptr<Term>& b) {
     if (a->etype() != b->etype()) return {a, b};
     switch (a->etype()) {
@@ -562,7 +627,10 @@ std::shared_ptr<Term> beta_reduce(const std::shared_ptr<Application>& term) {
     return substitute(M->expr(), M->var().value(), N);
 }
 
+instrument::Probe beta_nf_probe("lambda.beta_nf", "beta_nf");
+
 std::shared_ptr<Term> beta_nf(const std::shared_ptr<Term>& term) {
+    instrument::ProbeScope probe(beta_nf_probe);
     switch (term->etype()) {
         case EpsilonType::Star:
         case EpsilonType::Square:
@@ -628,6 +696,13 @@ Variable::Variable(const std::string& name) : Term(EpsilonType::Variable), _inde
     }
 }
 std::shared_ptr<Variable> variable(const std::string& name) { return std::make_shared<Variable>(name); }
+bool is_variable_name(const std::string& name) {
+    if (name.size() == 0) return false;
+    for (unsigned char ch : name) {
+        if (!(std::isalnum(ch) || ch == '_')) return false;
+    }
+    return true;
+}
 std::string Variable::string() const { return name(); }
 const std::string& Variable::name() const { return _var_name; }
 // void Variable::change_name(const std::string& new_name) {
@@ -0,0 +1,125 @@
+#include "mapped_file.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <utility>
+
+#include "common.hpp"
+#include "scan.hpp"
+
+MappedFile::MappedFile(const std::string& fname) : _filename(fname) {
+    int fd = open(fname.c_str(), O_RDONLY);
+    if (fd < 0) throw FileError("MappedFile(): " + fname + ": file not found");
+    struct stat st;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        throw FileError("MappedFile(): " + fname + ": not a regular file");
+    }
+    _size = st.st_size;
+    if (_size > 0) {
+        void* addr = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr == MAP_FAILED) {
+            close(fd);
+            throw FileError("MappedFile(): " + fname + ": mmap failed (" + std::strerror(errno) + ")");
+        }
+        madvise(addr, _size, MADV_SEQUENTIAL);
+        _data = (const char*)addr;
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : _data(std::exchange(other._data, nullptr)),
+      _size(std::exchange(other._size, 0)),
+      _filename(std::move(other._filename)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        unmap();
+        _data = std::exchange(other._data, nullptr);
+        _size = std::exchange(other._size, 0);
+        _filename = std::move(other._filename);
+    }
+    return *this;
+}
+
+void MappedFile::unmap() {
+    if (_data) munmap((void*)_data, _size);
+    _data = nullptr;
+    _size = 0;
+}
+
+LineReader::LineReader() : _fd(STDIN_FILENO), _filename("stdin") {}
+
+LineReader::LineReader(const std::string& fname) : _filename(fname) {
+    struct stat st;
+    if (stat(fname.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+        _mapped = MappedFile(fname);
+        _is_mapped = true;
+        _end = _mapped.size();
+        return;
+    }
+    _fd = open(fname.c_str(), O_RDONLY);
+    if (_fd < 0) throw FileError("LineReader(): " + fname + ": file not found");
+    _owns_fd = true;
+}
+
+LineReader::~LineReader() {
+    if (_owns_fd) close(_fd);
+}
+
+// reads the next chunk into the buffer; returns false at the end of input
+bool LineReader::fill() {
+    constexpr size_t chunk_size = 1 << 16;
+    if (_begin > 0) {
+        std::memmove(_buf.data(), _buf.data() + _begin, _end - _begin);
+        _end -= _begin;
+        _begin = 0;
+    }
+    if (_buf.size() < _end + chunk_size) _buf.resize(_end + chunk_size);
+    ssize_t len;
+    do {
+        len = read(_fd, _buf.data() + _end, _buf.size() - _end);
+    } while (len < 0 && errno == EINTR);
+    if (len < 0) throw FileError("LineReader(): " + _filename + ": read failed (" + std::strerror(errno) + ")");
+    if (len == 0) return false;
+    _end += len;
+    return true;
+}
+
+bool LineReader::next(std::string_view& line) {
+    size_t scanned = _begin;
+    while (true) {
+        const char* base = _is_mapped ? _mapped.data() : _buf.data();
+        const char* nl = scan::find(base + scanned, base + _end, '\n');
+        if (nl < base + _end) {
+            size_t pos = nl - base;
+            line = std::string_view(base + _begin, pos - _begin);
+            _begin = pos + 1;
+            ++_lno;
+            return true;
+        }
+        if (!_is_mapped && !_eof) {
+            scanned = _end - _begin;  // offset after compaction in fill()
+            if (fill()) continue;
+            _eof = true;
+            base = _buf.data();
+        }
+        // the last line without a trailing newline
+        if (_begin >= _end) return false;
+        line = std::string_view(base + _begin, _end - _begin);
+        _begin = _end;
+        ++_lno;
+        return true;
+    }
+}
@@ -1,18 +1,25 @@
 #include "parser.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <deque>
 #include <functional>
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <set>
+#include <sstream>
 #include <stack>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "common.hpp"
 #include "context.hpp"
 #include "definition.hpp"
 #include "environment.hpp"
+#include "instrument.hpp"
+#include "scan.hpp"
 
 std::string to_string(const TokenType& t) {
     switch (t) {
@@ -105,7 +112,7 @@ std::string pos_info_str(const Token& t1, const Token& t2) {
         from = std::min(t1.pos(), t2.pos());
         to = std::max(t1.pos() + t1.len(), t2.pos() + t2.len());
         res += ":" + std::to_string(from + 1);
-        if (to - from > 1) res += "-" + std::to_string(std::min(to, t1.filedata()[t1.lno()].size()) + 1);
+        if (to - from > 1) res += "-" + std::to_string(std::min(to, t1.line().size()) + 1);
     } else {
         res += std::to_string(t1.lno() + 1);
         res += ":" + std::to_string(t1.pos() + 1);
@@ -128,110 +135,129 @@ std::ostream& operator<<(std::ostream& os, const Token& t) {
     return os << to_string(t);
 }
 
-std::vector<Token> tokenize(const FileData& lines) {
+namespace {
+
+// character classes of the tokenizer
+enum CharClass : uint8_t {
+    CharOther = 0,
+    CharAlpha = 1,
+    CharDigit = 2,
+    CharSpace = 4,  // ' ', '\t' (not '\r')
+    CharIdent = CharAlpha | CharDigit,
+};
+
+struct CharTable {
+    uint8_t cls[256];
+    TokenType sym[256];
+    CharTable() {
+        for (int ch = 0; ch < 256; ++ch) {
+            cls[ch] = CharOther;
+            if (('a' <= ch && ch <= 'z') || ('A' <= ch && ch <= 'Z')) cls[ch] = CharAlpha;
+            if ('0' <= ch && ch <= '9') cls[ch] = CharDigit;
+            if (ch == ' ' || ch == '\t') cls[ch] = CharSpace;
+            sym[ch] = sym2tokentype((char)ch);
+        }
+    }
+};
+
+const CharTable char_table;
+
+inline uint8_t char_class(char ch) { return char_table.cls[(unsigned char)ch]; }
+
+}  // namespace
+
+std::vector<Token> tokenize(SourceBuffer& src) {
     std::vector<Token> tokens;
-    // const std::string sym_const = "_-";
+    // a rough upper bound of the number of tokens, to avoid regrowing
+    tokens.reserve(src.text().size() / 4 + src.lines());
     bool comment = false;
-    for (size_t lno = 0; lno < lines.size(); ++lno) {
-        for (size_t pos = 0; pos < lines[lno].size();) {
-            char ch = lines[lno][pos];
+    for (size_t lno = 0; lno < src.lines(); ++lno) {
+        const std::string_view line = src.line(lno);
+        const char* const begin = line.data();
+        const char* const end = begin + line.size();
+        auto emit = [&](const char* p, size_t len, TokenType type, uint32_t id = Token::NoId) {
+            tokens.emplace_back(src, lno, p - begin, len, type, id);
+        };
+        auto next_is = [&](const char* p, char ch) { return p + 1 < end && p[1] == ch; };
+        for (const char* p = begin; p < end;) {
             if (comment) {
-                if (ch == '*' && pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '/') {
+                const char* star = scan::find(p, end, '*');
+                if (star == end) break;
+                p = star + 1;
+                if (p < end && *p == '/') {
                     comment = false;
-                    pos += 2;
-                    continue;
+                    ++p;
                 }
-                ++pos;
                 continue;
             }
-            if (ch == '/') {
-                if (pos + 1 < lines[lno].size()) {
-                    if (lines[lno][pos + 1] == '/') break;
-                    if (lines[lno][pos + 1] == '*') {
-                        comment = true;
-                        ++pos;
-                        continue;
-                    }
-                }
-            }
-            if (ch == ':') {
-                if (pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '=') {
-                    tokens.emplace_back(lines, lno, pos, 2, TokenType::DefinedBy);
-                    pos += 2;
-                    continue;
-                }
-            }
-            if (ch == '<') {
-                if (pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '-') {
-                    if (pos + 2 < lines[lno].size() && lines[lno][pos + 2] == '>') {
-                        tokens.emplace_back(lines, lno, pos, 3, TokenType::Leftrightarrow);
-                        pos += 3;
-                        continue;
-                    }
-                    tokens.emplace_back(lines, lno, pos, 2, TokenType::Leftarrow);
-                    pos += 2;
-                    continue;
-                }
-                if (pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '=') {
-                    if (pos + 2 < lines[lno].size() && lines[lno][pos + 2] == '>') {
-                        tokens.emplace_back(lines, lno, pos, 3, TokenType::Leftrightdoublearrow);
-                        pos += 3;
-                        continue;
-                    }
-                    tokens.emplace_back(lines, lno, pos, 2, TokenType::Leftdoublearrow);
-                    pos += 2;
-                    continue;
-                }
-            }
-            if (ch == '-') {
-                if (pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '>') {
-                    tokens.emplace_back(lines, lno, pos, 2, TokenType::Rightarrow);
-                    pos += 2;
-                    continue;
-                }
-            }
-            if (ch == '=') {
-                if (pos + 1 < lines[lno].size() && lines[lno][pos + 1] == '>') {
-                    tokens.emplace_back(lines, lno, pos, 2, TokenType::Rightdoublearrow);
-                    pos += 2;
-                    continue;
-                }
-            }
-            if (isalpha(ch)) {
+            char ch = *p;
+            uint8_t cls = char_class(ch);
+            if (cls & CharAlpha) {
                 // variable, name, def2, edef2, END
-                size_t eon = pos;
-                while (eon < lines[lno].size() && (isalnum(lines[lno][eon]) || lines[lno][eon] == '_')) ++eon;
-                std::string tokstr = lines[lno].substr(pos, eon - pos);
+                const char* q = p + 1;
+                while (q < end && ((char_class(*q) & CharIdent) || *q == '_')) ++q;
+                std::string_view str(p, q - p);
                 TokenType t;
-                if (tokstr == "END") t = TokenType::EndOfFile;
-                else if (tokstr == "edef2") t = TokenType::DefEnd;
-                else if (tokstr == "def2") t = TokenType::DefBegin;
-                else if (pos + 1 < eon) t = TokenType::String;
+                if (str == "END") t = TokenType::EndOfFile;
+                else if (str == "edef2") t = TokenType::DefEnd;
+                else if (str == "def2") t = TokenType::DefBegin;
+                else if (str.size() > 1) t = TokenType::String;
                 else t = TokenType::Character;
-                tokens.emplace_back(lines, lno, pos, eon - pos, t);
-                pos = eon;
+                emit(p, q - p, t, t == TokenType::String || t == TokenType::Character ? src.intern(str) : Token::NoId);
+                p = q;
                 continue;
             }
-            if (isdigit(ch)) {
-                size_t eod = pos;
-                while (eod < lines[lno].size() && isdigit(lines[lno][eod])) ++eod;
-                tokens.emplace_back(lines, lno, pos, eod - pos, TokenType::Number);
-                pos = eod;
+            if (cls & CharDigit) {
+                const char* q = p + 1;
+                while (q < end && (char_class(*q) & CharDigit)) ++q;
+                emit(p, q - p, TokenType::Number);
+                p = q;
                 continue;
             }
-            if (ch == ' ' || ch == '\t') {
-                size_t eos = pos;
-                while (eos < lines[lno].size() && (lines[lno][eos] == ' ' || lines[lno][eos] == '\t')) ++eos;
-                tokens.emplace_back(lines, lno, pos, eos - pos, TokenType::Spaces);
-                pos = eos;
+            if (cls & CharSpace) {
+                const char* q = scan::skip_blanks(p + 1, end);
+                emit(p, q - p, TokenType::Spaces);
+                p = q;
                 continue;
             }
-            tokens.emplace_back(lines, lno, pos, 1, sym2tokentype(ch));
+            switch (ch) {
+                case '/':
+                    if (next_is(p, '/')) p = end;
+                    else if (next_is(p, '*')) {
+                        comment = true;
+                        ++p;  // the '*' is scanned again, so "/*/" is a complete comment
+                    } else break;
+                    continue;
+                case ':':
+                    if (!next_is(p, '=')) break;
+                    emit(p, 2, TokenType::DefinedBy);
+                    p += 2;
+                    continue;
+                case '<':
+                    if (next_is(p, '-') || next_is(p, '=')) {
+                        bool is_double = p[1] == '=';
+                        if (next_is(p + 1, '>')) {
+                            emit(p, 3, is_double ? TokenType::Leftrightdoublearrow : TokenType::Leftrightarrow);
+                            p += 3;
+                        } else {
+                            emit(p, 2, is_double ? TokenType::Leftdoublearrow : TokenType::Leftarrow);
+                            p += 2;
+                        }
+                        continue;
+                    }
+                    break;
+                case '-':
+                case '=':
+                    if (!next_is(p, '>')) break;
+                    emit(p, 2, ch == '-' ? TokenType::Rightarrow : TokenType::Rightdoublearrow);
+                    p += 2;
+                    continue;
+            }
+            emit(p, 1, char_table.sym[(unsigned char)ch]);
             if (tokens.back().type() == TokenType::Unknown) throw TokenizeError("unknown token found", tokens.back());
-
-            ++pos;
+            ++p;
         }
-        tokens.emplace_back(lines, lno, TokenType::NewLine);
+        tokens.emplace_back(src, lno, TokenType::NewLine);
     }
     return tokens;
 }
@@ -377,7 +403,7 @@ class ParseStack {
     std::string excerpt(const std::vector<Token>& tokens) const {
         if (_token_begin < 0) return "(n/a)";
         std::string res;
-        for (int i = _token_begin; i < _token_end; ++i) res += tokens[i].string();
+        for (int i = _token_begin; i < _token_end; ++i) res += tokens[i].view();
         return res;
     }
     int begin() const { return _token_begin; }
@@ -395,7 +421,7 @@ class ParseStack {
     std::vector<std::shared_ptr<Term>> _terms;
 };
 
-std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens, size_t& idx, size_t end_of_token, bool exhaust_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions) {
+std::shared_ptr<ParseLambdaToken> parse_lambda_legacy(const std::vector<Token>& tokens, size_t& idx, size_t end_of_token, bool exhaust_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions) {
     const size_t pos_init = idx;  // for rollback use
 
     using stk_t = std::stack<ParseStack>;
@@ -427,13 +453,8 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
                 - return the last Term if any invalid token is found
     */
 
-    std::set<std::string> defined_names;
-    for (auto&& def : definitions) defined_names.insert(def->definiendum());
-    auto exists_cand_const = [&defined_names](const std::string& cname_part) {
-        auto itr = std::lower_bound(defined_names.begin(), defined_names.end(), cname_part);
-        if (itr == defined_names.end()) return false;
-        return std::mismatch(cname_part.begin(), cname_part.end(), itr->begin(), itr->end()).first == cname_part.end();
-        // return itr->starts_with(cname_part);
+    auto exists_cand_const = [&definitions](const std::string& cname_part) {
+        return definitions.has_prefix(cname_part);
     };
 
     std::stack<ParseType> atmosphere;
@@ -652,8 +673,10 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
         // find contractable series of tokens
         std::deque<ParseStack> stash;
 
-        auto load = [&stk, &stash](int cnt) {
+        auto load = [&stk, &stash, &tokens, &pos_init, &idx](int cnt) {
             while (cnt--) {
+                // a rule expecting more items than the stack has: the part read so far is not an expr
+                if (stk->empty()) throw ParseError("Could not obtain an expr by parsing this part", tokens[pos_init], tokens[idx]);
                 stash.push_front(stk->top());
                 stk->pop();
             }
@@ -759,6 +782,7 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
                     reduced = true;
                 }
             }
+            if (stash.empty()) return reduced;  // the top is not a term; the final check reports what is left
             if (stash.front().ptype() != ParseType::Term) {
                 throw ParseError(
                     "Could not reduce term-arrow sequence in parentheses to a single term",
@@ -777,11 +801,12 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
             return reduced;
         };
 
-        auto contract_top_term = [&abst_vars, &tokens, &stack_dump, &got_term](stk_pt stk, bool is_term_decided = false) -> bool {
+        auto contract_top_term = [&abst_vars, &tokens, &pos_init, &idx, &stack_dump, &got_term](stk_pt stk, bool is_term_decided = false) -> bool {
             bool reduced = false;
 
             // debug("contract_top_term(): " << fstr(is_term_decided) << ", stack = " << stack_dump(stk));
             if (is_term_decided) {
+                if (stk->empty()) throw ParseError("Could not obtain an expr by parsing this part", tokens[pos_init], tokens[idx]);
                 switch (stk->top().ptype()) {
                     case ParseType::Term:
                         break;
@@ -1023,6 +1048,13 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
                     // strip parentheses
                     stash.pop_front();
                     stash.pop_back();
+                    if (stash.empty()) {
+                        throw ParseError(
+                            "Could not reduce term-arrow sequence in parentheses to a single term",
+                            tokens[begin], tokens[end - 1],
+                            "Nothing is given in parentheses",
+                            tokens[begin], tokens[end - 1]);
+                    }
                     // eliminate arrows
                     elim_right_assoc(stash);
                     stash.front().begin() = begin;
@@ -1455,6 +1487,19 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
 
     // debug(fstr(stk->top().terms().size()));
 
+    if (stk->size() != 1) {
+        // the items under the top still wait for the rest of the expr (e.g. an unclosed parenthesis),
+        // so the term on the top is only a part of it
+        if (invalid_token_err) throw *invalid_token_err;
+        if (stk->empty()) throw ParseError("Could not obtain an expr by parsing this part", tokens[pos_init]);
+        int end = stk->top().end();
+        while (stk->size() > 2) stk->pop();
+        throw ParseError(
+            "Could not obtain an expr by parsing this part",
+            tokens[pos_init], tokens[std::max<int>(end, pos_init + 1) - 1],
+            "Not completed from here. Type: " + to_string(stk->top().ptype()),
+            tokens[stk->top().begin()], tokens[stk->top().end() - 1]);
+    }
     if (stk->top().terms().size() != 1) throw ParseError(
         "Could not obtain an expr by parsing this part",
         tokens[stk->top().begin()], tokens[stk->top().end() - 1]);
@@ -1463,17 +1508,340 @@ std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens,
     return std::make_shared<ParseLambdaToken>(tokens[stk->top().begin()], tokens[idx = stk->top().end() - 1], stk->top().terms()[0]);
 }
 
+namespace {
+
+// thrown by FastPathParser where the input leaves the part of the grammar it covers
+struct LeaveFastPath {};
+
+// -> binds tighter than =>, which binds tighter than <=>; all of them associate to the right
+// (the order in which elim_right_assoc() of the legacy parser reduces them)
+int binding_power(TokenType type) {
+    switch (type) {
+        case TokenType::Rightarrow: return 3;
+        case TokenType::Rightdoublearrow: return 2;
+        case TokenType::Leftrightdoublearrow: return 1;
+        default: return 0;
+    }
+}
+
+// fv_rhs: free variables of rhs
+std::shared_ptr<Term> arrow_term(TokenType op, const std::shared_ptr<Term>& lhs, const std::shared_ptr<Term>& rhs, const std::set<std::string>& fv_rhs) {
+    switch (op) {
+        case TokenType::Rightarrow: return std::make_shared<AbstPi>(get_fresh_var(fv_rhs), lhs, rhs);
+        case TokenType::Rightdoublearrow: return std::make_shared<Constant>("implies", std::vector<std::shared_ptr<Term>>{lhs, rhs});
+        default: return std::make_shared<Constant>("equiv", std::vector<std::shared_ptr<Term>>{lhs, rhs});
+    }
+}
+
+bool is_identifier_head(TokenType type) {
+    return type == TokenType::String || type == TokenType::Character || type == TokenType::Underscore;
+}
+
+bool is_identifier_tail(TokenType type) {
+    return is_identifier_head(type) || type == TokenType::Number || type == TokenType::Hyphen;
+}
+
+// tokens that end an expr at the top level (ParseType::Undefined, or a separator out of its place)
+bool is_terminator(TokenType type) {
+    switch (type) {
+        case TokenType::Colon:
+        case TokenType::Comma:
+        case TokenType::SquareBracketRight:
+        case TokenType::Unclassified:
+        case TokenType::Semicolon:
+        case TokenType::CurlyBracketLeft:
+        case TokenType::CurlyBracketRight:
+        case TokenType::Hash:
+        case TokenType::Verticalbar:
+        case TokenType::Leftarrow:
+        case TokenType::Leftrightarrow:
+        case TokenType::Leftdoublearrow:
+        case TokenType::DefinedBy:
+        case TokenType::DefBegin:
+        case TokenType::DefEnd:
+        case TokenType::EndOfFile:
+        case TokenType::Unknown:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// precedence climbing over the tokens of an expr, in time linear in its length
+// (terms are built by the constructors rather than appl(), pi(), ..., which copy their subterms)
+// it covers the inputs on which it agrees with parse_lambda_legacy() term for term and span for span,
+// including where the latter depends on spacing, and throws LeaveFastPath on anything else:
+//   - an identifier becomes a variable when a space or a closing token follows it,
+//     but one right before an arrow is an operand of the arrow even inside % or an abstraction body,
+//     so that is only taken where both readings agree
+//   - a period continues an identifier outside of abstractions and argument lists,
+//     and inside them only while the identifier is a prefix of a defined name
+class FastPathParser {
+  public:
+    FastPathParser(const std::vector<Token>& tokens, size_t end_of_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions)
+        : _tokens(tokens), _end(std::min(end_of_token, tokens.size())), _flag_context(flag_context), _definitions(definitions) {}
+
+    std::shared_ptr<ParseLambdaToken> parse(size_t& idx, bool exhaust_token) {
+        _pos = idx;
+        skip_space();
+        Parsed e = expr(PeriodMode::Name, 1, true);
+        skip_space();
+        TokenType next = peek();
+        if (next != TokenType::NewLine && (exhaust_token || !is_terminator(next))) throw LeaveFastPath();
+        idx = e.end - 1;
+        return std::make_shared<ParseLambdaToken>(_tokens[e.begin], _tokens[e.end - 1], e.term);
+    }
+
+  private:
+    // term read from tokens [begin, end)
+    struct Parsed {
+        std::shared_ptr<Term> term;
+        size_t begin, end;
+        // free variables of an arrow sequence, carried up the sequence so that each fresh variable
+        // for -> does not take a walk over the whole right hand side
+        std::shared_ptr<const std::set<std::string>> fv = nullptr;
+
+        const std::set<std::string>& free_vars() {
+            if (!fv) fv = std::make_shared<const std::set<std::string>>(free_var(term));
+            return *fv;
+        }
+    };
+    // a period after an identifier is always a part of it (Name),
+    // or only while the identifier is a prefix of a defined name (Prefix; in abstractions and argument lists)
+    enum class PeriodMode { Name, Prefix };
+
+    TokenType peek() const {
+        if (_pos >= _end) throw LeaveFastPath();
+        return _tokens[_pos].type();
+    }
+    void expect(TokenType type) {
+        if (peek() != type) throw LeaveFastPath();
+        ++_pos;
+    }
+    // spaces and line continuations
+    void skip_space() {
+        while (_pos < _end) {
+            if (_tokens[_pos].type() == TokenType::Spaces) {
+                ++_pos;
+                continue;
+            }
+            if (_tokens[_pos].type() != TokenType::Backslash) break;
+            size_t next = _pos + 1;
+            while (next < _end && _tokens[next].type() == TokenType::Spaces) ++next;
+            if (next >= _end || _tokens[next].type() != TokenType::NewLine) break;
+            _pos = next + 1;
+        }
+    }
+
+    bool is_defined(const std::string& name) const { return _definitions.lookup_index(name) >= 0; }
+    bool has_prefix(const std::string& prefix) const { return _definitions.has_prefix(prefix); }
+
+    // returns whether the name is still a prefix of a defined name
+    // (Identifier_Str rather than Varname_Incomplete of the legacy parser)
+    bool scan_identifier(PeriodMode mode, std::string& name) {
+        bool is_prefix = true;
+        name = _tokens[_pos++].view();
+        for (; _pos < _end; ++_pos) {
+            TokenType type = _tokens[_pos].type();
+            if (type == TokenType::Period) {
+                if (mode == PeriodMode::Prefix && !(is_prefix && has_prefix(name + "."))) break;
+            } else if (!is_identifier_tail(type)) break;
+            name += _tokens[_pos].view();
+            is_prefix = is_prefix && has_prefix(name);
+        }
+        return is_prefix;
+    }
+
+    // operand: the identifier is a whole operand of an arrow sequence (not inside % or an abstraction body)
+    // first: it is inside the first operand of the innermost arrow sequence
+    Parsed expr(PeriodMode mode, int min_bp, bool first) {
+        Parsed lhs = primary(mode, true, first);
+        while (true) {
+            size_t pos = _pos;
+            skip_space();
+            int bp = _pos < _end ? binding_power(_tokens[_pos].type()) : 0;
+            if (bp == 0 || bp < min_bp) {
+                _pos = pos;
+                return lhs;
+            }
+            TokenType op = _tokens[_pos++].type();
+            skip_space();
+            Parsed rhs = expr(mode, bp, false);
+            // the fresh variable of -> is not free in rhs, so it adds nothing to the free variables
+            auto fv = std::make_shared<const std::set<std::string>>(set_union(lhs.free_vars(), rhs.free_vars()));
+            lhs = {arrow_term(op, lhs.term, rhs.term, rhs.free_vars()), lhs.begin, rhs.end, fv};
+        }
+    }
+
+    Parsed primary(PeriodMode mode, bool operand, bool first) {
+        size_t begin = _pos;
+        switch (peek()) {
+            case TokenType::Asterisk:
+                ++_pos;
+                return {star, begin, _pos};
+            case TokenType::AtSign:
+                ++_pos;
+                return {sq, begin, _pos};
+            case TokenType::String:
+            case TokenType::Character:
+            case TokenType::Underscore:
+                return identifier(mode, operand, first);
+            case TokenType::Percent: {
+                ++_pos;
+                skip_space();
+                Parsed t1 = primary(mode, false, first);
+                skip_space();
+                Parsed t2 = primary(mode, false, first);
+                return {std::make_shared<Application>(t1.term, t2.term), begin, t2.end};
+            }
+            case TokenType::DollarSign:
+            case TokenType::QuestionMark:
+                return abstraction(mode, first);
+            case TokenType::ParenLeft: {
+                ++_pos;
+                skip_space();
+                Parsed e = expr(mode, 1, true);
+                skip_space();
+                expect(TokenType::ParenRight);
+                return {e.term, begin, _pos};
+            }
+            default:
+                throw LeaveFastPath();
+        }
+    }
+
+    Parsed identifier(PeriodMode mode, bool operand, bool first) {
+        size_t begin = _pos;
+        std::string name;
+        bool is_prefix = scan_identifier(mode, name);
+        size_t end = _pos;
+        if (_pos < _end && _tokens[_pos].type() == TokenType::SquareBracketLeft) return constant_term(name, begin);
+        if (is_defined(name)) throw LeaveFastPath();
+        Parsed res{variable(name), begin, end};
+        // a space makes a variable of it at once
+        if (is_prefix && _pos < _end && _tokens[_pos].type() == TokenType::Spaces) return res;
+        // otherwise the next token but spaces does
+        size_t next = _pos;
+        while (next < _end && _tokens[next].type() == TokenType::Spaces) ++next;
+        if (next >= _end) throw LeaveFastPath();
+        TokenType type = _tokens[next].type();
+        switch (type) {
+            case TokenType::ParenRight:
+            case TokenType::NewLine:
+                return res;
+            case TokenType::Period:
+                if (mode == PeriodMode::Name) throw LeaveFastPath();
+                [[fallthrough]];
+            case TokenType::Comma:
+            case TokenType::SquareBracketRight:
+                // these close the arrow sequence before % or an abstraction around the identifier
+                if (!operand && !first) throw LeaveFastPath();
+                return res;
+            case TokenType::Backslash:
+                if (!operand) throw LeaveFastPath();
+                return res;
+            default:
+                if (binding_power(type) > 0) {
+                    if (!operand) throw LeaveFastPath();
+                    return res;
+                }
+                if (!is_terminator(type)) throw LeaveFastPath();
+                return res;
+        }
+    }
+
+    Parsed abstraction(PeriodMode mode, bool first) {
+        size_t begin = _pos;
+        bool is_lambda = _tokens[_pos++].type() == TokenType::DollarSign;
+        // (spaces right after $ or ? change how the legacy parser reads periods afterwards)
+        if (!is_identifier_head(peek())) throw LeaveFastPath();
+        std::string name;
+        scan_identifier(PeriodMode::Name, name);
+        if (is_defined(name)) throw LeaveFastPath();
+        while (peek() == TokenType::Spaces) ++_pos;
+        expect(TokenType::Colon);
+        skip_space();
+        Parsed type = expr(PeriodMode::Prefix, 1, true);
+        skip_space();
+        expect(TokenType::Period);
+        skip_space();
+        Parsed body = primary(mode, false, first);
+        auto var = variable(name);
+        if (is_lambda) return {std::make_shared<AbstLambda>(var, type.term, body.term), begin, body.end};
+        return {std::make_shared<AbstPi>(var, type.term, body.term), begin, body.end};
+    }
+
+    Parsed constant_term(const std::string& name, size_t begin) {
+        int index = _definitions.lookup_index(name);
+        if (index < 0) throw LeaveFastPath();
+        ++_pos;  // '['
+        std::vector<std::shared_ptr<Term>> args;
+        skip_space();
+        if (peek() != TokenType::SquareBracketRight) {
+            while (true) {
+                skip_space();
+                if (peek() == TokenType::Plus) {
+                    ++_pos;
+                    for (auto&& tvs : _flag_context) {
+                        for (auto&& tv : *tvs) args.push_back(copy(tv.value()));
+                    }
+                } else {
+                    args.push_back(expr(PeriodMode::Prefix, 1, true).term);
+                }
+                skip_space();
+                if (peek() == TokenType::SquareBracketRight) break;
+                expect(TokenType::Comma);
+            }
+        }
+        ++_pos;  // ']'
+        if (args.size() != _definitions[index]->context()->size()) throw LeaveFastPath();
+        return {std::make_shared<Constant>(name, std::move(args)), begin, _pos};
+    }
+
+    const std::vector<Token>& _tokens;
+    const size_t _end;
+    const std::vector<std::shared_ptr<Context>>& _flag_context;
+    const Environment& _definitions;
+    size_t _pos = 0;
+};
+
+}  // namespace
+
+instrument::Counter fast_path_exprs("parser.fast_path");
+instrument::Counter fast_path_left("parser.fast_path.left");
+
+std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens, size_t& idx, size_t end_of_token, bool exhaust_token, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions) {
+    ++fast_path_exprs;
+    try {
+        return FastPathParser(tokens, end_of_token, flag_context, definitions).parse(idx, exhaust_token);
+    } catch (const LeaveFastPath&) {
+        ++fast_path_left;
+        // either accepted by the legacy parser or reported by it, as before
+        return parse_lambda_legacy(tokens, idx, end_of_token, exhaust_token, flag_context, definitions);
+    }
+}
+
 std::shared_ptr<ParseLambdaToken> parse_lambda(const std::vector<Token>& tokens, size_t& idx, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions) {
     return parse_lambda(tokens, idx, tokens.size(), false, flag_context, definitions);
 }
 
-std::vector<std::shared_ptr<FileData>> raw_string_fds;
+std::shared_ptr<Term> parse_lambda(SourceBuffer& src, const Environment& definitions) {
+    size_t idx = 0;
+    std::vector<std::shared_ptr<Context>> fc;
+    auto tokens = tokenize(src);
+    return parse_lambda(tokens, idx, tokens.size(), true, fc, definitions)->term();
+}
+
+std::vector<std::shared_ptr<SourceBuffer>> raw_string_srcs;
+
+size_t raw_string_sources() { return raw_string_srcs.size(); }
 
 std::shared_ptr<Term> parse_lambda(const std::string& str, const std::vector<std::shared_ptr<Context>>& flag_context, const Environment& definitions) {
     size_t idx = 0;
-    std::shared_ptr<FileData> fdp = std::make_shared<FileData>(FileData({str}, "[from raw string]"));
-    raw_string_fds.push_back(fdp);
-    auto tokens = tokenize(*fdp);
+    std::istringstream iss(str);
+    auto src = std::make_shared<SourceBuffer>(iss, "[from raw string]");
+    raw_string_srcs.push_back(src);
+    auto tokens = tokenize(*src);
     return parse_lambda(tokens, idx, tokens.size(), true, flag_context, definitions)->term();
 }
 std::shared_ptr<Term> parse_lambda(const std::string& str, const Environment& definitions) {
@@ -1485,8 +1853,11 @@ std::shared_ptr<Term> parse_lambda(const std::string& str) {
     return parse_lambda(str, env);
 }
 
-Environment parse_defs(const std::vector<Token>& tokens) {
-    Environment env;
+namespace {
+
+// state of parse_defs() between two tokens, so that reading can stop at any token and resume later
+// (or on a copy, which is how parse_defs_parallel() hands def2 blocks to other threads)
+struct DefsParser {
     // state variables
     bool eof = false;
     int in_def = -1;     // def2 - edef2
@@ -1526,6 +1897,33 @@ Environment parse_defs(const std::vector<Token>& tokens) {
 
     std::vector<std::shared_ptr<Context>> flag_context;
     size_t flag_line_num = 0;
+    bool quiet = false;  // no dump on stderr before an error
+
+    // reads tokens[begin, end) into env and returns the index it stopped at
+    // (end, unless an expr or a name runs over it, or the end of file is reached)
+    size_t run(const std::vector<Token>& tokens, size_t begin, size_t end, ParseLambdaFunc parse_expr, Environment& env);
+
+    // where a def2 block can be read on its own: outside any definition or expr
+    bool between_defs() const {
+        return in_def < 0 && cont_line < 0 && !read_lambda && temp_vars.empty() &&
+               !read_def_num && !read_def_context && !read_def_name && !read_def_term && !read_def_type && !read_def_end;
+    }
+    // the state right after a well-formed def2 block (whose lines have reset the flags)
+    bool settled() const {
+        return between_defs() && !eof && flag_line_num == 0 && flag_context.empty() && vbar_head_of_line &&
+               read_flag_cname && !read_flag_context && !read_flag_context_type && !read_flag_context_end &&
+               !read_flag_defby && !read_flag_stmt_term && !read_flag_stmt_col && !read_flag_stmt_type;
+    }
+    void settle() {
+        flag_context.clear();
+        flag_line_num = 0;
+        vbar_head_of_line = read_flag_cname = true;
+        read_flag_context = read_flag_context_type = read_flag_context_end = false;
+        read_flag_defby = read_flag_stmt_term = read_flag_stmt_col = read_flag_stmt_type = false;
+    }
+};
+
+size_t DefsParser::run(const std::vector<Token>& tokens, size_t begin, size_t end, ParseLambdaFunc parse_expr, Environment& env) {
 
     auto def_str = [&]() {
         std::string res("");
@@ -1560,7 +1958,8 @@ Environment parse_defs(const std::vector<Token>& tokens) {
     };
     unused(flg_str);
 
-    for (size_t idx = 0; !eof && idx < tokens.size(); ++idx) {
+    size_t idx = begin;
+    for (; !eof && idx < end; ++idx) {
         // if (DEBUG_CERR) std::cerr << "[debug; parse loop] flag[def]: " << def_str() << ", token: " << tokens[idx] << std::endl;
         if (DEBUG_CERR) {
             std::cerr << "[debug; parse loop] flag[def]: " << def_str() << ", flag[flg]: " << flg_str() << ", token: " << tokens[idx] << "\t";  // << (tokens[idx].type() == TokenType::NewLine ? "<NL>" : tokens[idx].string()) << "\"\t";
@@ -1592,7 +1991,7 @@ Environment parse_defs(const std::vector<Token>& tokens) {
                     size_t idx0 = idx;
                     try {
                         // expr = parse_lambda_old(tokens, idx, std::make_shared<std::vector<std::shared_ptr<Context>>>(flag_context));
-                        expr = parse_lambda(tokens, idx, flag_context, env);
+                        expr = parse_expr(tokens, idx, tokens.size(), false, flag_context, env);
                     } catch (const ExprError& e) {
                         ParseError err("failed to parse a lambda expression", tokens[idx0]);
                         err.bind(e);
@@ -1787,12 +2186,12 @@ Environment parse_defs(const std::vector<Token>& tokens) {
             case TokenType::String: {
                 if (read_def_name || read_flag_cname) {
                     if (flag_line_num < flag_context.size()) flag_context.resize(flag_line_num);
-                    cname = t.string();
+                    cname = t.view();
                     bool name_confirmed = false;
                     while (tokens[idx + 1].type() != TokenType::NewLine && tokens[idx + 1].type() != TokenType::DefinedBy) {
                         ++idx;
                         if (tokens[idx].type() == TokenType::Spaces) name_confirmed = true;
-                        if (!name_confirmed) cname += tokens[idx].string();
+                        if (!name_confirmed) cname += tokens[idx].view();
                     }
                 }
                 if (read_def_name) {
@@ -1856,14 +2255,16 @@ Environment parse_defs(const std::vector<Token>& tokens) {
                 if (!vbar_head_of_line) throw ParseError("vertical bar '|' should be placed at the head of line", t);
                 ++flag_line_num;
                 if (flag_context.size() < flag_line_num || !flag_context[flag_line_num - 1]) {
-                    std::cerr << "flag context dump (size: " << flag_context.size() << "): ";
-                    for (auto&& c : flag_context) {
-                        std::cerr << "[";
-                        if (c) std::cerr << c;
-                        else std::cerr << "NUL";
-                        std::cerr << "], ";
+                    if (!quiet) {
+                        std::cerr << "flag context dump (size: " << flag_context.size() << "): ";
+                        for (auto&& c : flag_context) {
+                            std::cerr << "[";
+                            if (c) std::cerr << c;
+                            else std::cerr << "NUL";
+                            std::cerr << "], ";
+                        }
+                        std::cerr << std::endl;
                     }
-                    std::cerr << std::endl;
                     throw ParseError("context of " + std::to_string(flag_line_num) + "-th flag is undefined", t);
                 }
                 continue;
@@ -1891,5 +2292,148 @@ Environment parse_defs(const std::vector<Token>& tokens) {
                 throw ParseError("not implemented in parse_defs() (token = " + to_string(t) + ")", t);
         }
     }
+    return idx;
+}
+
+// name and size of context of the def2 block at tokens[idx], read as parse_defs() does if every item is on a line of its own
+// (the number, the variables and their types, the name, ...); end is set to one past its edef2.
+// false if the block does not look like that, in which case it is left to the sequential reading.
+bool skim_def_block(const std::vector<Token>& tokens, size_t idx, size_t& end, std::string& name, size_t& n) {
+    std::vector<size_t> heads;  // first token of each nonblank line
+    bool head_of_line = true;
+    size_t i = idx + 1;
+    for (; i < tokens.size() && tokens[i].type() != TokenType::DefEnd; ++i) {
+        switch (tokens[i].type()) {
+            case TokenType::DefBegin:
+            case TokenType::EndOfFile:
+            case TokenType::Verticalbar:
+                return false;
+            case TokenType::NewLine:
+                head_of_line = true;
+                break;
+            case TokenType::Spaces:
+                break;
+            case TokenType::Backslash:
+                if (i + 1 < tokens.size() && tokens[i + 1].type() == TokenType::NewLine) {
+                    ++i;
+                    break;
+                }
+                [[fallthrough]];
+            default:
+                if (head_of_line) heads.push_back(i);
+                head_of_line = false;
+        }
+    }
+    if (i == tokens.size() || heads.empty()) return false;
+    auto& num = tokens[heads[0]];
+    if (num.type() != TokenType::Number || num.view().size() > 6) return false;
+    n = std::stoul(num.string());
+    if (heads.size() < 2 * n + 2) return false;
+    size_t j = heads[2 * n + 1];
+    if (tokens[j].type() != TokenType::String && tokens[j].type() != TokenType::Character) return false;
+    // as the name is read in DefsParser::run()
+    name = tokens[j].view();
+    for (bool name_confirmed = false; tokens[j + 1].type() != TokenType::NewLine && tokens[j + 1].type() != TokenType::DefinedBy;) {
+        ++j;
+        if (tokens[j].type() == TokenType::Spaces) name_confirmed = true;
+        if (!name_confirmed) name += tokens[j].view();
+    }
+    end = i + 1;
+    return true;
+}
+
+// stands for a definition in the name table until its block is read
+std::shared_ptr<Definition> name_only_def(const std::string& name, size_t n) {
+    auto context = std::make_shared<Context>();
+    for (size_t k = 0; k < n; ++k) context->emplace_back(variable("_"), star);
+    return std::make_shared<Definition>(context, name, star);
+}
+
+}  // namespace
+
+Environment parse_defs(const std::vector<Token>& tokens, ParseLambdaFunc parse_expr) {
+    Environment env;
+    DefsParser().run(tokens, 0, tokens.size(), parse_expr, env);
     return env;
 }
+
+Environment parse_defs_parallel(const std::vector<Token>& tokens, size_t threads, ParseLambdaFunc parse_expr) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads <= 1 || DEBUG_CERR) return parse_defs(tokens, parse_expr);
+
+    struct Block {
+        size_t begin, end;  // def2, one past edef2
+        size_t pos;         // in the name table
+        DefsParser state;   // at def2
+    };
+    std::vector<Block> blocks;
+    Environment table;  // definitions read in phase 1 and name_only_def() of the blocks
+    int fresh_var_id = _fresh_var_id;
+
+    try {
+        // phase 1: read everything but the def2 blocks, which only leave their names (and flag-block scopes are kept in order)
+        DefsParser p;
+        p.quiet = true;
+        size_t idx = 0, from = 0;
+        while (!p.eof && idx < tokens.size()) {
+            size_t next = std::max(idx, from);
+            while (next < tokens.size() && tokens[next].type() != TokenType::DefBegin) ++next;
+            idx = p.run(tokens, idx, next, parse_expr, table);
+            if (p.eof || idx != next || idx == tokens.size()) continue;
+            std::string name;
+            size_t end, n;
+            if (p.between_defs() && skim_def_block(tokens, next, end, name, n)) {
+                blocks.push_back({next, end, table.size(), p});
+                table.push_back(name_only_def(name, n));
+                p.settle();
+                idx = from = end;
+            } else {
+                from = next + 1;  // read here with the rest
+            }
+        }
+    } catch (...) {
+        return parse_defs(tokens, parse_expr);
+    }
+    if (blocks.empty()) return table;
+
+    // phase 2: each thread reads a run of blocks, seeing the table up to each of them
+    std::vector<std::shared_ptr<Definition>> results(blocks.size());
+    std::atomic<bool> failed = false;
+    threads = std::min(threads, blocks.size());
+    std::vector<std::thread> workers;
+    for (size_t w = 0; w < threads; ++w) {
+        workers.emplace_back([&, w]() {
+            size_t first = blocks.size() * w / threads, last = blocks.size() * (w + 1) / threads;
+            if (first == last) return;
+            Environment env;  // appended to as parse_defs() does, so that lookups behave the same
+            for (size_t b = first; b < last && !failed; ++b) {
+                auto& block = blocks[b];
+                for (size_t i = env.size(); i < block.pos; ++i) env.push_back(table[i]);
+                try {
+                    auto state = block.state;
+                    size_t stop = state.run(tokens, block.begin, block.end, parse_expr, env);
+                    auto& expected = table[block.pos];
+                    if (stop != block.end || !state.settled() || env.size() != block.pos + 1 ||
+                        env.back()->definiendum() != expected->definiendum() ||
+                        env.back()->context()->size() != expected->context()->size()) {
+                        failed = true;
+                    } else {
+                        results[b] = env.back();
+                    }
+                } catch (...) {
+                    failed = true;
+                }
+            }
+        });
+    }
+    for (auto&& th : workers) th.join();
+
+    // any error (or a block read otherwise than skimmed) is left to the sequential reading, which reports it as always.
+    // so is running out of fresh variables, since "__n" depends on the order of reading.
+    if (failed || _fresh_var_id != fresh_var_id) {
+        _fresh_var_id = fresh_var_id;
+        return parse_defs(tokens, parse_expr);
+    }
+    for (size_t b = 0; b < blocks.size(); ++b) table[blocks[b].pos] = results[b];
+    return table;
+}
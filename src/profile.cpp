@@ -0,0 +1,63 @@
+#include "profile.hpp"
+
+#include <iomanip>
+
+#include "inference.hpp"
+#include "instrument.hpp"
+
+void RuleProfile::record(RuleType type, size_t lno, uint64_t ns) {
+    auto& stat = _rules[(size_t)type];
+    ++stat.count;
+    stat.total_ns += ns;
+    if (ns > stat.max_ns) stat.max_ns = ns, stat.max_lno = lno;
+}
+
+void RuleProfile::print(std::ostream& os) const {
+    auto ms = [](uint64_t ns) { return ns / 1e6; };
+    os << std::left << std::setw(16) << "rule" << std::right << std::setw(12) << "count" << std::setw(14) << "total ms"
+       << std::setw(12) << "avg us" << std::setw(12) << "max us" << std::setw(14) << "slowest line" << std::endl;
+    uint64_t count = 0, total = 0;
+    os << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < _rules.size(); ++i) {
+        const auto& stat = _rules[i];
+        if (stat.count == 0) continue;
+        os << std::left << std::setw(16) << to_string((RuleType)i) << std::right << std::setw(12) << stat.count
+           << std::setw(14) << ms(stat.total_ns) << std::setw(12) << stat.total_ns / 1e3 / stat.count
+           << std::setw(12) << stat.max_ns / 1e3 << std::setw(14) << stat.max_lno << std::endl;
+        count += stat.count;
+        total += stat.total_ns;
+    }
+    os << std::left << std::setw(16) << "(all rules)" << std::right << std::setw(12) << count << std::setw(14) << ms(total) << std::endl;
+
+    os << std::endl
+       << std::left << std::setw(16) << "probe" << std::right << std::setw(12) << "calls" << std::setw(14) << "total ms"
+       << std::setw(12) << "avg us" << std::endl;
+    for (auto&& probe : instrument::probes()) {
+        uint64_t calls = probe->outer_calls(), ns = probe->outer_ns();
+        if (calls == 0) continue;
+        os << std::left << std::setw(16) << probe->label() << std::right << std::setw(12) << calls
+           << std::setw(14) << ms(ns) << std::setw(12) << ns / 1e3 / calls << std::endl;
+    }
+    os << "(probes are timed at their outermost calls, and include the probes they call)" << std::endl;
+}
+
+void RuleProfile::write_json(std::ostream& os) const {
+    os << "{\n  \"rules\": [";
+    bool first = true;
+    for (size_t i = 0; i < _rules.size(); ++i) {
+        const auto& stat = _rules[i];
+        if (stat.count == 0) continue;
+        os << (first ? "\n" : ",\n") << "    {\"rule\": \"" << to_string((RuleType)i) << "\", \"count\": " << stat.count
+           << ", \"total_ns\": " << stat.total_ns << ", \"max_ns\": " << stat.max_ns << ", \"max_line\": " << stat.max_lno << "}";
+        first = false;
+    }
+    os << "\n  ],\n  \"probes\": [";
+    first = true;
+    for (auto&& probe : instrument::probes()) {
+        if (probe->outer_calls() == 0) continue;
+        os << (first ? "\n" : ",\n") << "    {\"name\": \"" << probe->label() << "\", \"calls\": " << probe->outer_calls()
+           << ", \"total_ns\": " << probe->outer_ns() << "}";
+        first = false;
+    }
+    os << "\n  ]\n}" << std::endl;
+}
@@ -0,0 +1,110 @@
+#include "progress.hpp"
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+bool ProgressReporter::parse_mode(const std::string& str, Mode& mode) {
+    if (str == "auto") mode = Mode::Auto;
+    else if (str == "tty") mode = Mode::Tty;
+    else if (str == "json") mode = Mode::Json;
+    else if (str == "off") mode = Mode::Off;
+    else return false;
+    return true;
+}
+
+ProgressReporter::ProgressReporter(Mode mode, const std::string& label, const std::string& unit, const std::function<Sample()>& sampler,
+                                   std::chrono::milliseconds interval)
+    : _mode(mode), _label(label), _unit(unit), _sampler(sampler), _interval(interval) {
+    if (_mode == Mode::Auto) _mode = isatty(fileno(stderr)) ? Mode::Tty : Mode::Off;
+}
+
+ProgressReporter::~ProgressReporter() { stop(); }
+
+void ProgressReporter::start() {
+    if (_mode == Mode::Off || active()) return;
+    _stopping = false;
+    _begin = _last_tick = std::chrono::steady_clock::now();
+    _last_done = 0;
+    _lines = _width = 0;
+    _thread = std::thread(&ProgressReporter::run, this);
+}
+
+void ProgressReporter::stop() {
+    if (!active()) return;
+    {
+        std::lock_guard<std::mutex> lock(_mtx);
+        _stopping = true;
+    }
+    _cv.notify_all();
+    _thread.join();
+}
+
+void ProgressReporter::run() {
+    std::unique_lock<std::mutex> lock(_mtx);
+    while (!_cv.wait_for(lock, _interval, [this] { return _stopping; })) draw(_sampler(), false);
+    // the scheduler gets the final counts; a terminal keeps the last drawing
+    if (_mode == Mode::Json) draw(_sampler(), true);
+}
+
+void ProgressReporter::draw(const Sample& sample, bool finished) {
+    auto now = std::chrono::steady_clock::now();
+    double secs = std::chrono::duration<double>(now - _begin).count();
+    double tick = std::chrono::duration<double>(now - _last_tick).count();
+    double rate = tick > 0 && sample.done >= _last_done ? (sample.done - _last_done) / tick : 0;
+    _last_tick = now;
+    _last_done = sample.done;
+
+    std::stringstream ss;
+    if (_mode == Mode::Json) {
+        auto put_string = [&ss](const std::string& str) {
+            ss << '"';
+            for (char ch : str) {
+                if (ch == '"' || ch == '\\') ss << '\\' << ch;
+                else if ((unsigned char)ch < 0x20) ss << ' ';
+                else ss << ch;
+            }
+            ss << '"';
+        };
+        ss << std::fixed << std::setprecision(3) << "{\"elapsed_sec\": " << secs << ", \"done\": " << sample.done << ", \"unit\": ";
+        put_string(_unit);
+        if (sample.total > 0) ss << ", \"total\": " << sample.total;
+        ss << ", \"per_sec\": " << std::setprecision(1) << rate;
+        for (auto&& [name, value] : sample.values) {
+            ss << ", ";
+            put_string(name);
+            ss << ": " << value;
+        }
+        ss << ", \"status\": ";
+        put_string(sample.status);
+        if (finished) ss << ", \"finished\": true";
+        ss << "}\n";
+        std::fputs(ss.str().c_str(), _out);
+        std::fflush(_out);
+        return;
+    }
+
+    std::vector<std::string> lines;
+    ss << "[" << (size_t)secs << " secs] " << _label << ": " << sample.done;
+    if (sample.total > 0) ss << " / " << sample.total;
+    ss << " (+" << (uint64_t)rate << " " << _unit << "/sec";
+    for (auto&& [name, value] : sample.values) ss << ", " << name << ": " << value;
+    ss << ")";
+    lines.push_back(ss.str());
+    lines.push_back("processing: " + sample.status);
+    for (auto&& note : sample.notes) lines.push_back(note);
+
+    std::string text;
+    // back to the first line of the last drawing
+    for (size_t i = 0; i < _lines; ++i) text += "\033[F";
+    text += '\r';
+    for (auto&& line : lines) {
+        if (line.size() > _width) _width = line.size();
+        text += line + std::string(_width - line.size(), ' ') + '\n';
+    }
+    _lines = lines.size();
+    std::cerr << text << std::flush;
+}
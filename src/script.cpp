@@ -0,0 +1,351 @@
+#include "script.hpp"
+
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "common.hpp"
+#include "inference.hpp"
+
+std::string ScriptRecord::string(size_t lno) const {
+    std::string res = std::to_string(lno) + " " + to_string(_rtype);
+    switch (_rtype) {
+        case RuleType::Inst:
+            res += " " + std::to_string(_refs[0]) + " " + std::to_string(_refs.size() - 1);
+            for (size_t i = 1; i < _refs.size(); ++i) res += " " + std::to_string(_refs[i]);
+            res += " " + std::to_string(_arg);
+            return res;
+        case RuleType::Sp:
+            return res + " " + std::to_string(_refs[0]) + " " + std::to_string(_arg);
+        default:
+            for (auto&& ref : _refs) res += " " + std::to_string(ref);
+            if (_name.size() > 0) res += " " + _name;
+            return res;
+    }
+}
+
+uint64_t ScriptRecord::hash() const {
+    uint64_t h = 14695981039346656037ULL;
+    auto feed = [&h](uint64_t x) {
+        for (int k = 0; k < 8; ++k, x >>= 8) {
+            h ^= x & 0xff;
+            h *= 1099511628211ULL;
+        }
+    };
+    feed((uint64_t)_rtype);
+    feed(_refs.size());
+    for (auto&& ref : _refs) feed(ref);
+    feed(_arg);
+    feed(_name.size());
+    for (auto&& ch : _name) feed((unsigned char)ch);
+    return h;
+}
+
+namespace {
+
+inline bool is_space(char ch) { return ch == ' ' || ('\t' <= ch && ch <= '\r'); }
+
+// whitespace-separated token scanner over a single script line
+class LineScanner {
+  public:
+    LineScanner(std::string_view line) : _ptr(line.data()), _end(line.data() + line.size()) {}
+
+    // fails unless the whole token is a number of type T
+    template <class T>
+    bool read_int(T& x) {
+        skip_space();
+        auto [ptr, ec] = std::from_chars(_ptr, _end, x);
+        if (ec != std::errc() || (ptr != _end && !is_space(*ptr))) return false;
+        _ptr = ptr;
+        return true;
+    }
+    std::string_view read_word() {
+        skip_space();
+        const char* begin = _ptr;
+        while (_ptr != _end && !is_space(*_ptr)) ++_ptr;
+        return std::string_view(begin, _ptr - begin);
+    }
+
+  private:
+    void skip_space() {
+        while (_ptr != _end && is_space(*_ptr)) ++_ptr;
+    }
+    const char* _ptr;
+    const char* _end;
+};
+
+// dispatches on the length and the first characters, then confirms the whole word
+bool decode_opcode(std::string_view op, RuleType& rtype) {
+    auto match = [&](const char* word, RuleType type) {
+        if (std::memcmp(op.data(), word, op.size()) != 0) return false;
+        rtype = type;
+        return true;
+    };
+    switch (op.size()) {
+        case 2:
+            if (op[1] != 'p') return false;
+            switch (op[0]) {
+                case 'c': return match("cp", RuleType::Cp);
+                case 's': return match("sp", RuleType::Sp);
+                case 't': return match("tp", RuleType::Tp);
+            }
+            return false;
+        case 3:
+            switch (op[0]) {
+                case 'v': return match("var", RuleType::Var);
+                case 'd': return match("def", RuleType::Def);
+            }
+            return false;
+        case 4:
+            switch (op[0]) {
+                case 'a': return op[1] == 'p' ? match("appl", RuleType::Appl) : match("abst", RuleType::Abst);
+                case 'c': return match("conv", RuleType::Conv);
+                case 'f': return match("form", RuleType::Form);
+                case 'i': return match("inst", RuleType::Inst);
+                case 's': return match("sort", RuleType::Sort);
+                case 'w': return match("weak", RuleType::Weak);
+            }
+            return false;
+        case 5:
+            return match("defpr", RuleType::Defpr);
+    }
+    return false;
+}
+
+}  // namespace
+
+ScriptLineStatus parse_script_line(std::string_view line, size_t i, ScriptRecord& rec, std::string& errmsg) {
+    LineScanner sc(line);
+    long long lno = 0;
+    sc.read_int(lno);
+    if (lno == -1) return ScriptLineStatus::End;
+
+    auto op = sc.read_word();
+    RuleType rtype;
+    if (!decode_opcode(op, rtype)) {
+        errmsg = "not implemented (token: " + std::string(op) + ")";
+        return ScriptLineStatus::Error;
+    }
+    rec.clear(rtype);
+
+    auto line_error = [&](const char* what) {
+        errmsg = std::string(op) + ": " + what + " (line " + std::to_string(i + 1) + ")";
+        return ScriptLineStatus::Error;
+    };
+    // judgements referred to must be derived on earlier lines
+    bool out_of_range = false;
+    auto read_ref = [&]() {
+        size_t ref;
+        if (!sc.read_int(ref)) return false;
+        if (ref >= i) return !(out_of_range = true);
+        rec.refs().push_back(ref);
+        return true;
+    };
+    auto read_name = [&]() {
+        auto name = sc.read_word();
+        rec.name().assign(name.data(), name.size());
+        return name.size() > 0;
+    };
+
+    bool ok = true;
+    switch (rtype) {
+        case RuleType::Sort:
+            break;
+        case RuleType::Var:
+            ok = read_ref() && read_name();
+            break;
+        case RuleType::Weak:
+        case RuleType::Def:
+        case RuleType::Defpr:
+            ok = read_ref() && read_ref() && read_name();
+            break;
+        case RuleType::Form:
+        case RuleType::Appl:
+        case RuleType::Abst:
+        case RuleType::Conv:
+            ok = read_ref() && read_ref();
+            break;
+        case RuleType::Inst: {
+            size_t n;
+            ok = read_ref() && sc.read_int(n);
+            for (size_t k = 0; ok && k < n; ++k) ok = read_ref();
+            ok = ok && sc.read_int(rec.arg());
+            break;
+        }
+        case RuleType::Cp:
+        case RuleType::Tp:
+            ok = read_ref();
+            break;
+        case RuleType::Sp:
+            ok = read_ref() && sc.read_int(rec.arg());
+            break;
+    }
+    if (out_of_range) return line_error("reference to a later judgement");
+    if (!ok) return line_error("wrong format");
+    return ScriptLineStatus::Rule;
+}
+
+std::vector<size_t> script_last_use(const std::function<bool(ScriptRecord&)>& next) {
+    std::vector<size_t> last_use;
+    ScriptRecord rec;
+    while (next(rec)) {
+        size_t lno = last_use.size();
+        for (auto&& ref : rec.refs()) {
+            if (ref < lno) last_use[ref] = lno;
+        }
+        last_use.push_back(lno);
+    }
+    return last_use;
+}
+
+bool is_binary_script(const std::string& head) {
+    return head.compare(0, std::strlen(SCRIPT_BINARY_MAGIC), SCRIPT_BINARY_MAGIC) == 0;
+}
+
+ScriptBinaryWriter::ScriptBinaryWriter(std::ostream& os, size_t bufsize) : _os(os), _bufsize(bufsize) {
+    _buf.put_bytes(SCRIPT_BINARY_MAGIC, std::strlen(SCRIPT_BINARY_MAGIC));
+    _buf.put_varint(SCRIPT_BINARY_VERSION);
+}
+
+void ScriptBinaryWriter::write(const ScriptRecord& rec) {
+    auto put_ref = [&](size_t ref) { _buf.put_svarint((int64_t)_lno - (int64_t)ref); };
+    auto put_name = [&](const std::string& name) {
+        auto itr = _name_index.find(name);
+        if (itr != _name_index.end()) {
+            _buf.put_varint(itr->second);
+            return;
+        }
+        // a new name is defined where it is first used
+        _buf.put_varint(_name_index.size());
+        _buf.put_string(name);
+        _name_index.emplace(name, _name_index.size());
+    };
+    _buf.put_varint((uint64_t)rec.rtype());
+    switch (rec.rtype()) {
+        case RuleType::Sort:
+            break;
+        case RuleType::Var:
+            put_ref(rec.refs()[0]);
+            put_name(rec.name());
+            break;
+        case RuleType::Weak:
+        case RuleType::Def:
+        case RuleType::Defpr:
+            put_ref(rec.refs()[0]);
+            put_ref(rec.refs()[1]);
+            put_name(rec.name());
+            break;
+        case RuleType::Form:
+        case RuleType::Appl:
+        case RuleType::Abst:
+        case RuleType::Conv:
+            put_ref(rec.refs()[0]);
+            put_ref(rec.refs()[1]);
+            break;
+        case RuleType::Inst:
+            put_ref(rec.refs()[0]);
+            _buf.put_varint(rec.refs().size() - 1);
+            for (size_t k = 1; k < rec.refs().size(); ++k) put_ref(rec.refs()[k]);
+            _buf.put_varint(rec.arg());
+            break;
+        case RuleType::Cp:
+        case RuleType::Tp:
+            put_ref(rec.refs()[0]);
+            break;
+        case RuleType::Sp:
+            put_ref(rec.refs()[0]);
+            _buf.put_varint(rec.arg());
+            break;
+    }
+    ++_lno;
+    if (_buf.size() >= _bufsize) flush();
+}
+
+void ScriptBinaryWriter::flush() {
+    _os.write(_buf.data().data(), _buf.size());
+    _buf.clear();
+}
+
+void ScriptBinaryWriter::finish() {
+    _buf.put_varint(SCRIPT_BINARY_END);
+    _buf.put_varint(_lno);
+    flush();
+    _os.flush();
+}
+
+ScriptBinaryReader::ScriptBinaryReader(std::istream& is, const std::string& srcname) : _reader(is, srcname) {
+    std::string magic(std::strlen(SCRIPT_BINARY_MAGIC), '\0');
+    _reader.get_bytes(magic.data(), magic.size());
+    if (!is_binary_script(magic)) throw FileError(srcname + ": not a binary script (magic number mismatch)");
+    uint64_t version = _reader.get_varint();
+    if (version != SCRIPT_BINARY_VERSION) {
+        throw FileError(srcname + ": unsupported binary script version " + std::to_string(version) + " (expected " + std::to_string(SCRIPT_BINARY_VERSION) + ")");
+    }
+}
+
+size_t ScriptBinaryReader::get_ref() {
+    int64_t diff = _reader.get_svarint();
+    if (diff <= 0 || (uint64_t)diff > _lno) throw FileError(name() + ": reference to line " + std::to_string((int64_t)_lno - diff) + " out of range (record " + std::to_string(_lno) + ")");
+    return _lno - diff;
+}
+
+bool ScriptBinaryReader::next(ScriptRecord& rec) {
+    if (_finished) return false;
+    auto get_name = [&]() -> const std::string& {
+        uint64_t idx = _reader.get_varint();
+        if (idx == _names.size()) _names.push_back(_reader.get_string());
+        if (idx >= _names.size()) throw FileError(name() + ": name index out of range (record " + std::to_string(_lno) + ")");
+        return _names[idx];
+    };
+    uint64_t op = _reader.get_varint();
+    if (op == SCRIPT_BINARY_END) {
+        uint64_t count = _reader.get_varint();
+        if (count != _lno) throw FileError(name() + ": the trailer counts " + std::to_string(count) + " records but " + std::to_string(_lno) + " were read");
+        _size = _lno;
+        _finished = true;
+        return false;
+    }
+    if (op > (uint64_t)RuleType::Tp) throw FileError(name() + ": unknown rule type " + std::to_string(op) + " (record " + std::to_string(_lno) + ")");
+    rec.clear((RuleType)op);
+    switch (rec.rtype()) {
+        case RuleType::Sort:
+            break;
+        case RuleType::Var:
+            rec.refs().push_back(get_ref());
+            rec.name() = get_name();
+            break;
+        case RuleType::Weak:
+        case RuleType::Def:
+        case RuleType::Defpr:
+            rec.refs().push_back(get_ref());
+            rec.refs().push_back(get_ref());
+            rec.name() = get_name();
+            break;
+        case RuleType::Form:
+        case RuleType::Appl:
+        case RuleType::Abst:
+        case RuleType::Conv:
+            rec.refs().push_back(get_ref());
+            rec.refs().push_back(get_ref());
+            break;
+        case RuleType::Inst: {
+            rec.refs().push_back(get_ref());
+            uint64_t n = _reader.get_varint();
+            for (uint64_t k = 0; k < n; ++k) rec.refs().push_back(get_ref());
+            rec.arg() = _reader.get_varint();
+            break;
+        }
+        case RuleType::Cp:
+        case RuleType::Tp:
+            rec.refs().push_back(get_ref());
+            break;
+        case RuleType::Sp:
+            rec.refs().push_back(get_ref());
+            rec.arg() = _reader.get_varint();
+            break;
+    }
+    ++_lno;
+    return true;
+}
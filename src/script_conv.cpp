@@ -0,0 +1,118 @@
+// convert a script between text and binary format
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+
+#include "common.hpp"
+#include "inference.hpp"
+#include "script.hpp"
+
+[[noreturn]] void usage(const std::string& execname, bool is_err = true) {
+    std::cerr << "usage: " << execname << " [FILE] [OPTION]...\n"
+              << std::endl;
+    std::cerr << "with no FILE, read stdin. the input format is detected automatically. options:\n"
+              << std::endl;
+    std::cerr << "\t-f FILE      read FILE instead of stdin" << std::endl;
+    std::cerr << "\t-o out_file  output script to out_file instead of stdout" << std::endl;
+    std::cerr << "\t-t           output script in text format (default)" << std::endl;
+    std::cerr << "\t-b           output script in binary format" << std::endl;
+    std::cerr << "\t-h           display this help and exit" << std::endl;
+    if (is_err) exit(EXIT_FAILURE);
+    exit(EXIT_SUCCESS);
+}
+
+int main(int argc, char* argv[]) {
+    std::string fname(""), ofname("");
+    bool binary = false;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg(argv[i]);
+        if (arg[0] == '-') {
+            if (arg == "-f") {
+                fname = std::string(argv[++i]);
+                continue;
+            } else if (arg == "-o") {
+                ofname = std::string(argv[++i]);
+                continue;
+            } else if (arg == "-t") binary = false;
+            else if (arg == "-b") binary = true;
+            else if (arg == "-h") usage(argv[0], false);
+            else {
+                std::cerr << BOLD(RED("error")) << ": invalid token: " << arg << std::endl;
+                usage(argv[0]);
+            }
+        } else {
+            if (fname.size() == 0) fname = arg;
+            else {
+                std::cerr << BOLD(RED("error")) << ": invalid token: " << arg << std::endl;
+                usage(argv[0]);
+            }
+        }
+    }
+
+    std::string srcname = fname.size() > 0 ? fname : "stdin";
+    std::stringstream input;
+    if (fname.size() > 0) {
+        std::ifstream ifs(fname, std::ios::binary);
+        if (!ifs) {
+            std::cerr << BOLD(RED("error")) << ": could not open file: " << fname << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        input << ifs.rdbuf();
+    } else {
+        input << std::cin.rdbuf();
+    }
+
+    std::ofstream ofs;
+    if (ofname.size() > 0) {
+        ofs.open(ofname, std::ios::binary);
+        if (!ofs) {
+            std::cerr << BOLD(RED("error")) << ": could not open file: " << ofname << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    std::ostream& os = ofname.size() > 0 ? ofs : std::cout;
+
+    // records are written as they are read
+    std::unique_ptr<ScriptBinaryWriter> owriter;
+    if (binary) owriter = std::make_unique<ScriptBinaryWriter>(os);
+    auto emit = [&](size_t lno, const ScriptRecord& rec) {
+        if (binary) owriter->write(rec);
+        else os << rec.string(lno) << "\n";
+    };
+
+    ScriptRecord rec;
+    try {
+        if (is_binary_script(input.str())) {
+            ScriptBinaryReader reader(input, srcname);
+            while (reader.next(rec)) emit(reader.lno() - 1, rec);
+        } else {
+            FileData data(read_lines(input), srcname);
+            std::string errmsg;
+            for (size_t i = 0; i < data.size(); ++i) {
+                auto status = parse_script_line(data[i], i, rec, errmsg);
+                if (status == ScriptLineStatus::End) break;
+                if (status == ScriptLineStatus::Error) {
+                    std::cerr << BOLD(RED("error")) << ": " << srcname << ": " << errmsg << std::endl;
+                    if (ofname.size() > 0) std::remove(ofname.c_str());
+                    exit(EXIT_FAILURE);
+                }
+                emit(i, rec);
+            }
+        }
+    } catch (FileError& e) {
+        e.puterror();
+        if (ofname.size() > 0) std::remove(ofname.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    if (binary) owriter->finish();
+    else os << "-1" << std::endl;
+    os << std::flush;
+
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "server.hpp"
+
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <sstream>
+
+#include "batch.hpp"
+#include "common.hpp"
+#include "inference.hpp"
+#include "parser.hpp"
+#include "script.hpp"
+#include "source_buffer.hpp"
+
+namespace {
+
+// the socket is removed when the server is interrupted as well
+char bound_path[sizeof(sockaddr_un::sun_path)];
+
+void remove_socket() {
+    if (bound_path[0] != '\0') unlink(bound_path);
+}
+
+void remove_socket_on_signal(int sig) {
+    remove_socket();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// error messages are written for a terminal; a response is a single line without colors
+std::string one_line(const std::string& text) {
+    std::string line;
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] == '\033') {
+            while (i < text.size() && !std::isalpha((unsigned char)text[i])) ++i;
+            continue;
+        }
+        if (text[i] == '\n' || text[i] == '\t') {
+            if (line.size() > 0 && line.back() != ' ') line += ' ';
+            continue;
+        }
+        line += text[i];
+    }
+    while (line.size() > 0 && line.back() == ' ') line.pop_back();
+    return line;
+}
+
+template <class E>
+std::string error_response(E& e) {
+    std::stringstream ss;
+    e.puterror(ss);
+    return "error " + one_line(ss.str());
+}
+
+bool send_all(int fd, const std::string& str) {
+    for (size_t sent = 0; sent < str.size();) {
+        ssize_t n = send(fd, str.data() + sent, str.size() - sent, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        sent += n;
+    }
+    return true;
+}
+
+}  // namespace
+
+VerifierServer::VerifierServer(Book& book, bool skip_check)
+    : _book(book), _skip_check(skip_check), _def_env(std::make_shared<Environment>(book.env())), _empty_context(std::make_shared<Context>()) {}
+
+std::string VerifierServer::handle(const std::string& request, Action& action) {
+    std::stringstream ss(request);
+    std::string cmd, args;
+    ss >> cmd;
+    std::getline(ss >> std::ws, args);
+    while (args.size() > 0 && (args.back() == '\r' || args.back() == ' ')) args.pop_back();
+
+    auto read_count = [](const std::string& str, size_t& n) {
+        try {
+            size_t pos;
+            long long x = std::stoll(str, &pos);
+            if (pos != str.size() || x < 0) return false;
+            n = x;
+        } catch (...) {
+            return false;
+        }
+        return true;
+    };
+
+    if (cmd == "type") return type(args);
+    if (cmd == "append") return append(args);
+    if (cmd == "check") return check(args);
+    if (cmd == "show") {
+        size_t n;
+        if (!read_count(args, n) || n >= _book.size()) return "error show: expected an index less than " + std::to_string(_book.size());
+        if (_book.is_forgotten(n)) return "error show: judgement " + args + " is forgotten";
+        return "ok [" + std::to_string(n) + "]: " + _book[n].string_simple();
+    }
+    if (cmd == "size") return "ok " + std::to_string(_book.size());
+    if (cmd == "undo") {
+        size_t n = 1;
+        if (args.size() > 0 && !read_count(args, n)) return "error undo: expected a number";
+        n = std::min(n, _book.size());
+        _book.erase(_book.end() - n, _book.end());
+        return "ok " + std::to_string(_book.size());
+    }
+    if (cmd == "clear") {
+        _book.clear();
+        return "ok 0";
+    }
+    if (cmd == "quit" || cmd == "shutdown") {
+        action = cmd == "quit" ? Action::Close : Action::Shutdown;
+        return "ok bye";
+    }
+    if (cmd.empty()) return "error empty request";
+    return "error unknown command: " + cmd;
+}
+
+std::string VerifierServer::type(const std::string& args) {
+    std::string expr = args;
+    std::shared_ptr<Environment> delta = _def_env;
+    std::shared_ptr<Context> gamma = _empty_context;
+    if (expr.size() > 0 && expr[0] == '@') {
+        size_t pos = expr.find(' ');
+        size_t n;
+        try {
+            n = std::stoull(expr.substr(1, pos - 1));
+        } catch (...) {
+            return "error type: expected \"@N TERM\"";
+        }
+        if (n >= _book.size() || _book.is_forgotten(n)) return "error type: no judgement " + std::to_string(n);
+        delta = _book[n].env();
+        gamma = _book[n].context();
+        expr = pos == std::string::npos ? "" : expr.substr(pos + 1);
+    } else if (_book.size() > 0 && !_book.is_forgotten(_book.size() - 1)) {
+        delta = _book.back().env();
+        gamma = _book.back().context();
+    }
+    if (expr.empty()) return "error type: no term given";
+
+    // the errors refer to src, so they are put into the response here
+    std::istringstream iss(expr);
+    SourceBuffer src(iss, "[request]");
+    std::shared_ptr<Term> term, type;
+    try {
+        term = parse_lambda(src, *delta);
+        type = get_type(term, delta, gamma);
+    } catch (ParseError& e) {
+        return error_response(e);
+    } catch (TypeError& e) {
+        return error_response(e);
+    } catch (BaseError& e) {
+        return error_response(e);
+    }
+    if (!type) return "error type: " + term->string() + " is untypable";
+    return "ok " + type->string();
+}
+
+std::string VerifierServer::append(const std::string& args) {
+    ScriptRecord rec;
+    std::string errmsg;
+    if (parse_script_line(args, _book.size(), rec, errmsg) != ScriptLineStatus::Rule) {
+        return "error append: " + (errmsg.size() > 0 ? errmsg : "not a rule: " + args);
+    }
+    try {
+        _book.apply(rec);
+    } catch (InferenceError& e) {
+        return error_response(e);
+    }
+    return "ok [" + std::to_string(_book.size() - 1) + "]: " + _book.back().string_simple();
+}
+
+std::string VerifierServer::check(const std::string& fname) {
+    if (fname.empty()) return "error check: no file given";
+    Book book(_skip_check);
+    book.set_def_env(_book.env());
+    std::string response;
+    try {
+        read_script_file(book, fname);
+    } catch (FileError& e) {
+        return error_response(e);
+    } catch (InferenceError& e) {
+        response = error_response(e);
+    }
+    // the lines verified before an error are kept, as the load of the interactive mode does
+    _book.swap(book);
+    if (response.size() > 0) return response + " (" + std::to_string(_book.size()) + " judgements kept)";
+    return "ok " + std::to_string(_book.size());
+}
+
+void VerifierServer::serve(const std::string& path) {
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw FileError("VerifierServer::serve(): " + path + ": socket path too long");
+    std::strcpy(addr.sun_path, path.c_str());
+
+    struct stat st;
+    if (lstat(path.c_str(), &st) == 0) {
+        if (!S_ISSOCK(st.st_mode)) throw FileError("VerifierServer::serve(): " + path + ": file exists and is not a socket");
+        unlink(path.c_str());
+    }
+
+    int server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (server_fd < 0) throw FileError("VerifierServer::serve(): socket: " + std::string(std::strerror(errno)));
+    if (bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(server_fd, 8) < 0) {
+        std::string msg = std::strerror(errno);
+        close(server_fd);
+        throw FileError("VerifierServer::serve(): " + path + ": " + msg);
+    }
+    // also on exit() (e.g. check_true_or_exit) and on a crash
+    std::strcpy(bound_path, path.c_str());
+    static bool registered = false;
+    if (!registered) std::atexit(remove_socket);
+    registered = true;
+    for (int sig : {SIGINT, SIGTERM, SIGSEGV, SIGABRT, SIGBUS, SIGFPE}) signal(sig, remove_socket_on_signal);
+
+    auto action = Action::Continue;
+    while (action != Action::Shutdown) {
+        int fd = accept(server_fd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        // one client at a time: an idle one is dropped so that it cannot hold the others off
+        timeval timeout{};
+        timeout.tv_sec = IDLE_TIMEOUT_SEC;
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        std::string buf;
+        char chunk[4096];
+        action = Action::Continue;
+        while (action == Action::Continue) {
+            ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                send_all(fd, "error idle for " + std::to_string(IDLE_TIMEOUT_SEC) + " s, closing the connection\n");
+                break;
+            }
+            if (n <= 0) break;
+            buf.append(chunk, n);
+            size_t begin = 0;
+            for (size_t end; action == Action::Continue && (end = buf.find('\n', begin)) != std::string::npos; begin = end + 1) {
+                std::string response;
+                try {
+                    response = handle(buf.substr(begin, end - begin), action);
+                } catch (std::exception& e) {
+                    response = std::string("error ") + e.what();
+                }
+                if (!send_all(fd, response + "\n") && action == Action::Continue) action = Action::Close;
+            }
+            buf.erase(0, begin);
+            // the rest of an overlong line cannot be told from the next request
+            if (action == Action::Continue && buf.size() > MAX_REQUEST_BYTES) {
+                send_all(fd, "error request longer than " + std::to_string(MAX_REQUEST_BYTES) + " bytes, closing the connection\n");
+                break;
+            }
+        }
+        close(fd);
+    }
+    close(server_fd);
+    remove_socket();
+    bound_path[0] = '\0';
+}
@@ -0,0 +1,54 @@
+#include "source_buffer.hpp"
+
+#include <sys/stat.h>
+
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "common.hpp"
+#include "scan.hpp"
+
+SourceBuffer::SourceBuffer(const std::string& fname) : _name(fname) {
+    struct stat st;
+    if (stat(fname.c_str(), &st) < 0) throw FileError("SourceBuffer(): " + fname + ": file not found");
+    if (S_ISREG(st.st_mode)) {
+        _mapped = MappedFile(fname);
+        _text = _mapped.view();
+    } else {
+        std::ifstream ifs(fname, std::ios::binary);
+        if (!ifs) throw FileError("SourceBuffer(): " + fname + ": file not found");
+        _owned.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+        _text = _owned;
+    }
+    index_lines();
+}
+
+SourceBuffer::SourceBuffer(std::istream& is, const std::string& srcname) : _name(srcname) {
+    _owned.assign(std::istreambuf_iterator<char>(is), std::istreambuf_iterator<char>());
+    _text = _owned;
+    index_lines();
+}
+
+void SourceBuffer::index_lines() {
+    _line_begin.clear();
+    const char* begin = _text.data();
+    const char* end = begin + _text.size();
+    for (const char* p = begin; p < end;) {
+        _line_begin.push_back(p - begin);
+        const char* nl = scan::find(p, end, '\n');
+        p = nl < end ? nl + 1 : end;
+    }
+    // sentinel, so that line(lno) ends right before _line_begin[lno + 1] - 1 in either case
+    bool ends_with_newline = _text.size() > 0 && _text.back() == '\n';
+    _line_begin.push_back(_text.size() + (ends_with_newline ? 0 : 1));
+}
+
+uint32_t SourceBuffer::intern(std::string_view str) {
+    auto itr = _ids.find(str);
+    if (itr != _ids.end()) return itr->second;
+    uint32_t id = _identifiers.size();
+    _identifiers.push_back(str);
+    _ids.emplace(str, id);
+    return id;
+}
@@ -4,14 +4,25 @@
 #include <iostream>
 #include <memory>
 #include <queue>
+#include <sstream>
 #include <vector>
 
+#include "binary.hpp"
+#include "batch.hpp"
 #include "book.hpp"
+#include "book_history.hpp"
+#include "checkpoint.hpp"
 #include "context.hpp"
+#include "defbin.hpp"
+#include "derivation_cache.hpp"
 #include "environment.hpp"
 #include "inference.hpp"
 #include "lambda.hpp"
+#include "mapped_file.hpp"
 #include "parser.hpp"
+#include "script.hpp"
+#include "server.hpp"
+#include "source_buffer.hpp"
 
 bool bout_result;
 
@@ -60,6 +71,32 @@ size_t test_fail = 0;
         test_success = test_fail = 0;                                                                \
     } while (false)
 
+// true if load() returns, false if it throws FileError (e.g. a reader refusing a malformed file)
+template <class F>
+bool loads(F&& load) {
+    try {
+        load();
+    } catch (FileError& e) {
+        e.puterror();
+        return false;
+    }
+    return true;
+}
+
+// the script genscript writes for the first n definitions of env, whose def and inst lines refer far back
+TextData script_of_first_defs(const Environment& env, size_t n) {
+    clear_scripts();
+    auto delta = std::make_shared<Environment>();
+    RulePtr rule;
+    for (size_t i = 0; i < std::min(env.size(), n); ++i) {
+        delta->push_back(env[i]);
+        rule = get_script(star, delta, std::make_shared<Context>());
+    }
+    TextData script;
+    generate_script(rule, script);
+    return script;
+}
+
 // #define defvar(vname) std::shared_ptr<Term> vname = variable(#vname[0])
 #define defvar(vname) std::shared_ptr<Term> vname = variable(#vname)
 
@@ -412,6 +449,176 @@ void test_def_file(const Environment& delta) {
     bout(is_convertible(ae, be, delta));
 }
 
+// malformed exprs must be rejected, not read as a part of them (e.g. "not[A" as "A")
+void test_parse_error(const Environment& delta) {
+    std::cerr << "[parse error test]" << std::endl;
+    auto error_of = [](const std::function<void()>& parse) -> std::string {
+        try {
+            parse();
+        } catch (ParseError& e) {
+            std::stringstream ss;
+            e.puterror(ss);
+            return ss.str();
+        }
+        return "";
+    };
+    auto expr_error = [&](const std::string& str) {
+        return error_of([&]() { parse_lambda(str, delta); });
+    };
+    auto has = [](const std::string& err, const std::string& msg) { return err.find(msg) != std::string::npos; };
+
+    test(has(expr_error("not[A"), "Could not obtain an expr by parsing this part"));
+    test(has(expr_error("(not[(A"), "Could not obtain an expr by parsing this part"));
+    test(has(expr_error("implies[(not[A]), (forall[(S), // B]"), "Could not obtain an expr by parsing this part"));
+    test(has(expr_error("not_in[(not[(A)]),($v:(not[(A)]).(a1_fig11.8[(A),(u),(v)]))"), "Could not obtain an expr by parsing this part"));
+    test(has(expr_error("A ->"), "Could not obtain an expr by parsing this part"));
+    test(has(expr_error("not_in[(not[()]),($v:(not[(A)]).(a1_fig11.8[(A),(u),(v)]))]"), "Could not reduce term-arrow sequence in parentheses to a single term"));
+    test(expr_error("not_in[(not[(A)]),($v:(not[(A)]).(a1_fig11.8[(A),(u),(v)]))]").empty());
+
+    std::istringstream iss(
+        "[A: *]\n"
+        "| n := A -> A : *\n"
+        "| [v: n[A]]\n"
+        "| | bad := v : n[A\n");
+    SourceBuffer src(iss, "[test]");
+    auto tokens = tokenize(src);
+    test(has(error_of([&]() { parse_defs(tokens); }), "Could not obtain an expr by parsing this part"));
+    test(has(error_of([&]() { parse_defs_parallel(tokens, 2); }), "Could not obtain an expr by parsing this part"));
+
+    // an error in a def2 block read on a thread is reported as parse_defs() reports it
+    std::istringstream iss2(
+        "def2\n0\nn\n*\n@\nedef2\n"
+        "def2\n1\nA\n*\nbad\nn[A\n*\nedef2\n");
+    SourceBuffer src2(iss2, "[test]");
+    auto tokens2 = tokenize(src2);
+    auto error = error_of([&]() { parse_defs(tokens2); });
+    test(!error.empty() && error == error_of([&]() { parse_defs_parallel(tokens2, 4); }));
+
+    test_result();
+}
+
+// malformed requests are answered with an error and leave the book as it was
+void test_server_requests() {
+    std::cerr << "[server request test]" << std::endl;
+    Book book;
+    VerifierServer server(book);
+    auto action = VerifierServer::Action::Continue;
+    auto is_ok = [&](const std::string& request) { return server.handle(request, action).rfind("ok ", 0) == 0; };
+    auto is_error = [&](const std::string& request) {
+        size_t size = book.size();
+        return server.handle(request, action).rfind("error ", 0) == 0 && book.size() == size;
+    };
+
+    test(is_error("append 0 sp 0 5"));
+    test(is_ok("append 0 sort"));
+    test(is_ok("append 1 var 0 A"));
+    test(is_error("append 2 sp 1 5"));
+    test(is_error("append 2 sp 0 99"));
+    test(is_error("append 1 inst 0 0 99"));
+    test(is_error("append"));
+    test(is_error("append 2 nonsense 1 2"));
+    test(is_error("%$#garbage"));
+    test(is_error(""));
+    test(is_error("show 99"));
+    test(is_error("undo -1"));
+    test(is_error("type @99 A"));
+    test(is_ok("append 2 sp 1 0"));
+    test(action == VerifierServer::Action::Continue);
+    test(server.handle("size", action) == "ok 3");
+
+    // check replaces the whole book: its judgements with the line hashes and the checked flag
+    {
+        std::ofstream ofs("out/test-server.script");
+        ofs << "0 sort\n1 var 0 A\n-1\n";
+    }
+    book.set_checked(false);
+    test(is_ok("check out/test-server.script"));
+    test(book.size() == 2 && book.line_hashes().size() == 2 && book.is_checked());
+    test(is_ok("clear") && book.line_hashes().empty());
+    test(is_ok("append 0 sort") && is_ok("append 1 var 0 A") && is_ok("append 2 sp 1 0"));
+
+    // type requests, failed ones included, keep nothing once answered
+    size_t sources = raw_string_sources();
+    bool answered = true;
+    for (int k = 0; k < 1000; ++k) {
+        answered &= is_ok("type A");
+        answered &= is_error("type A ->");
+    }
+    test(answered);
+    test(raw_string_sources() == sources);
+
+    // the notes of a parse error are part of the response
+    test(server.handle("type %(A) (", action).find("Not completed from here") != std::string::npos);
+
+    test_result();
+}
+
+// copies of an environment share one name index, and see only their own names in it
+void test_env_names(const Environment& env) {
+    std::cerr << "[environment name test]" << std::endl;
+    Environment base(std::vector<std::shared_ptr<Definition>>(env.begin(), env.begin() + 3));
+    test(base.has_name(env[2]->definiendum()) && !base.has_name(env[3]->definiendum()));
+    Environment longer = base + env[3];
+    Environment other = base + env[4];
+    test(longer.has_name(env[3]->definiendum()) && !longer.has_name(env[4]->definiendum()));
+    test(other.has_name(env[4]->definiendum()) && !other.has_name(env[3]->definiendum()));
+    test(!base.has_name(env[3]->definiendum()) && !base.has_name(env[4]->definiendum()));
+    test(base.has_prefix(env[0]->definiendum()) && !base.has_prefix(env[4]->definiendum()));
+    Environment popped(longer);
+    popped.pop_back();
+    test(popped.lookup_index(env[1]->definiendum()) == 1 && !popped.has_prefix(env[3]->definiendum()));
+    test_result();
+}
+
+// parse_lambda() against parse_lambda_legacy(): the same terms, or the same errors
+void test_parse_differential(const Environment& delta) {
+    std::cerr << "[parse differential test]" << std::endl;
+    for (std::string fname : {"resource/def_file_bez", "resource/def_file"}) {
+        if (!std::ifstream(fname)) continue;
+        SourceBuffer src(fname);
+        auto tokens = tokenize(src);
+        test(parse_defs(tokens, parse_lambda_legacy).repr() == parse_defs(tokens).repr());
+        test(parse_defs_parallel(tokens, 4).repr() == parse_defs(tokens).repr());
+    }
+
+    // inputs on both sides of the fallback
+    std::vector<std::string> exprs{
+        "A -> B => C <=> D",
+        "(A -> B) -> C",
+        "%f x->y",
+        "%f x -> y",
+        "$x:A.%f x->y",
+        "?x:A.x->y",
+        "$ x:A.x",
+        "not[A -> B]",
+        "not",
+        "not[A, B]",
+        "not[A",
+        "1x",
+        "A :",
+    };
+    auto result_of = [&delta](const std::string& str, ParseLambdaFunc parse_expr) -> std::string {
+        std::istringstream iss(str);
+        SourceBuffer src(iss, "[test]");
+        auto tokens = tokenize(src);
+        size_t idx = 0;
+        try {
+            return parse_expr(tokens, idx, tokens.size(), true, {}, delta)->term()->repr();
+        } catch (ParseError& e) {
+            std::stringstream ss;
+            e.puterror(ss);
+            return ss.str();
+        }
+    };
+    for (auto&& str : exprs) {
+        bool v = result_of(str, parse_lambda_legacy) == result_of(str, parse_lambda);
+        std::cerr << "\"" << str << "\" --> " << (v ? STR_SUCCESS : STR_FAIL) << std::endl;
+        ++(v ? test_success : test_fail);
+    }
+
+    test_result();
+}
+
 void test_get_type(const Book& book) {
     for (size_t i = 0; i < book.size(); ++i) {
         std::shared_ptr<Term> M = book[i].term();
@@ -425,6 +632,518 @@ void test_get_type(const Book& book) {
     test_result();
 }
 
+// binary scripts are untrusted: bad lengths and references are rejected while decoding
+void test_binary_script() {
+    std::cerr << "[binary script test]" << std::endl;
+    // reads every record; false if the reader threw FileError
+    auto decode = [](const std::string& data, std::vector<ScriptRecord>& recs) {
+        std::stringstream ss(data);
+        return loads([&]() {
+            ScriptBinaryReader reader(ss, "test");
+            for (ScriptRecord rec; reader.next(rec);) recs.push_back(rec);
+        });
+    };
+
+    std::vector<ScriptRecord> recs;
+    std::stringstream os;
+    ScriptBinaryWriter writer(os);
+    for (std::string line : {"0 sort", "1 var 0 A", "2 weak 1 1 x"}) {
+        ScriptRecord rec;
+        std::string errmsg;
+        parse_script_line(line, recs.size(), rec, errmsg);
+        writer.write(rec);
+        recs.push_back(rec);
+    }
+    writer.finish();
+    std::string data = os.str();
+    std::vector<ScriptRecord> read;
+    test(decode(data, read) && read.size() == recs.size() && read.back().hash() == recs.back().hash());
+    read.clear();
+    test(!decode(data.substr(0, data.size() - 3), read));
+    read.clear();
+    test(!decode(data.substr(0, data.size() - 1) + "\x05", read));
+
+    auto header = [](uint64_t version) {
+        ByteWriter w;
+        w.put_bytes(SCRIPT_BINARY_MAGIC, 4);
+        w.put_varint(version);
+        return w;
+    };
+    // version 1, and a name longer than the data left
+    test(!decode(header(1).data(), read));
+    ByteWriter w = header(SCRIPT_BINARY_VERSION);
+    w.put_varint((uint64_t)RuleType::Sort);
+    w.put_varint((uint64_t)RuleType::Var);
+    w.put_svarint(1);
+    w.put_varint(0);
+    w.put_varint(uint64_t(1) << 40);
+    read.clear();
+    test(!decode(w.data(), read));
+    // references to the record itself, to a later line and to a line before the first
+    for (int64_t diff : {0, -1, 2}) {
+        w = header(SCRIPT_BINARY_VERSION);
+        w.put_varint((uint64_t)RuleType::Sort);
+        w.put_varint((uint64_t)RuleType::Var);
+        w.put_svarint(diff);
+        w.put_varint(0);
+        w.put_string("A");
+        read.clear();
+        test(!decode(w.data(), read) && read.size() == 1);
+    }
+    test_result();
+}
+
+// with pool_interning, equal terms and contexts built apart share one pool slot
+void test_pool_interning(const Environment& delta) {
+    std::cerr << "[pool interning test]" << std::endl;
+    auto& terms = SharedPool<Term>::instance();
+    auto& contexts = SharedPool<Context>::instance();
+    size_t live = terms.live(), live_contexts = contexts.live();
+    // without pool_interning (verifier --no-intern), only the copies of a handle share a slot
+    pool_interning = false;
+    {
+        auto a = parse_lambda("$x:A.%x x", delta);
+        auto b = parse_lambda("$x:A.%x x", delta);
+        PoolHandle<Term> ha(a), hb(b), ha2(a);
+        PoolHandle<Term> copy(ha);
+        test(ha.id() != hb.id() && ha2.id() != ha.id() && copy.id() == ha.id());
+        test(ha2.ptr() == a && terms.live() == live + 3);
+    }
+    pool_interning = true;
+    {
+        auto a = parse_lambda("$x:A.%x x", delta);
+        auto b = parse_lambda("$x:A.%x x", delta);
+        auto c = parse_lambda("$y:A.%y y", delta);
+        PoolHandle<Term> ha(a), hb(b), hc(c), ha2(a);
+        test(a != b && ha.id() == hb.id());
+        test(ha.ptr() == a && hb.ptr() == a);
+        test(ha2.id() == ha.id());
+        // alpha-equivalent terms are kept apart: the names are printed
+        test(hc.id() != ha.id());
+        test(terms.live() == live + 2);
+
+        auto g1 = std::make_shared<Context>(std::vector<Typed<Variable>>{Typed<Variable>(variable("x"), parse_lambda("A", delta))});
+        auto g2 = std::make_shared<Context>(std::vector<Typed<Variable>>{Typed<Variable>(variable("x"), parse_lambda("A", delta))});
+        auto g3 = std::make_shared<Context>(std::vector<Typed<Variable>>{Typed<Variable>(variable("x"), parse_lambda("B", delta))});
+        PoolHandle<Context> h1(g1), h2(g2), h3(g3);
+        test(h1.id() == h2.id() && h3.id() != h1.id());
+
+        // many equal and distinct terms in and out of the index, so that it grows and entries are shifted back
+        std::vector<PoolHandle<Term>> handles;
+        for (int k = 0; k < 1000; ++k) handles.emplace_back(parse_lambda("%f a" + std::to_string(k % 300), delta));
+        test(terms.live() == live + 2 + 300);
+        // k and k + 600 hold the same term
+        for (int k = 0; k < 500; ++k) handles[k] = nullptr;
+        test(terms.live() == live + 2 + 300);
+        for (int k = 0; k < 1000; ++k) {
+            if (k % 300 < 150) handles[k] = nullptr;
+        }
+        test(terms.live() == live + 2 + 150);
+        bool found = true;
+        for (int k = 500; k < 1000; ++k) {
+            if (k % 300 >= 150) found &= PoolHandle<Term>(parse_lambda("%f a" + std::to_string(k % 300), delta)).id() == handles[k].id();
+        }
+        test(found);
+        handles.clear();
+        test(terms.live() == live + 2);
+    }
+    // the slots are released with their last handle
+    test(terms.live() == live && contexts.live() == live_contexts);
+    test_result();
+}
+
+// read_script_pipelined() against read_script(): a malformed or ill-typed line stops both at the same line with the same error
+void test_pipelined_errors(const Environment& env) {
+    std::cerr << "[pipelined error test]" << std::endl;
+    // a script long enough for the reader thread to run ahead of the checking one
+    TextData script = script_of_first_defs(env, 40);
+    std::string fname = "out/test-pipelined.script";
+
+    // the error and the # of lines applied before it
+    auto read = [&fname](bool pipelined) {
+        LineReader reader(fname);
+        Book book;
+        std::string errmsg;
+        try {
+            if (pipelined) book.read_script_pipelined(reader);
+            else book.read_script(reader);
+        } catch (InferenceError& e) {
+            errmsg = e.str();
+        }
+        return std::make_pair(errmsg, book.size());
+    };
+    // line lno of the script replaced by line
+    std::vector<std::pair<size_t, std::string>> edits{
+        {0, "0 sorts"},
+        {3, "3 var 9 a"},
+        {600, "600 weak 1 2"},
+        {script.size() - 2, std::to_string(script.size() - 2) + " abst"},
+        {1000, "1000 sp 999 99"},
+    };
+    for (auto&& [lno, line] : edits) {
+        TextData edited(script);
+        edited[lno] = line;
+        {
+            std::ofstream ofs(fname);
+            for (auto&& l : edited) ofs << l << "\n";
+        }
+        auto sequential = read(false), pipelined = read(true);
+        show(sequential.first);
+        test(!sequential.first.empty() && sequential.second == lno);
+        test(pipelined == sequential);
+    }
+    test_result();
+}
+
+// a checkpoint is resumed only with the script it was taken with
+void test_resume() {
+    std::cerr << "[checkpoint resume test]" << std::endl;
+    TextData script = read_lines("resource/script_test");
+    std::string ckpt = "out/test-resume.ckpt";
+    Book book;
+    book.read_script(FileData(TextData(script.begin(), script.begin() + 6), "script_test"));
+
+    // the # of lines resumed, or 0 if resume_checkpoint() refused the script
+    auto resume = [&ckpt](const TextData& lines) -> size_t {
+        Book resumed;
+        size_t lno = 0, resumed_lines = 0;
+        bool ok = loads([&]() {
+            resumed_lines = resume_checkpoint(ckpt, resumed, [&](ScriptRecord& rec) {
+                std::string errmsg;
+                if (lno >= lines.size()) return false;
+                if (parse_script_line(lines[lno], lno, rec, errmsg) != ScriptLineStatus::Rule) throw FileError(errmsg);
+                ++lno;
+                return true;
+            });
+        });
+        return ok ? resumed_lines : 0;
+    };
+
+    write_checkpoint(ckpt, book, book.line_hashes());
+    test(resume(script) == 6);
+    TextData changed(script);
+    changed[3] = "3 var 2 C";
+    test(resume(changed) == 0);
+    test(resume(TextData(script.begin(), script.begin() + 4)) == 0);
+    // a checkpoint without line hashes cannot be checked
+    write_checkpoint(ckpt, book);
+    test(resume(script) == 0);
+
+    test_result();
+}
+
+// hand-made checkpoints with null references, oversized counts or invalid variable names are refused
+void test_checkpoint_malformed() {
+    std::cerr << "[malformed checkpoint test]" << std::endl;
+    // magic, version 2, flags 0, then the # of judgements and the records (tags as in checkpoint.cpp)
+    auto read = [](const std::string& body) {
+        std::istringstream iss(std::string("FPCK\x02\x00", 6) + body, std::ios::binary);
+        Book book;
+        return loads([&]() { CheckpointReader(iss, "hand-made").read(book); });
+    };
+    const char end = 0, star = 1, var = 3, app = 4, lambda = 5, constant = 7, context = 8, judgement = 11;
+    test(read(std::string{0, end}));
+    // Variable "x", "" and "x y"
+    test(read(std::string{0, var, 1, 'x', end}));
+    test(!read(std::string{0, var, 0, end}));
+    test(!read(std::string{0, var, 3, 'x', ' ', 'y', end}));
+    // Application 1 1 over *, and Application 0 0
+    test(read(std::string{0, star, app, 1, 1, end}));
+    test(!read(std::string{0, app, 0, 0, end}));
+    test(!read(std::string{0, star, lambda, 0, 1, 1, end}));
+    test(!read(std::string{0, star, constant, 1, 'c', 2, 1, 0, end}));
+    // a fully null judgement is a forgotten line; a partly null one is malformed
+    test(read(std::string{1, judgement, 0, 0, 0, 0, end}));
+    test(!read(std::string{1, star, context, 0, judgement, 0, 1, 1, 1, end}));
+    // counts larger than the file are refused before allocating
+    test(!read(std::string{0, constant, 1, 'c', '\xff', '\xff', '\xff', '\xff', '\x0f', end}));
+    test(!read(std::string{'\xff', '\xff', '\xff', '\xff', '\x0f', end}));
+    // version 1, without flags
+    std::istringstream v1(std::string("FPCK\x01\x00\x00", 7), std::ios::binary);
+    Book book;
+    test(!loads([&]() { CheckpointReader(v1, "hand-made").read(book); }));
+    test_result();
+}
+
+// hand-made compiled environments with null operands, oversized counts or invalid variable names are refused
+void test_defbin_malformed() {
+    std::cerr << "[malformed defbin test]" << std::endl;
+    // magic, version 1, then the names, the # of terms, contexts and definitions, and the records (tags as in defbin.cpp)
+    auto read = [](const std::string& body) {
+        std::string data = std::string("FPDB\x01", 5) + body;
+        return loads([&]() { read_defbin(data, "hand-made"); });
+    };
+    const char end = 0, star = 1, var = 3, app = 4, constant = 7, context = 8, definition = 9;
+    // one name "c"; a primitive definition c := # : * in the empty context
+    test(read(std::string{1, 1, 'c', 1, 1, 1, star, context, 0, definition, 0, 1, 0, 1, end}));
+    test(!read(std::string{1, 1, 'c', 1, 1, 1, star, context, 0, definition, 0, 1, 0, 0, end}));
+    test(!read(std::string{0, 1, 0, 0, app, 0, 0, end}));
+    // c := # : * in the context x : *, then c(null)
+    test(!read(std::string{2, 1, 'c', 1, 'x', 3, 1, 1, star, var, 1, context, 1, 2, 1, definition, 0, 1, 0, 1, constant, 0, 1, 0, end}));
+    // d := # : c in the empty context after c; c named before it is defined, with an argument, or defined twice
+    test(read(std::string{2, 1, 'c', 1, 'd', 2, 1, 2, star, context, 0, definition, 0, 1, 0, 1, constant, 0, 0, definition, 1, 1, 0, 2, end}));
+    test(!read(std::string{1, 1, 'c', 2, 1, 1, star, context, 0, constant, 0, 0, definition, 0, 1, 0, 2, end}));
+    test(!read(std::string{2, 1, 'c', 1, 'd', 3, 1, 2, star, context, 0, definition, 0, 1, 0, 1, constant, 0, 1, 1, definition, 1, 1, 0, 2, end}));
+    test(!read(std::string{1, 1, 'c', 1, 1, 2, star, context, 0, definition, 0, 1, 0, 1, definition, 0, 1, 0, 1, end}));
+    // a Variable named "x", and one named ""
+    test(read(std::string{1, 1, 'x', 1, 0, 0, var, 0, end}));
+    test(!read(std::string{1, 0, 1, 0, 0, var, 0, end}));
+    // counts larger than the data are refused before allocating
+    test(!read(std::string{'\xff', '\xff', '\xff', '\xff', '\x0f', 0, 0, 0, end}));
+    test(!read(std::string{0, '\xff', '\xff', '\xff', '\xff', '\x0f', 0, 0, end}));
+    test(!read(std::string{1, 1, 'c', 2, 1, 1, star, context, 0, definition, 0, 1, 0, 1, constant, 0, '\xff', '\xff', '\xff', '\xff', '\x0f', end}));
+    test_result();
+}
+
+// the judgements of a run with skip_check are never reused by a checking run
+void test_cache_checked() {
+    std::cerr << "[cache test]" << std::endl;
+    FileData script(TextData{"0 sort", "1 var 0 A", "2 var 1 x", "3 conv 2 0"}, "ill-typed");
+    std::string cache = "out/test-cache.ckpt";
+
+    Book unchecked(true);
+    unchecked.read_script(script);
+    test(!unchecked.is_checked());
+    write_checkpoint(cache, unchecked, unchecked.line_hashes());
+
+    // reads the cache into a book reusing it and verifies the script again; the # of lines reused, or -1 on an error
+    auto rerun = [&cache, &script](bool skip_check) -> int {
+        auto cached = std::make_shared<Book>();
+        std::vector<uint64_t> hashes;
+        read_checkpoint(cache, *cached, &hashes);
+        Book book(skip_check);
+        book.reuse_from(cached, hashes);
+        try {
+            book.read_script(script);
+        } catch (InferenceError& e) {
+            e.puterror();
+            return -1;
+        }
+        return book.reused_count();
+    };
+    test(rerun(false) == -1);
+    test(rerun(true) == 4);
+
+    // a checked cache is reused by both
+    FileData typed(TextData(script.begin(), script.begin() + 2), "well-typed");
+    Book checked;
+    checked.read_script(typed);
+    test(checked.is_checked());
+    write_checkpoint(cache, checked, checked.line_hashes());
+    test(rerun(false) == -1);
+    script = typed;
+    test(rerun(false) == 2);
+    test(rerun(true) == 2);
+
+    test_result();
+}
+
+// verifier --forget: a book releasing each judgement after its last use derives the same lines,
+// and a reference to a released judgement is an error
+void test_forget(const Environment& env) {
+    std::cerr << "[forget test]" << std::endl;
+    // last_use[i] as verifier computes it in its pre-pass
+    auto last_use_of = [](const TextData& lines) {
+        size_t lno = 0;
+        std::string errmsg;
+        return script_last_use([&](ScriptRecord& rec) {
+            return lno < lines.size() && parse_script_line(lines[lno], lno, rec, errmsg) == ScriptLineStatus::Rule && ++lno;
+        });
+    };
+
+    TextData script = script_of_first_defs(env, 40);
+
+    Book full, forgetting;
+    full.read_script(FileData(script, "generated"));
+    forgetting.forget_after_last_use(last_use_of(script));
+    // each line is compared as it is derived, since most are released later
+    size_t differing = 0;
+    forgetting.set_listener([&](size_t lno) {
+        if (forgetting[lno].string() != full[lno].string()) ++differing;
+    });
+    forgetting.read_script(FileData(script, "generated"));
+    test(forgetting.size() == full.size());
+    size_t forgotten = 0;
+    for (size_t i = 0; i < full.size(); ++i) forgotten += forgetting.is_forgotten(i);
+    show(full.size());
+    show(forgotten);
+    test(forgotten > 0);
+    test(differing == 0);
+    test(!forgetting.is_forgotten(full.size() - 1));
+
+    // a last_use claiming line 2 unused: it is released after line 3, and line 4 refers to it
+    TextData lines = read_lines("resource/script_test");
+    auto last_use = last_use_of(lines);
+    last_use[2] = 2;
+    Book book;
+    book.forget_after_last_use(last_use);
+    std::string errmsg;
+    try {
+        book.read_script(FileData(lines, "script_test"));
+    } catch (InferenceError& e) {
+        errmsg = e.str();
+    }
+    show(errmsg);
+    test(errmsg.find("at line 4 refers to a forgotten judgement (idx = 2)") != std::string::npos);
+    test_result();
+}
+
+// verifier -i mark/restore: a restored book and script are those marked, however often and from wherever restored
+void test_book_history() {
+    std::cerr << "[book history test]" << std::endl;
+    TextData lines = read_lines("resource/script_test");
+    Book book;
+    TextData script;
+    BookHistory history(book, script);
+    // applies a line as the interactive mode does
+    auto apply = [&](const std::string& line) {
+        ScriptRecord rec;
+        std::string errmsg;
+        test(parse_script_line(line, book.size(), rec, errmsg) == ScriptLineStatus::Rule);
+        book.apply(rec);
+        script.push_back(line);
+        history.push(book.back(), script.back());
+    };
+    auto undo = [&](size_t n) {
+        book.erase(book.end() - n, book.end());
+        script.resize(book.size());
+        history.pop(n);
+    };
+    // the judgements and the script lines
+    auto snapshot = [&]() {
+        TextData snap;
+        for (size_t i = 0; i < book.size(); ++i) snap.push_back(book[i].string() + " | " + script[i]);
+        return snap;
+    };
+
+    for (size_t i = 0; i < 5; ++i) apply(lines[i]);
+    auto half = history.state();
+    auto half_snap = snapshot();
+    for (size_t i = 5; i < 10; ++i) apply(lines[i]);
+    auto full = history.state();
+    auto full_snap = snapshot();
+    test(half.size() == 5 && full.size() == 10);
+
+    test(history.restore(half, book, script) == 5);
+    test(book.size() == 5 && script.size() == 5 && history.size() == 5);
+    test(snapshot() == half_snap);
+    // restoring the current state changes nothing
+    test(history.restore(half, book, script) == 0);
+    test(snapshot() == half_snap);
+
+    // a branch: line 3 replaced after an undo, then the marks restored across it
+    test(history.restore(full, book, script) == 5);
+    test(snapshot() == full_snap);
+    undo(7);
+    apply("3 var 2 C");
+    test(snapshot() != TextData(full_snap.begin(), full_snap.begin() + 4));
+    test(history.restore(full, book, script) == 8);
+    test(snapshot() == full_snap);
+    test(history.restore(half, book, script) == 5);
+    test(snapshot() == half_snap);
+    test(history.restore(half, book, script) == 0);
+    test(snapshot() == half_snap);
+    // the lines after the mark are applied again on top of it
+    for (size_t i = 5; i < 10; ++i) apply(lines[i]);
+    test(snapshot() == full_snap);
+    test_result();
+}
+
+// genscript reuses cached derivations without changing its output; malformed caches are refused
+void test_derivation_cache(const Environment& env) {
+    std::cerr << "[derivation cache test]" << std::endl;
+    std::string fname = "out/test-derivation.cache";
+    // the script of the last definition of defs as genscript writes it, with the cache or without (nullptr)
+    auto script_of = [](const Environment& defs, DerivationCache* cache) {
+        clear_scripts();
+        auto delta = std::make_shared<Environment>();
+        RulePtr rule;
+        for (size_t i = 0; i < defs.size(); ++i) {
+            if (cache) {
+                rule = cache->derive(delta, defs[i]);
+            } else {
+                delta->push_back(defs[i]);
+                rule = get_script(star, delta, std::make_shared<Context>());
+            }
+        }
+        TextData data;
+        generate_script(rule, data);
+        return data;
+    };
+
+    DerivationCache first;
+    test(script_of(env, &first) == script_of(env, nullptr));
+    first.save(fname);
+
+    // implies_in renamed a bound variable: it and the definitions using it are derived again, the others reused
+    std::ifstream ifs("resource/def_file");
+    std::string text((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+    text.replace(text.find("?y:(A).(B)"), 10, "?z:(A).(B)");
+    std::istringstream iss(text);
+    SourceBuffer src(iss, "edited def_file");
+    Environment edited = parse_defs(tokenize(src));
+    DerivationCache cache;
+    cache.load(fname);
+    test(script_of(edited, &cache) == script_of(edited, nullptr));
+    test(cache.hits() > 0 && cache.misses() > 0 && cache.hits() + cache.misses() == edited.size());
+
+    // magic, version 1, then the # of entries and the entries (key:8 size:v body)
+    auto write = [&fname](const std::string& body) {
+        std::ofstream ofs(fname, std::ios::binary);
+        ofs << std::string("FPDC\x01", 5) << body;
+    };
+    std::string key(8, 'A');
+    write(std::string("\x01") + key + "\xff\xff\xff\xff\xff\xff\xff\xff\x7f");
+    test(!loads([&]() { DerivationCache().load(fname); }));
+    write("\xff\xff\xff\xff\x0f");
+    test(!loads([&]() { DerivationCache().load(fname); }));
+    write(std::string("\x01") + key + "\x03\x01\x00");
+    test(!loads([&]() { DerivationCache().load(fname); }));
+    // node and argument counts of an entry larger than the entry are refused when it is looked up
+    for (std::string body : {std::string("\xff\xff\xff\xff\x0f"), std::string("\x01\x09\x00\xff\xff\xff\xff\x0f", 8)}) {
+        write(std::string("\x01") + key + (char)body.size() + body);
+        DerivationCache bad;
+        test(loads([&]() { bad.load(fname); }));
+        auto delta = std::make_shared<Environment>();
+        auto base = get_script(star, delta, std::make_shared<Context>());
+        test(!loads([&]() { bad.lookup(0x4141414141414141ULL, base, delta); }));
+    }
+    test_result();
+}
+
+// a failing job of a batch is reported as such, and the others are verified as usual
+void test_batch(const Environment& env) {
+    std::cerr << "[batch test]" << std::endl;
+    {
+        std::ofstream ofs("out/test-batch-ill.script");
+        ofs << "0 sort\n1 var 0 A\n2 var 1 x\n3 conv 2 0\n-1\n";
+        std::ofstream ofs2("out/test-batch-bad.def");
+        ofs2 << "def2\n0\nn\n*\n@\nedef2\ndef2\n1\nA\n*\nbad\nn[A\n*\nedef2\n";
+    }
+    std::vector<BatchJob> jobs{
+        {"resource/script_test", "", ""},
+        {"out/test-batch-ill.script", "", ""},
+        {"out/test-batch-missing.script", "", ""},
+        {"resource/script_test", "out/test-batch-bad.def", ""},
+        {"resource/script_test", "resource/def_file", ""},
+    };
+    for (size_t threads : {1, 3}) {
+        auto results = run_batch(jobs, threads, false);
+        test(results.size() == jobs.size());
+        test(results[0].ok && results[4].ok && results[0].lines == results[4].lines && results[0].lines > 0);
+        test(!results[1].ok && results[1].error.find("not applicable") != std::string::npos);
+        test(!results[2].ok && !results[3].ok && results[3].error.size() > 0);
+    }
+    test(!shared_conversions);
+
+    // the key of the shared conversions: equal definitions give equal ids, in any copy
+    Environment same(std::vector<std::shared_ptr<Definition>>(env.begin(), env.end()));
+    Environment prefix(std::vector<std::shared_ptr<Definition>>(env.begin(), env.end() - 1));
+    test(same.content_id() == env.content_id() && prefix.content_id() != env.content_id());
+    test((prefix + env.back()).content_id() == env.content_id() && Environment().content_id() == 0);
+    test_result();
+}
+
 // void test_parse2(const Environment& delta) {
 //     try {
 //         // {
@@ -512,10 +1231,14 @@ void test_new_parser(const Environment& delta) {
 
 int main() {
     std::vector<Environment> envs;
+    // resource/def_file_bez (def_file with Chapters 13 and 14) is not in the tree;
+    // without it envs[0] is def_file too, and the tests of its definitions are skipped
+    bool has_bez = (bool)std::ifstream("resource/def_file_bez");
+    if (!has_bez) std::cerr << "resource/def_file_bez is not in the tree: skipping the tests of its definitions (delta reduction 1 and 3, parse, new parser)" << std::endl;
     try {
         {
             std::vector<std::string> fnames{
-                "resource/def_file_bez",
+                has_bez ? "resource/def_file_bez" : "resource/def_file",
                 "resource/def_file"};
             for(auto&& fname : fnames) {
                 std::cout << "loading " << fname << "..." << std::flush;
@@ -531,18 +1254,33 @@ int main() {
 
         test_alpha_subst();
         test_subst();
-        test_reduction1(envs[0]);
+        if (has_bez) test_reduction1(envs[0]);
         test_reduction2(envs[0]);
         test_sandbox_combinators();
 
-        test_parse(envs[0]);
-        test_reduction3(envs[0]);
+        if (has_bez) test_parse(envs[0]);
+        if (has_bez) test_reduction3(envs[0]);
         test_def_file(envs[1]);
+        test_parse_error(envs[1]);
+        test_parse_differential(envs[1]);
+        test_env_names(envs[1]);
 
         test_get_type(book);
+        test_pool_interning(envs[0]);
+        test_binary_script();
+        test_pipelined_errors(envs[1]);
+        test_resume();
+        test_checkpoint_malformed();
+        test_defbin_malformed();
+        test_cache_checked();
+        test_forget(envs[1]);
+        test_book_history();
+        test_derivation_cache(envs[1]);
+        test_batch(envs[1]);
+        test_server_requests();
 
         // test_parse2(envs[0]);
-        test_new_parser(envs[0]);
+        if (has_bez) test_new_parser(envs[0]);
     } catch (ParseError& e) {
         e.puterror();
         exit(EXIT_FAILURE);
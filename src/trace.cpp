@@ -0,0 +1,83 @@
+#include "trace.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#include "common.hpp"
+
+namespace trace {
+
+bool enabled = false;
+
+namespace {
+
+struct Event {
+    std::string name;
+    const char* category;
+    double ts, dur;
+    uint32_t tid;
+};
+
+std::mutex mtx;
+std::vector<Event> events;
+
+uint32_t thread_index() {
+    static std::atomic<uint32_t> next = 0;
+    thread_local uint32_t tid = next++;
+    return tid;
+}
+
+// names are definition names and rule types, but escape them anyway
+void put_json_string(std::ostream& os, const std::string& str) {
+    os << '"';
+    for (char ch : str) {
+        if (ch == '"' || ch == '\\') os << '\\' << ch;
+        else if ((unsigned char)ch < 0x20) os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int)ch << std::dec << std::setfill(' ');
+        else os << ch;
+    }
+    os << '"';
+}
+
+}  // namespace
+
+double now_us() {
+    static const auto origin = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void record(const std::string& name, const char* category, double ts_us, double dur_us) {
+    uint32_t tid = thread_index();
+    std::lock_guard<std::mutex> lock(mtx);
+    events.push_back({name, category, ts_us, dur_us, tid});
+}
+
+size_t size() {
+    std::lock_guard<std::mutex> lock(mtx);
+    return events.size();
+}
+
+void write(std::ostream& os) {
+    std::lock_guard<std::mutex> lock(mtx);
+    os << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    os << std::fixed << std::setprecision(3);
+    for (size_t i = 0; i < events.size(); ++i) {
+        const auto& e = events[i];
+        os << (i == 0 ? "\n" : ",\n") << "{\"name\": ";
+        put_json_string(os, e.name);
+        os << ", \"cat\": \"" << e.category << "\", \"ph\": \"X\", \"ts\": " << e.ts << ", \"dur\": " << e.dur
+           << ", \"pid\": 1, \"tid\": " << e.tid << "}";
+    }
+    os << "\n]}" << std::endl;
+}
+
+void write(const std::string& fname) {
+    std::ofstream ofs(fname);
+    if (!ofs) throw FileError("trace::write(): " + fname + ": could not open file");
+    write(ofs);
+}
+
+}  // namespace trace
@@ -2,20 +2,33 @@
 // generate a book from a given script
 
 #include <atomic>
+#include <charconv>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
 #include <fstream>
 #include <functional>
 #include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <sstream>
 #include <thread>
 
+#include "batch.hpp"
 #include "book.hpp"
+#include "book_history.hpp"
+#include "checkpoint.hpp"
 #include "common.hpp"
 #include "inference.hpp"
+#include "instrument.hpp"
 #include "lambda.hpp"
+#include "mapped_file.hpp"
 #include "parser.hpp"
+#include "profile.hpp"
+#include "progress.hpp"
+#include "script.hpp"
+#include "server.hpp"
 
 [[noreturn]] void usage(const std::string& execname, bool is_err = true) {
     std::cerr << "usage: " << execname << " [FILE] [OPTION]...\n"
@@ -27,13 +40,31 @@
     std::cerr << "\t-n                      output book in new notation" << std::endl;
     std::cerr << "\t-r                      output book in rich notation" << std::endl;
     std::cerr << "\t-l LINES                read script until line LINES" << std::endl;
-    std::cerr << "\t-d def_file             read def_file for definition reference" << std::endl;
+    std::cerr << "\t-b                      read script in binary format (generated by genscript -b)" << std::endl;
+    std::cerr << "\t-d def_file             read def_file (text, or compiled by def_conv -b) for definition reference" << std::endl;
     std::cerr << "\t-o out_file             write output to out_file instead of stdout" << std::endl;
     std::cerr << "\t-e log_file             write error output to log_file instead of stderr" << std::endl;
     std::cerr << "\t--out-def out_def_file  write final environment to out_file" << std::endl;
     std::cerr << "\t--skip-check            skip applicability check of inference rules" << std::endl;
+    std::cerr << "\t--forget                release judgements after their last reference (needs -f; use with -o)" << std::endl;
+    std::cerr << "\t--no-intern             keep equal terms and contexts built apart separately (default: once)" << std::endl;
+    std::cerr << "\t--checkpoint FILE       save the book to FILE every --checkpoint-every lines (each time a full snapshot)" << std::endl;
+    std::cerr << "\t--checkpoint-every N    checkpoint interval in lines (default: 100000)" << std::endl;
+    std::cerr << "\t--cache FILE            reuse the judgements of unchanged lines from FILE and update it (an edited script is re-verified incrementally)" << std::endl;
+    std::cerr << "\t--resume FILE           restore the book from checkpoint FILE and continue after its last line (the lines it covers must be unchanged; their judgements are trusted, not re-checked)" << std::endl;
+    std::cerr << "\t--pipeline              parse the script on another thread while checking it (default on multi-core machines)" << std::endl;
+    std::cerr << "\t--no-pipeline           parse and check the script on a single thread" << std::endl;
+    std::cerr << "\t--profile               print the count and time of each type of rule (with its slowest line) and of the probed functions" << std::endl;
+    std::cerr << "\t--profile-json FILE     write the profile to FILE in JSON as well (implies --profile)" << std::endl;
+    std::cerr << "\t--progress MODE         auto (default: tty if stderr is a terminal, otherwise off), tty, json (a JSON object per line) or off" << std::endl;
+    std::cerr << "\t--progress-json FILE    write the json progress records to FILE (e.g. /dev/fd/3) instead of stderr (implies --progress json)" << std::endl;
+    std::cerr << "\t--batch MANIFEST        verify every script listed in MANIFEST (\"SCRIPT [DEF_FILE [OUT_BOOK]]\" per line) and report each" << std::endl;
+    std::cerr << "\t-j N                    verify N scripts of --batch at once (default: # of cores)" << std::endl;
+    std::cerr << "\t--stats                 print the instrument counters and timers at exit" << std::endl;
+    std::cerr << "\t--stats-json FILE       write the instrument counters and timers to FILE in JSON at exit" << std::endl;
     std::cerr << "\t-v                      verbose output for debugging purpose" << std::endl;
     std::cerr << "\t-i                      run in interactive mode (almost all options are ignored)" << std::endl;
+    std::cerr << "\t--serve SOCKET          answer type / append / check requests on Unix socket SOCKET with the book of FILE and -d kept loaded (as -i)" << std::endl;
     std::cerr << "\t-s                      suppress output and just verify input (overrides -v)" << std::endl;
     std::cerr << "\t-h                      display this help and exit" << std::endl;
     if (is_err) exit(EXIT_FAILURE);
@@ -67,15 +98,51 @@ std::string strbytes(size_t siz) {
     return ss.str();
 };
 
+// parses the argument of a numeric option, a decimal count without sign or trailing characters; false if it is not one
+bool parse_count(const char* text, size_t& n) {
+    const char* end = text + std::strlen(text);
+    auto [ptr, ec] = std::from_chars(text, end, n);
+    return ec == std::errc() && ptr == end && ptr != text;
+}
+
+// book file being written during verification; removed if the process exits before completing it
+std::string partial_book_file;
+
+void remove_partial_book_file() {
+    if (partial_book_file.size() > 0) std::remove(partial_book_file.c_str());
+}
+
+BookFormat book_format(int notation) {
+    switch (notation) {
+        case Conventional: return BookFormat::Conventional;
+        case New: return BookFormat::New;
+        case Rich: return BookFormat::Rich;
+        default:
+            check_true_or_exit(
+                false,
+                "invalid notation value = " << notation,
+                __FILE__, __LINE__, __func__);
+    }
+}
+
 int main(int argc, char* argv[]) {
     FileData data;
-    std::string fname(""), def_file(""), ofname(""), odefname(""), efname("");
+    std::string fname(""), def_file(""), ofname(""), odefname(""), efname(""), ckptname(""), resumename(""), cachename(""), profile_json(""), stats_json(""), progress_json("");
     int notation = Conventional;
     bool is_verbose = false;
     bool is_quiet = false;
     bool skip_check = false;
     bool interactive = false;
+    bool binary = false;
+    bool pipeline = std::thread::hardware_concurrency() != 1;
+    bool forget = false;
+    bool is_profiled = false;
+    bool show_stats = false;
+    auto progress_mode = ProgressReporter::Mode::Auto;
     size_t limit = std::string::npos;
+    size_t ckpt_every = 100000;
+    std::string manifest(""), serve_path("");
+    size_t batch_threads = std::max(1u, std::thread::hardware_concurrency());
 
     for (int i = 1; i < argc; ++i) {
         std::string arg(argv[i]);
@@ -98,12 +165,83 @@ int main(int argc, char* argv[]) {
             } else if (arg == "--skip-check") {
                 skip_check = true;
                 continue;
+            } else if (arg == "--forget") {
+                forget = true;
+                continue;
+            } else if (arg == "--no-intern") {
+                pool_interning = false;
+                continue;
+            } else if (arg == "--checkpoint") {
+                ckptname = std::string(argv[++i]);
+                continue;
+            } else if (arg == "--checkpoint-every") {
+                if (!parse_count(argv[++i], ckpt_every) || ckpt_every == 0) {
+                    std::cerr << BOLD(RED("error")) << ": invalid checkpoint interval: " << argv[i] << std::endl;
+                    usage(argv[0]);
+                }
+                continue;
+            } else if (arg == "--cache") {
+                cachename = std::string(argv[++i]);
+                continue;
+            } else if (arg == "--resume") {
+                resumename = std::string(argv[++i]);
+                continue;
+            } else if (arg == "--pipeline") {
+                pipeline = true;
+                continue;
+            } else if (arg == "--no-pipeline") {
+                pipeline = false;
+                continue;
+            } else if (arg == "--profile") {
+                is_profiled = true;
+                continue;
+            } else if (arg == "--profile-json") {
+                profile_json = std::string(argv[++i]);
+                is_profiled = true;
+                continue;
+            } else if (arg == "--progress") {
+                if (!ProgressReporter::parse_mode(argv[++i], progress_mode)) {
+                    std::cerr << BOLD(RED("error")) << ": invalid progress mode: " << argv[i] << std::endl;
+                    usage(argv[0]);
+                }
+                continue;
+            } else if (arg == "--progress-json") {
+                progress_json = std::string(argv[++i]);
+                progress_mode = ProgressReporter::Mode::Json;
+                continue;
+            } else if (arg == "--serve") {
+                serve_path = std::string(argv[++i]);
+                // the script is read as in interactive mode
+                interactive = true;
+                continue;
+            } else if (arg == "--batch") {
+                manifest = std::string(argv[++i]);
+                continue;
+            } else if (arg == "-j") {
+                if (!parse_count(argv[++i], batch_threads)) {
+                    std::cerr << BOLD(RED("error")) << ": invalid # of threads: " << argv[i] << std::endl;
+                    usage(argv[0]);
+                }
+                batch_threads = std::max<size_t>(1, batch_threads);
+                continue;
+            } else if (arg == "--stats") {
+                show_stats = true;
+                continue;
+            } else if (arg == "--stats-json") {
+                stats_json = std::string(argv[++i]);
+                continue;
             } else if (arg == "-l") {
-                limit = std::stoi(argv[++i]);
+                if (!parse_count(argv[++i], limit)) {
+                    std::cerr << BOLD(RED("error")) << ": invalid # of lines: " << argv[i] << std::endl;
+                    usage(argv[0]);
+                }
                 continue;
             } else if (arg == "-i") {
                 interactive = true;
                 continue;
+            } else if (arg == "-b") {
+                binary = true;
+                continue;
             } else if (arg == "-c") notation = Conventional;
             else if (arg == "-n") notation = New;
             else if (arg == "-r") notation = Rich;
@@ -123,84 +261,256 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    if (fname.size() > 0) data = FileData(fname);
-    else if (!interactive) data = FileData(true);
+    // the json progress records get a stream of their own, apart from the messages on stderr
+    std::FILE* progress_fp = stderr;
+    if (progress_json.size() > 0) {
+        progress_fp = std::fopen(progress_json.c_str(), "w");
+        if (!progress_fp) {
+            std::cerr << BOLD(RED("error")) << ": could not open file: " << progress_json << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (manifest.size() > 0) {
+        std::vector<BatchJob> jobs;
+        try {
+            jobs = read_manifest(manifest);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+        // written by the workers under the lock of run_batch()
+        std::atomic<size_t> finished = 0;
+        std::atomic<const std::string*> last_script = nullptr;
+        ProgressReporter progress(progress_mode, "scripts", "scripts", [&]() {
+            ProgressReporter::Sample sample;
+            sample.done = finished.load(std::memory_order_relaxed);
+            sample.total = jobs.size();
+            if (auto script = last_script.load(std::memory_order_relaxed)) sample.status = *script;
+            return sample;
+        });
+        progress.set_output(progress_fp);
+        auto start = std::chrono::steady_clock::now();
+        progress.start();
+        auto results = run_batch(jobs, batch_threads, skip_check, [&](size_t i) {
+            last_script.store(&jobs[i].script, std::memory_order_relaxed);
+            finished.fetch_add(1, std::memory_order_relaxed);
+        });
+        progress.stop();
+        double wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        bool ok = print_batch(std::cout, jobs, results, wall_ms);
+        if (show_stats) instrument::dump(std::cerr);
+        if (stats_json.size() > 0) {
+            try {
+                instrument::dump_json(stats_json);
+            } catch (FileError& e) {
+                e.puterror();
+                exit(EXIT_FAILURE);
+            }
+        }
+        return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    std::ifstream bin_ifs;
+    std::unique_ptr<ScriptBinaryReader> bin_reader;
+    std::unique_ptr<LineReader> line_reader;
+    if (binary && !interactive) {
+        try {
+            if (fname.size() > 0) {
+                bin_ifs.open(fname, std::ios::binary);
+                if (!bin_ifs) throw FileError(fname + ": file not found");
+                bin_reader = std::make_unique<ScriptBinaryReader>(bin_ifs, fname);
+            } else {
+                bin_reader = std::make_unique<ScriptBinaryReader>(std::cin, "stdin");
+            }
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    } else if (interactive) {
+        if (fname.size() > 0) data = FileData(fname);
+    } else {
+        try {
+            if (fname.size() > 0) line_reader = std::make_unique<LineReader>(fname);
+            else line_reader = std::make_unique<LineReader>();
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
 
     Book book(skip_check);
-    if (def_file.size() > 0) book.read_def_file(def_file);
+    if (def_file.size() > 0) {
+        try {
+            book.read_def_file(def_file);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        } catch (BaseError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    if (limit == std::string::npos) limit = data.size();
+    // a pre-pass over the script finds the last reference of each line
+    if (forget && !interactive) {
+        if (fname.size() == 0) {
+            std::cerr << BOLD(RED("error")) << ": --forget needs the script given as a file (-f FILE) since it is read twice" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        try {
+            std::vector<size_t> last_use;
+            if (binary) {
+                std::ifstream ifs(fname, std::ios::binary);
+                ScriptBinaryReader reader(ifs, fname);
+                last_use = script_last_use([&reader](ScriptRecord& rec) { return reader.next(rec); });
+            } else {
+                LineReader reader(fname);
+                std::string_view line;
+                std::string errmsg;
+                size_t lno = 0;
+                // stops at a malformed line, which the main pass reports
+                last_use = script_last_use([&](ScriptRecord& rec) {
+                    return reader.next(line) && parse_script_line(line, lno++, rec, errmsg) == ScriptLineStatus::Rule;
+                });
+            }
+            book.forget_after_last_use(last_use);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+    }
 
-    std::stringstream ss;
-    auto alive1 = std::atomic_bool(false);
-    size_t last_size = 0, time_counter = 0, time_unit_ms = 200, maxlen = 0;
-
-    auto progress_check = [&alive1, &last_size, &time_counter, &time_unit_ms, &maxlen, &book, &data, &limit]() {
-        const std::chrono::milliseconds interval(time_unit_ms);
-        std::this_thread::sleep_for(interval);
-        while (alive1.load()) {
-            auto start = std::chrono::system_clock::now();
-            std::stringstream ss;
-            if (time_counter > 0) {
-                std::cerr << "\033[F\033[F" << '\r' << std::flush;
+    // write each judgement to the output file as soon as it is derived
+    std::FILE* book_fp = nullptr;
+    std::unique_ptr<BookWriter> book_writer;
+    if (ofname.size() > 0 && !interactive) {
+        book_fp = std::fopen(ofname.c_str(), "wb");
+        if (!book_fp) {
+            std::cerr << BOLD(RED("error")) << ": could not open file: " << ofname << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        partial_book_file = ofname;
+        std::atexit(remove_partial_book_file);
+        book_writer = std::make_unique<BookWriter>(book_fp, book_format(notation));
+    }
+
+    // restore the book and skip the script lines it covers, which must be those the checkpoint was taken with
+    size_t resumed = 0;
+    if (resumename.size() > 0 && !interactive) {
+        try {
+            size_t lno = 0;
+            resumed = resume_checkpoint(resumename, book, [&](ScriptRecord& rec) {
+                if (bin_reader) return bin_reader->next(rec);
+                std::string_view line;
+                std::string errmsg;
+                if (!line_reader->next(line)) return false;
+                if (parse_script_line(line, lno++, rec, errmsg) != ScriptLineStatus::Rule) throw FileError(resumename + ": " + errmsg);
+                return true;
+            });
+            if (!skip_check && !book.is_checked()) throw FileError(resumename + ": checkpoint was taken with --skip-check; resume it with --skip-check or verify the script from the start");
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+        if (book_writer) book_writer->write_all(book);
+    }
+
+    // a line is re-verified only if its record or one of the lines it refers to changed since the cached run
+    if (cachename.size() > 0 && !interactive) {
+        if (resumename.size() > 0) {
+            std::cerr << BOLD(RED("error")) << ": --cache and --resume cannot be used together" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        auto cached = std::make_shared<Book>();
+        std::vector<uint64_t> hashes;
+        if (std::ifstream(cachename).good()) {
+            try {
+                read_checkpoint(cachename, *cached, &hashes);
+            } catch (FileError& e) {
+                e.puterror();
+                exit(EXIT_FAILURE);
             }
-            ss << "[" << (++time_counter) * time_unit_ms / 1000 << " secs]";
-            ss << "\tprogress: " << book.size() << " / " << limit
-               << " (+" << (book.size() - last_size) * 5 << " judgements/sec)";
-            std::string text = ss.str();
-            ss.clear();
-            ss.str("");
-            if (text.size() > maxlen) maxlen = text.size();
-            else text += std::string(maxlen - text.size(), ' ');
-            text += '\n';
-            ss << "processing: ";
-            if (data.size() > 0) ss << data[std::min(data.size() - 1, book.size())];
-            text += ss.str();
-            if (ss.str().size() > maxlen) maxlen = ss.str().size();
-            else text += std::string(maxlen - ss.str().size(), ' ');
-            ss.clear();
-            ss.str("");
-            std::cerr << text << std::endl;
-            last_size = book.size();
-            auto end = std::chrono::system_clock::now();
-            auto waste = end - start;
-            if (waste < interval) std::this_thread::sleep_for(interval - waste);
+            if (!skip_check && !cached->is_checked()) std::cerr << cachename << " was written without checking the rules; every line is verified." << std::endl;
         }
-    };
+        book.reuse_from(cached, hashes);
+    }
 
-    if (data.size() > 0) {
-        auto th1 = std::thread(progress_check);
+    if (book_writer || ckptname.size() > 0) {
+        book.set_listener([&book, &book_writer, &ckptname, ckpt_every](size_t lno) {
+            if (book_writer) book_writer->write(book, lno);
+            if (ckptname.size() > 0 && (lno + 1) % ckpt_every == 0) write_checkpoint(ckptname, book, book.line_hashes());
+        });
+    }
+
+    RuleProfile rule_profile;
+    if (is_profiled) {
+        instrument::profiling = true;
+        book.set_profile(&rule_profile);
+    }
+
+    // the length of streamed input is unknown until it is read through
+    if (limit == std::string::npos && !line_reader && !bin_reader) limit = data.size();
+
+    std::stringstream ss;
+    std::atomic<size_t> applied = book.size();
+    book.set_progress(&applied);
+    // reads only applied and the lines of data, which are not modified while the reporter runs
+    ProgressReporter progress(is_verbose ? ProgressReporter::Mode::Off : progress_mode, "progress", "judgements", [&applied, &data, &limit]() {
+        ProgressReporter::Sample sample;
+        sample.done = applied.load(std::memory_order_relaxed);
+        if (limit != std::string::npos) sample.total = limit;
+        if (data.size() > 0) sample.status = data[std::min(data.size() - 1, sample.done)];
+        if (alloc_track::enabled) sample.notes.push_back(alloc_track::brief());
+        return sample;
+    });
+    progress.set_output(progress_fp);
+
+    if (data.size() > 0 || bin_reader || line_reader) {
         bool is_success = true;
-        if (!is_verbose) alive1.store(true);
-        th1.detach();
+        progress.start();
         try {
-            book.read_script(data);
+            // limit counts script lines including the resumed ones
+            size_t rest = limit == std::string::npos ? limit : limit - std::min(limit, resumed);
+            if (bin_reader) {
+                if (pipeline) book.read_script_pipelined(*bin_reader, rest);
+                else book.read_script(*bin_reader, rest);
+            } else if (line_reader) {
+                if (pipeline) book.read_script_pipelined(*line_reader, rest);
+                else book.read_script(*line_reader, rest);
+            } else book.read_script(data);
+            progress.stop();
+        } catch (FileError& e) {
+            progress.stop();
+            e.puterror();
+            exit(EXIT_FAILURE);
         } catch (InferenceError& e) {
-            alive1.store(false);
+            progress.stop();
             is_success = false;
             e.puterror();
 
             if (!interactive) {
-                if (is_verbose) std::cerr << book.repr() << std::endl;
+                if (is_verbose) {
+                    BookWriter(stderr, BookFormat::Conventional).finish(book);
+                    std::cerr << std::endl;
+                }
 
                 if (efname.size() > 0) {
-                    std::cerr << "extracting the book / env dump... ";
-                    std::stringstream err;
-                    err << e.str() << std::endl;
-                    err << "########## final state of the book ##########" << std::endl;
-                    err << book.repr() << std::endl;
-                    err << "################ end of book ################" << std::endl;
-                    err << "#### the environment in final judgement #####" << std::endl;
-                    err << book.back().env()->repr() << std::endl;
-                    err << "################ end of book ################" << std::endl;
-                    std::cerr << "done." << std::endl;
-                    std::string errstr = err.str();
                     std::cerr << "verification has been aborted because of an error." << std::endl;
-                    std::cerr << "writing error log to \"" << efname << "\" (" << strbytes(errstr.size()) << ")... ";
+                    std::cerr << "writing the book / env dump to \"" << efname << "\"... " << std::flush;
                     std::FILE* fp = fopen(efname.c_str(), "wb");
-                    std::fwrite(errstr.data(), sizeof(errstr[0]), errstr.size(), fp);
+                    auto put = [fp](const std::string& str) { std::fwrite(str.data(), sizeof(str[0]), str.size(), fp); };
+                    put(e.str() + "\n");
+                    put("########## final state of the book ##########\n");
+                    BookWriter writer(fp, BookFormat::Conventional);
+                    writer.finish(book);
+                    put("\n");
+                    put("################ end of book ################\n");
+                    put("#### the environment in final judgement #####\n");
+                    put(book.back().env()->repr() + "\n");
+                    put("################ end of book ################\n");
+                    std::cerr << "done (" << strbytes(std::ftell(fp)) << ")." << std::endl;
                     std::fclose(fp);
-                    std::cerr << "done." << std::endl;
                 } else {
                     std::cerr << "run with option \"-e log_file\" for the book / env dump." << std::endl;
                 }
@@ -208,8 +518,60 @@ int main(int argc, char* argv[]) {
             }
         }
 
-        if (is_success) std::cerr << BOLD(GREEN("verification finished.")) << std::endl;
-        alive1.store(false);
+        // --resume trusts the judgements of its checkpoint, so the lines it covers are not reported as verified
+        if (is_success && resumed == 0) std::cerr << BOLD(GREEN("verification finished.")) << std::endl;
+        else if (is_success) {
+            std::cerr << BOLD(CYAN("verification partially finished")) << ": ";
+            if (book.size() > resumed) std::cerr << "lines " << resumed << "-" << book.size() - 1 << " were checked; ";
+            else std::cerr << "no line was checked; ";
+            std::cerr << "lines 0-" << resumed - 1 << " were restored from " << resumename << " unchecked." << std::endl;
+        }
+        if (is_success && is_profiled) {
+            rule_profile.print(std::cerr);
+            if (profile_json.size() > 0) {
+                std::ofstream ofs(profile_json);
+                if (!ofs) {
+                    std::cerr << BOLD(RED("error")) << ": could not open file: " << profile_json << std::endl;
+                    exit(EXIT_FAILURE);
+                }
+                rule_profile.write_json(ofs);
+            }
+        }
+        if (show_stats) instrument::dump(std::cerr);
+        if (stats_json.size() > 0) {
+            try {
+                instrument::dump_json(stats_json);
+            } catch (FileError& e) {
+                e.puterror();
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (is_success && cachename.size() > 0 && !interactive) {
+            std::cerr << "reused " << book.reused_count() << " / " << book.size() << " judgements from the cache." << std::endl;
+            // the judgements of a run with --skip-check are not to be reused by a checking run
+            if (skip_check) {
+                std::cerr << cachename << " is not updated by a run with --skip-check." << std::endl;
+            } else {
+                try {
+                    write_checkpoint(cachename, book, book.line_hashes());
+                } catch (FileError& e) {
+                    e.puterror();
+                    exit(EXIT_FAILURE);
+                }
+            }
+        }
+    }
+
+    if (serve_path.size() > 0) {
+        VerifierServer server(book, skip_check);
+        std::cerr << "serving " << book.size() << " judgements and " << book.env().size() << " definitions on " << serve_path << std::endl;
+        try {
+            server.serve(serve_path);
+        } catch (FileError& e) {
+            e.puterror();
+            exit(EXIT_FAILURE);
+        }
+        return EXIT_SUCCESS;
     }
 
     if (interactive) {
@@ -228,10 +590,14 @@ int main(int argc, char* argv[]) {
             {"dsize", "", "show the number of definitions"},
             {"undo", "[n=1]", "undo last n inference"},
             {"load", "fname", "clear book and read fname"},
+            {"reload", "[fname]", "read fname (default: the script loaded) again, verifying only the lines changed"},
             {"save", "fname", "save current book to fname"},
             {"init", "", "clear book"},
             {"clear", "", "alias of init"},
             {"jump", "n", "refer to n-th judgement as the current context (resets with n = -1)"},
+            {"mark", "name", "name the current book (restore it later without verifying again)"},
+            {"restore", "name", "return to the book marked as name"},
+            {"marks", "", "list the marked books"},
             {"type", "formula", "find the type of given formula in current context"},
             {"[derivation command]"},
             {"sort", ""},
@@ -408,10 +774,39 @@ int main(int argc, char* argv[]) {
         std::cout << "[Interactive mode]\n"
                   << help_reminder << "\n\n";
 
-        TextData script;
+        // the lines of the script read with -f
+        TextData script(data.begin(), data.begin() + std::min(data.size(), book.size()));
+        // marks share the lines they have in common with each other and the current book
+        BookHistory history(book, script);
+        std::map<std::string, BookHistory::State> marks;
 
         int current_line = -1;
 
+        // reads the script into the empty book; the lines verified before an error are kept
+        auto load_script = [&](const FileData& fdata) {
+            std::cout << "Reading script from " << fdata.name() << "..." << std::endl;
+            bool loaded = true;
+            // the reporter reads data, so it starts after data is loaded
+            data = fdata;
+            limit = data.size();
+            progress.start();
+            try {
+                script = book.read_script(data);
+                progress.stop();
+            } catch (InferenceError& e) {
+                progress.stop();
+                e.puterror();
+                script.assign(data.begin(), data.begin() + book.size());
+                loaded = false;
+            }
+            for (size_t i = 0; i < book.size(); ++i) history.push(book[i], script[i]);
+            if (!loaded) {
+                std::cout << RED("Warning") << ": The script has been loaded up to the line just before the occurence of the InferenceError.\n";
+                return;
+            }
+            std::cout << BOLD(GREEN("OK")) << ": The script has been loaded successfully.\n";
+        };
+
         while (true) {
             const Environment& delta = (book.size() > 0 && book.back().env() ? *book.back().env() : env_dummy);
             std::function<void(size_t)> print_def = [&delta](size_t idx) -> void {
@@ -518,7 +913,8 @@ int main(int argc, char* argv[]) {
                     n = std::min(1ul, book.size());
                     if (args.size() == 2 && !read_index(n, args[1], book.size())) break;
                     book.resize(book.size() - n, judge_dummy);
-                    script.resize(book.size() - n);
+                    script.resize(book.size());
+                    history.pop(n);
                 } while (false);
             } else if (args[0] == "load") {
                 do {
@@ -527,27 +923,44 @@ int main(int argc, char* argv[]) {
                         std::cerr << "Run \"init\" and discard the current book to load a new script\n";
                         break;
                     }
-                    const std::string& ifname = args[1];
-                    std::cout << "Reading script from " << ifname << "..." << std::endl;
-                    auto th = std::thread(progress_check);
-                    alive1.store(true);
-                    th.detach();
                     try {
-                        data = FileData(ifname);
-                        script = book.read_script(data);
+                        load_script(FileData(args[1]));
                     } catch (FileError& e) {
-                        alive1.store(false);
                         e.puterror();
+                    }
+                } while (false);
+            } else if (args[0] == "reload") {
+                do {
+                    const std::string& ifname = args.size() == 2 ? args[1] : data.name();
+                    if (ifname.empty() || ifname == "stdin") {
+                        std::cerr << BOLD(RED("error")) << ": no script has been loaded; give the file to read\n";
                         break;
-                    } catch (InferenceError& e) {
-                        alive1.store(false);
+                    }
+                    FileData fdata;
+                    try {
+                        fdata = FileData(ifname);
+                    } catch (FileError& e) {
                         e.puterror();
-                        std::cout << RED("Warning") << ": The script has been loaded up to the line just before the occurence of the InferenceError.\n";
                         break;
                     }
-                    alive1.store(false);
-                    std::cout << BOLD(GREEN("OK")) << ": The script has been loaded successfully.\n";
-
+                    // the current judgements are reused for the lines whose rule and operands are unchanged,
+                    // except those of lines typed in a form other than the script's (e.g. with a negative index)
+                    auto cached = std::make_shared<Book>(std::vector<Judgement>(book.begin(), book.end()));
+                    std::vector<uint64_t> hashes(std::min(script.size(), book.size()));
+                    for (size_t i = 0; i < hashes.size(); ++i) {
+                        ScriptRecord rec;
+                        std::string errmsg;
+                        if (parse_script_line(script[i], i, rec, errmsg) == ScriptLineStatus::Rule) hashes[i] = rec.hash();
+                        else cached->forget(i);
+                    }
+                    book.clear();
+                    script.clear();
+                    history.clear();
+                    current_line = -1;
+                    book.reuse_from(cached, hashes);
+                    load_script(fdata);
+                    std::cout << "reused " << book.reused_count() << " / " << book.size() << " judgements.\n";
+                    book.reuse_from(nullptr, {});
                 } while (false);
             } else if (args[0] == "save") {
                 const std::string& ofname = args[1];
@@ -566,7 +979,25 @@ int main(int argc, char* argv[]) {
                     std::cout << BOLD(GREEN("OK")) << "\n";
                 }
             } else if (args[0] == "init" || args[0] == "clear") {
-                Book().swap(book);
+                book.clear();
+                script.clear();
+                history.clear();
+            } else if (args[0] == "mark") {
+                marks[args[1]] = history.state();
+                std::cout << "marked the book of " << book.size() << " judgements as \"" << args[1] << "\"\n";
+            } else if (args[0] == "restore") {
+                do {
+                    auto it = marks.find(args[1]);
+                    if (it == marks.end()) {
+                        std::cerr << BOLD(RED("error")) ": no book marked as \"" << args[1] << "\"\n";
+                        break;
+                    }
+                    size_t replaced = history.restore(it->second, book, script);
+                    if (current_line >= (int)book.size()) current_line = -1;
+                    std::cout << "restored \"" << args[1] << "\" (" << book.size() << " judgements, " << replaced << " replaced)\n";
+                } while (false);
+            } else if (args[0] == "marks") {
+                for (auto&& [name, state] : marks) std::cout << name << ": " << state.size() << " judgements\n";
             } else if (args[0] == "jump") {
                 do {
                     if (!read_index(current_line, args[1], book.size(), true)) break;
@@ -747,14 +1178,18 @@ int main(int argc, char* argv[]) {
                     int i, n, j, p;
                     if (!read_index(i, args[1], book.size())) break;
                     if (!read_nonneg(n, args[2])) break;
-                    std::vector<size_t> js;
+                    // applied as a script line, so that p and n are checked against the environment of i-th judgement
+                    ScriptRecord rec(RuleType::Inst);
+                    rec.refs().push_back(i);
                     for (int idx = 0; idx < n; ++idx) {
                         if (!read_index(j, args[idx + 3], book.size())) break;
-                        js.push_back(j);
+                        rec.refs().push_back(j);
                     }
+                    if ((int)rec.refs().size() != n + 1) break;
                     if (!read_index(p, args[n + 3], delta.size())) break;
+                    rec.arg() = p;
                     try {
-                        book.inst(i, n, js, p);
+                        book.apply(rec);
                     } catch (InferenceError& e) {
                         e.puterror();
                         break;
@@ -767,6 +1202,7 @@ int main(int argc, char* argv[]) {
             }
             if (inf_success) {
                 script.push_back(std::to_string(script.size()) + " " + line);
+                history.push(book.back(), script.back());
                 std::cout << "res ";
                 print_judge(book.size() - 1);
             }
@@ -776,36 +1212,22 @@ int main(int argc, char* argv[]) {
     }
 
     // std::ofstream ofs(ofname);
-    if (book.size() > 0 && !interactive) {
-        if ((!is_quiet && is_verbose) || ofname.size() > 0) {
-            std::string book_data;
-            switch (notation) {
-                case Conventional:
-                    book_data = book.repr();
-                    break;
-                case New:
-                    book_data = book.repr_new();
-                    break;
-                case Rich:
-                    book_data = book.string();
-                    break;
-                default:
-                    check_true_or_exit(
-                        false,
-                        "invalid notation value = " << notation,
-                        __FILE__, __LINE__, __func__);
-            }
+    if (book_writer) {
+        book_writer->finish(book);
+        book.set_listener(nullptr);
+        std::fclose(book_fp);
+        if (book.size() > 0) {
+            partial_book_file.clear();
+            std::cerr << "book data written to \"" << ofname << "\" (" << strbytes(book_writer->bytes()) << ")." << std::endl;
+        }
+    }
 
-            if (ofname.size() > 0) {
-                std::cerr << "outputting book data (" << strbytes(book_data.size()) << ")... " << std::flush;
-                std::FILE* fp = std::fopen(ofname.c_str(), "wb");
-                std::fwrite(book_data.data(), sizeof(book_data[0]), book_data.size(), fp);
-                std::fclose(fp);
-                std::cerr << "done." << std::endl;
-            } else if (is_verbose) {
-                std::cout << "\n"
-                          << book_data << std::endl;
-            }
+    if (book.size() > 0 && !interactive) {
+        if (!is_quiet && is_verbose && ofname.size() == 0) {
+            std::cout << "\n"
+                      << std::flush;
+            BookWriter(stdout, book_format(notation)).finish(book);
+            std::cout << std::endl;
         }
 
         if (odefname.size() > 0) {
@@ -821,31 +1243,5 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    time_counter = maxlen = 0;
-    if (!interactive) {
-        auto alive2 = std::atomic_bool(true);
-        auto progress_check_io = [&alive2, &time_counter, &time_unit_ms, &maxlen]() {
-            const std::chrono::milliseconds interval(time_unit_ms);
-            std::this_thread::sleep_for(interval);
-            while (alive2.load()) {
-                auto start = std::chrono::system_clock::now();
-                std::stringstream ss;
-                if (time_counter > 0) std::cerr << "\033[F" << '\r' << std::flush;
-                ss << "[" << (++time_counter) * time_unit_ms / 1000 << " secs] waiting for file I/O...";
-                std::string text = ss.str();
-                if (text.size() > maxlen) maxlen = text.size();
-                else text += std::string(maxlen - text.size(), ' ');
-                std::cerr << text << std::endl;
-                ss.clear();
-                ss.str("");
-                auto end = std::chrono::system_clock::now();
-                auto waste = end - start;
-                if (waste < interval) std::this_thread::sleep_for(interval - waste);
-            }
-        };
-        auto th2 = std::thread(progress_check_io);
-        th2.detach();
-    }
-
     return 0;
 }